@@ -17,6 +17,36 @@ CONFIG_SHELL_COLORPROMPT	?= y
 ######################################
 CONFIG_SHFS_OPENBYNAME		?= y
 CONFIG_SHFS_CACHEINFO		?= y
+# Serve pre-encoded variants of an object (same name, content encoding
+#  set with shfs_admin --encoding) by Accept-Encoding negotiation
+#  Note: Requires OPENBYNAME
+CONFIG_SHFS_VARIANTS		?= n
+
+# Keep only a bounded number of hash table chunks in memory (LRU) and
+#  load the others on first access. Meant for volumes with very large
+#  hash tables. Maximum number of resident chunks:
+#  Note: Opened objects keep their chunk resident. A request for an object
+#        whose chunk is not resident waits (is retried) until the chunk
+#        got read; shell tools (e.g., ls) busy-wait for the read instead
+CONFIG_SHFS_HTABLE_LAZY		?= n
+CONFIG_SHFS_HTABLE_LAZY_NB_CHUNKS	?= 1024
+
+# Compact in-memory object metadata: bucket entries are not padded to
+#  cache lines, keep no per-object lock and a shorter location record.
+#  Saves memory for large volumes on small VMs
+CONFIG_SHFS_BENTRY_COMPACT	?= n
+
+# Replacement policy of the chunk cache
+#  lru:    recycle buffers in order of their release
+#  2q:     2Q (scan-resistant)
+#  arc:    Adaptive Replacement Cache (scan-resistant)
+#  s3fifo: S3-FIFO (scan-resistant)
+CONFIG_SHFS_CACHE_POLICY	?= lru
+
+# Snapshot the chunk cache contents on umount/remount and replay them
+#  as a rate-limited background prefetch after mount. With a snapshot
+#  device (-p), snapshots survive reboots
+CONFIG_SHFS_CACHE_WARM		?= n
 
 # Enable statistic capabilities of SHFS
 #  If this option is disabled, STATS_HTTP is disabled as well
@@ -41,6 +71,14 @@ CONFIG_SHFS_STATS_HTTP		?= y
 #        otherwise this feature is disabled
 CONFIG_SHFS_STATS_HTTP_DPCR	?= 6
 
+# Pull the first chunks of the most popular objects (ranked by a decaying
+#  hit counter of the statistics) into the chunk cache while the volume
+#  is idle. Number of objects and chunks per object:
+#  Note: Requires SHFS_STATS
+CONFIG_SHFS_PREFETCH		?= n
+CONFIG_SHFS_PREFETCH_NB_OBJS	?= 32
+CONFIG_SHFS_PREFETCH_NB_CHUNKS	?= 2
+
 ######################################
 ## HTTP
 ######################################
@@ -50,6 +88,21 @@ CONFIG_HTTP_INFO		?= y
 CONFIG_HTTP_URL_CUTARGS		?= y
 # Provide a performance test file on hash digest 0x0
 CONFIG_HTTP_TESTFILE		?= n
+# Pin cache buffers of file data until it got acknowledged (per session)
+#  instead of holding them on the buffer ring of a request
+CONFIG_HTTP_FIO_PINNING		?= n
+# Attach the complete 200 response header to an object on first access
+#  so that it can be sent as a whole by upcoming (HTTP/1.1 keep-alive) requests
+CONFIG_HTTP_HDRCACHE		?= n
+# Keep whole small objects together with their cached header in memory,
+#  admitted by access frequency (requires CONFIG_HTTP_HDRCACHE)
+CONFIG_HTTP_HOTCACHE		?= n
+# Max. object size (bytes) and memory limit (bytes) of the hot object tier
+CONFIG_HTTP_HOTCACHE_MAXOBJLEN	?= 16384
+CONFIG_HTTP_HOTCACHE_SIZE	?= 16777216
+# Prepare queued (pipelined) requests of a session ahead and start
+#  reading their first chunk while the current response is sent
+CONFIG_HTTP_PREFETCH		?= n
 
 ######################################
 ## ctldir (only available on Mini-OS)
@@ -28,6 +28,10 @@ MCOBJS						= ring.o \
 
 MCCFLAGS-$(CONFIG_HTABLE_DEBUG)			+= -DHTABLE_DEBUG
 MCCFLAGS-$(CONFIG_MEMPOOL_DEBUG)		+= -DMEMPOOL_DEBUG
+MCCFLAGS-$(CONFIG_MEMPOOL_HUGEPAGES)		+= -DMEMPOOL_HUGEPAGES
+ifneq ($(CONFIG_MEMPOOL_HUGEPAGES_MINSIZE),)
+MCCFLAGS-$(CONFIG_MEMPOOL_HUGEPAGES)		+= -DMEMPOOL_HUGEPAGES_MINSIZE=$(CONFIG_MEMPOOL_HUGEPAGES_MINSIZE)
+endif
 
 
 ######################################
@@ -62,6 +66,14 @@ endif
 ## SHFS
 ######################################
 MCCFLAGS-$(CONFIG_SHFS_OPENBYNAME)	+= -DSHFS_OPENBYNAME
+ifeq ($(CONFIG_SHFS_OPENBYNAME),y)
+MCCFLAGS-$(CONFIG_SHFS_VARIANTS)	+= -DSHFS_VARIANTS
+endif
+MCCFLAGS-$(CONFIG_SHFS_HTABLE_LAZY)	+= -DSHFS_HTABLE_LAZY
+ifneq ($(CONFIG_SHFS_HTABLE_LAZY_NB_CHUNKS),)
+MCCFLAGS-$(CONFIG_SHFS_HTABLE_LAZY)	+= -DSHFS_HTABLE_LAZY_NB_CHUNKS=$(CONFIG_SHFS_HTABLE_LAZY_NB_CHUNKS)
+endif
+MCCFLAGS-$(CONFIG_SHFS_BENTRY_COMPACT)	+= -DSHFS_BENTRY_COMPACT
 MCCFLAGS-$(CONFIG_SHFS_CACHEINFO)	+= -DSHFS_CACHE_INFO
 MCCFLAGS-$(CONFIG_SHFS_DEBUG)		+= -DSHFS_DEBUG
 MCCFLAGS-$(CONFIG_SHFS_CACHE_DEBUG)	+= -DSHFS_CACHE_DEBUG
@@ -71,6 +83,14 @@ MCCFLAGS-$(CONFIG_SHFS_CACHE_STATS)	+= -DSHFS_CACHE_STATS
 ifeq ($(CONFIG_SHFS_STATS),y)
 MCCFLAGS				+= -DSHFS_STATS
 MCOBJS					+= shfs_stats.o
+MCCFLAGS-$(CONFIG_SHFS_PREFETCH)	+= -DSHFS_PREFETCH
+MCOBJS-$(CONFIG_SHFS_PREFETCH)		+= shfs_prefetch.o
+ifneq ($(CONFIG_SHFS_PREFETCH_NB_OBJS),)
+MCCFLAGS-$(CONFIG_SHFS_PREFETCH)	+= -DSHFS_PREFETCH_NB_OBJS=$(CONFIG_SHFS_PREFETCH_NB_OBJS)
+endif
+ifneq ($(CONFIG_SHFS_PREFETCH_NB_CHUNKS),)
+MCCFLAGS-$(CONFIG_SHFS_PREFETCH)	+= -DSHFS_PREFETCH_NB_CHUNKS=$(CONFIG_SHFS_PREFETCH_NB_CHUNKS)
+endif
 ifeq ($(CONFIG_SHFS_STATS_HTTP),y)
 MCCFLAGS				+= -DSHFS_STATS_HTTP
 #ifeq ($(shell echo ${CONFIG_SHFS_STATS_HTTP_DPCR}\>=2 | bc),"1")
@@ -84,6 +104,9 @@ ifneq ($(CONFIG_SHFS_CACHE_READAHEAD),)
 CONFIG_SHFS_CACHE_READAHEAD		?= 8
 MCCFLAGS				+= -DSHFS_CACHE_READAHEAD=$(CONFIG_SHFS_CACHE_READAHEAD)
 endif
+ifneq ($(CONFIG_SHFS_CACHE_READAHEAD_MAX),)
+MCCFLAGS				+= -DSHFS_CACHE_READAHEAD_MAX=$(CONFIG_SHFS_CACHE_READAHEAD_MAX)
+endif
 CONFIG_SHFS_CACHE_POOL_NB_BUFFERS	?= 64
 MCCFLAGS-$(CONFIG_SHFS_CACHE_POOL_MAXALLOC) += -DSHFS_CACHE_POOL_MAXALLOC
 ifneq ($(CONFIG_SHFS_CACHE_POOL_MAXALLOC_THRESHOLD),)
@@ -91,6 +114,17 @@ MCCFLAGS-$(CONFIG_SHFS_CACHE_POOL_MAXALLOC) += -DSHFS_CACHE_POOL_MAXALLOC_THRESH
 endif
 MCCFLAGS				+= -DSHFS_CACHE_POOL_NB_BUFFERS=$(CONFIG_SHFS_CACHE_POOL_NB_BUFFERS)
 MCCFLAGS-$(CONFIG_SHFS_CACHE_GROW)	+= -DSHFS_CACHE_GROW
+ifeq ($(CONFIG_SHFS_CACHE_POLICY),2q)
+MCCFLAGS				+= -DSHFS_CACHE_POLICY_2Q
+endif
+ifeq ($(CONFIG_SHFS_CACHE_POLICY),arc)
+MCCFLAGS				+= -DSHFS_CACHE_POLICY_ARC
+endif
+ifeq ($(CONFIG_SHFS_CACHE_POLICY),s3fifo)
+MCCFLAGS				+= -DSHFS_CACHE_POLICY_S3FIFO
+endif
+MCCFLAGS-$(CONFIG_SHFS_CACHE_WARM)	+= -DSHFS_CACHE_WARM
+MCOBJS-$(CONFIG_SHFS_CACHE_WARM)	+= shfs_warm.o
 
 ######################################
 ## HTTP
@@ -100,6 +134,23 @@ MCCFLAGS-$(CONFIG_HTTP_TESTFILES)	+= -DHTTP_TESTFILES
 MCCFLAGS-$(CONFIG_HTTP_INFO)		+= -DHTTP_INFO
 MCCFLAGS-$(CONFIG_HTTP_URL_CUTARGS)	+= -DHTTP_URL_CUTARGS
 MCCFLAGS-$(CONFIG_HTTP_LINK_MEMCPY)	+= -DHTTP_LINK_MEMCPY
+MCCFLAGS-$(CONFIG_HTTP_FIO_PINNING)	+= -DHTTP_FIO_PINNING
+MCCFLAGS-$(CONFIG_HTTP_HDRCACHE)	+= -DHTTP_HDRCACHE
+ifeq ($(CONFIG_HTTP_HDRCACHE),y)
+MCCFLAGS-$(CONFIG_HTTP_HOTCACHE)	+= -DHTTP_HOTCACHE
+MCOBJS-$(CONFIG_HTTP_HOTCACHE)		+= http_hot.o
+ifneq ($(CONFIG_HTTP_HOTCACHE_MAXOBJLEN),)
+MCCFLAGS-$(CONFIG_HTTP_HOTCACHE)	+= -DHTTP_HOTCACHE_MAXOBJLEN=$(CONFIG_HTTP_HOTCACHE_MAXOBJLEN)
+endif
+ifneq ($(CONFIG_HTTP_HOTCACHE_SIZE),)
+MCCFLAGS-$(CONFIG_HTTP_HOTCACHE)	+= -DHTTP_HOTCACHE_SIZE=$(CONFIG_HTTP_HOTCACHE_SIZE)
+endif
+endif
+MCCFLAGS-$(CONFIG_HTTP_PREFETCH)	+= -DHTTP_PREFETCH
+ifeq ($(TARGET),linux)
+MCCFLAGS-$(CONFIG_HTTP_KSOCK)		+= -DHTTP_KSOCK
+MCOBJS-$(CONFIG_HTTP_KSOCK)		+= http_ksock.o
+endif
 
 MCCFLAGS-$(CONFIG_HTTP_DEBUG)		+= -DHTTP_DEBUG
 MCCFLAGS-$(CONFIG_HTTP_DEBUG_SESSIONSTATES) += -DHTTP_DEBUG_SESSIONSTATES
@@ -91,10 +91,19 @@ else
 CONFIG_PTH_THREADS?=n
 CONFIG_SHELL?=n
 CONFIG_NETMAP?=y
+# io_uring block I/O instead of POSIX AIO (requires Linux >= 5.6),
+# devices are opened with O_DIRECT unless CONFIG_IOURINGBLK_DIRECT=n
+CONFIG_IOURINGBLK?=n
+CONFIG_IOURINGBLK_DIRECT?=y
 
 CONFIG_SHFS_CACHE_READAHEAD		?= 8
 CONFIG_SHFS_CACHE_POOL_NB_BUFFERS	?= 8192
 CONFIG_SHFS_CACHE_GROW			= n
+# back large memory pools (cache buffers) with huge pages if reserved
+CONFIG_MEMPOOL_HUGEPAGES		?= n
+# additional HTTP front end on host kernel sockets (epoll + sendfile()),
+# enabled at runtime with -k [port]
+CONFIG_HTTP_KSOCK			?= n
 endif
 
 ifeq ($(CONFIG_SHELL),y)
@@ -268,9 +277,15 @@ APPFILES+=target/$(TARGET)/blkdev/osv-blk.c
 APPFILESXX+=target/$(TARGET)/blkdev/osv-blk-bio.cc
 CFLAGS+=-DCONFIG_OSVBLK
 else
+ifeq ($(CONFIG_IOURINGBLK),y)
+APPFILES+=target/$(TARGET)/blkdev/iouring-blk.c
+CFLAGS+=-DCONFIG_IOURINGBLK
+CFLAGS-$(CONFIG_IOURINGBLK_DIRECT)+=-DIOURINGBLK_DIRECT
+else
 APPFILES+=target/$(TARGET)/blkdev/paio-blk.c
 LDFLAGS+=-lrt
 endif
+endif
 
 # APPFILES: Applications.
 APPDIRS+=:.:target/$(TARGET)
@@ -73,24 +73,42 @@ static inline size_t align_up(size_t size, size_t align)
   return (size + align - 1) & ~(align - 1);
 }
 
-struct htable *alloc_htable(uint32_t nb_bkts, uint32_t el_per_bkt, uint8_t hlen, size_t el_private_len, size_t align)
+struct htable *alloc_htable(uint32_t nb_bkts, uint32_t el_per_bkt, uint8_t hlen, size_t el_private_len, size_t align, uint8_t bkt_mode)
 {
 	size_t ht_size;
 	size_t bkt_hdr_size;
 	size_t bkt_size;
 	size_t el_hdr_size;
 	size_t el_size;
+	size_t h_size;
 	struct htable *ht;
 	struct htable_bkt *bkt;
 	struct htable_el *el;
 	uint32_t i, j;
 
+	switch (bkt_mode) {
+	case HTABLE_BKT_MODULO:
+	case HTABLE_BKT_FASTRANGE:
+		break;
+	case HTABLE_BKT_POW2:
+		if (nb_bkts && !(nb_bkts & (nb_bkts - 1)))
+			break;
+		/* nb_bkts is not a power of 2 */
+		/* fall through */
+	default:
+		errno = EINVAL;
+		goto err_out;
+	}
+
 	align = max(MIN_ALIGN, align);
 
+	h_size       = align_up(hlen, sizeof(uint64_t)); /* hash functions access 64-bit words */
 	el_hdr_size  = align_up(sizeof(struct htable_el), align);
 	el_size      = el_hdr_size + align_up(el_private_len, align);
 	bkt_hdr_size = align_up(sizeof(struct htable_bkt)
-	               + (sizeof(hash512_t) * el_per_bkt), align); /* hash list */
+	               + (h_size * el_per_bkt), HTABLE_FP_ALIGN); /* hash list */
+	bkt_hdr_size = align_up(bkt_hdr_size
+	               + align_up(el_per_bkt, HTABLE_FP_ALIGN), align); /* fingerprint list */
 	bkt_size     = bkt_hdr_size
 		       + (el_size * el_per_bkt) /* element list */;
 	ht_size      = sizeof(struct htable)
@@ -115,6 +133,9 @@ struct htable *alloc_htable(uint32_t nb_bkts, uint32_t el_per_bkt, uint8_t hlen,
 	ht->nb_bkts = nb_bkts;
 	ht->el_per_bkt = el_per_bkt;
 	ht->hlen = hlen;
+	ht->bkt_mode = bkt_mode;
+	ht->bkt_mask = nb_bkts - 1;
+	ht->mem_size = ht_size + (bkt_size * nb_bkts);
 	ht->head = NULL;
 	ht->tail = NULL;
 
@@ -132,12 +153,17 @@ struct htable *alloc_htable(uint32_t nb_bkts, uint32_t el_per_bkt, uint8_t hlen,
 #endif
 		ht->b[i] = bkt;
 		bkt->el = (void *) (((uint8_t *) ht->b[i]) + bkt_hdr_size);
+		bkt->fp = (uint8_t *) (((uint8_t *) ht->b[i]) +
+		                       align_up(sizeof(struct htable_bkt)
+		                       + (h_size * el_per_bkt), HTABLE_FP_ALIGN));
 		bkt->el_size = el_size;
 		bkt->el_private_len = el_private_len;
+		bkt->h_size = h_size;
 
 		for (j = 0; j < el_per_bkt; ++j) {
 			el = _htable_bkt_el(bkt, j);
-			el->h = &bkt->h[j];
+			el->h = &_htable_bkt_h(bkt, j);
+			el->fp = &bkt->fp[j];
 			el->private = (void *) (((uint8_t *) el) + el_hdr_size);
 
 #ifdef HTABLE_DEBUG
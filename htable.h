@@ -47,6 +47,26 @@ extern int shfs_errno;
 
 #include "hash.h"
 
+#if !defined __KERNEL__ && !defined HTABLE_NOSIMD
+#if defined __AVX2__
+#include <immintrin.h>
+#define HTABLE_PROBE_AVX2
+#elif defined __SSE2__
+#include <emmintrin.h>
+#define HTABLE_PROBE_SSE2
+#elif defined __ARM_NEON || defined __ARM_NEON__
+#include <arm_neon.h>
+#define HTABLE_PROBE_NEON
+#endif
+#endif
+
+#define HTABLE_FP_ALIGN 32 /* fingerprint lists are padded to this size (max. SIMD width) */
+
+/* bucket selection modes */
+#define HTABLE_BKT_MODULO    0x0 /* hash % nb_bkts */
+#define HTABLE_BKT_POW2      0x1 /* hash & (nb_bkts - 1), nb_bkts has to be a power of 2 */
+#define HTABLE_BKT_FASTRANGE 0x2 /* (hash32 * nb_bkts) >> 32 (multiply-shift) */
+
 /*
  * HASH TABLE ELEMENT: MEMORY LAYOUT
  *
@@ -60,6 +80,7 @@ extern int shfs_errno;
  */
 struct htable_el {
 	hash512_t *h;
+	uint8_t *fp; /* fingerprint of h */
 	struct htable_el *prev;
 	struct htable_el *next;
 	void *private; /* ptr to user private data area (do not change) */
@@ -82,6 +103,9 @@ struct htable_el {
  *           |         ...          |
  *           ~                      ~
  *           |     // padding //    |
+ *   fp[0] ->+----------------------+
+ *           | FP | FP | FP | ...   |
+ *           |     // padding //    |
  *   el[0] ->+----------------------+
  *           |       ELEMENT        |
  *           |     // padding //    |
@@ -96,16 +120,105 @@ struct htable_el {
  *           v                      v
  *
  * Because of locality reasons during a bucket search, the hash values of the
- * elements are separated from the element data area
+ * elements are separated from the element data area.
+ * Additionally, a one byte fingerprint of each hash value is kept in a
+ * separate list that is probed first (with SIMD instructions, if available).
+ * A fingerprint of 0 denotes an empty slot.
+ * Hash value slots are only as large as the hash length (rounded up to
+ * 8 bytes), not sizeof(hash512_t).
  */
 struct htable_bkt {
 	size_t el_size; /* size of an element */
 	size_t el_private_len;
+	size_t h_size; /* size of a hash value slot (hlen rounded up to 8 bytes) */
 	void *el; /* element list reference */
-	hash512_t h[0]; /* hash value list */
+	uint8_t *fp; /* fingerprint list reference */
+	hash512_t h[0]; /* hash value list (slots are h_size bytes apart) */
 };
 
 #define _htable_bkt_el(b, i) ((struct htable_el *) ((uint8_t *) (b)->el + ((b)->el_size * (i))))
+#define _htable_bkt_h(b, i) (*((hash512_t *) ((uint8_t *) (b)->h + ((b)->h_size * (i)))))
+
+/*
+ * Fingerprint of a hash value (never 0)
+ * Note: The first 8 bytes are used for the bucket number,
+ *       that's why the fingerprint is taken from the 9th byte
+ */
+static inline uint8_t _htable_fp(const hash512_t h, uint8_t hlen)
+{
+	register uint8_t fp;
+
+	if (unlikely(hlen == 0))
+		return 1;
+	fp = h[(hlen > 8) ? 8 : (hlen - 1)];
+	return fp ? fp : 1;
+}
+
+/*
+ * Sets the hash value (and fingerprint) of slot i of a bucket
+ */
+static inline void _htable_bkt_sethash(struct htable_bkt *b, uint32_t i, const hash512_t h, uint8_t hlen)
+{
+	hash_copy(_htable_bkt_h(b, i), h, hlen);
+	b->fp[i] = hash_is_zero(h, hlen) ? 0 : _htable_fp(h, hlen);
+}
+
+/*
+ * Searches a bucket for a hash value:
+ *  The fingerprint list is compared first, full hash values
+ *  are only compared on a fingerprint match
+ *  Returns the slot number or -1 if the hash was not found
+ */
+static inline int64_t _htable_bkt_probe(const struct htable_bkt *b, uint32_t el_per_bkt,
+                                        const hash512_t h, uint8_t hlen)
+{
+	register uint8_t fp = _htable_fp(h, hlen);
+	register uint32_t i;
+#if defined HTABLE_PROBE_AVX2 || defined HTABLE_PROBE_SSE2
+	register uint32_t m;
+	register uint32_t j;
+#if defined HTABLE_PROBE_AVX2
+	const __m256i vfp = _mm256_set1_epi8((char) fp);
+
+	for (i = 0; i < el_per_bkt; i += 32) {
+		m = (uint32_t) _mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(vfp, _mm256_loadu_si256((const __m256i *) &b->fp[i])));
+#else
+	const __m128i vfp = _mm_set1_epi8((char) fp);
+
+	for (i = 0; i < el_per_bkt; i += 16) {
+		m = (uint32_t) _mm_movemask_epi8(
+			_mm_cmpeq_epi8(vfp, _mm_loadu_si128((const __m128i *) &b->fp[i])));
+#endif
+		while (m) {
+			j = i + __builtin_ctz(m);
+			if (hash_compare(_htable_bkt_h(b, j), h, hlen) == 0)
+				return j;
+			m &= m - 1; /* clear lowest bit */
+		}
+	}
+#elif defined HTABLE_PROBE_NEON
+	register uint32_t j;
+	const uint8x16_t vfp = vdupq_n_u8(fp);
+	uint64x2_t m;
+
+	for (i = 0; i < el_per_bkt; i += 16) {
+		m = vreinterpretq_u64_u8(vceqq_u8(vfp, vld1q_u8(&b->fp[i])));
+		if (!(vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1)))
+			continue; /* no fingerprint match in this block */
+		for (j = i; j < i + 16; ++j) {
+			if (b->fp[j] == fp && hash_compare(_htable_bkt_h(b, j), h, hlen) == 0)
+				return j;
+		}
+	}
+#else
+	for (i = 0; i < el_per_bkt; ++i) {
+		if (b->fp[i] == fp && hash_compare(_htable_bkt_h(b, i), h, hlen) == 0)
+			return i;
+	}
+#endif
+	return -1;
+}
 
 
 /*
@@ -127,6 +240,9 @@ struct htable {
 	uint32_t nb_bkts; /* number of buckets */
 	uint32_t el_per_bkt; /* elements per bucket (bucket size) */
 	uint8_t hlen; /* length of hash value */
+	uint8_t bkt_mode; /* bucket selection mode */
+	uint32_t bkt_mask; /* nb_bkts - 1 (HTABLE_BKT_POW2) */
+	size_t mem_size; /* allocated memory (table and buckets) */
 
 	struct htable_el *head;
 	struct htable_el *tail;
@@ -135,9 +251,11 @@ struct htable {
 };
 
 /*
- * Retrieve bucket number from hash value
+ * Retrieve bucket number from hash value (HTABLE_BKT_MODULO)
+ * Note: Existing SHFS volumes are organized with this function, that's
+ *       why hash values of 5 or more bytes are still reduced to 32 bits here
  */
-static inline unsigned int _htable_bkt_no(const hash512_t h, uint8_t hlen, uint32_t nb_bkts)
+static inline unsigned int _htable_bkt_mod(const hash512_t h, uint8_t hlen, uint32_t nb_bkts)
 {
 	register uint16_t h16;
 	register uint32_t h32;
@@ -180,9 +298,54 @@ static inline unsigned int _htable_bkt_no(const hash512_t h, uint8_t hlen, uint3
 }
 
 /*
- *
+ * Returns the first (up to) 8 bytes of a hash value
+ */
+static inline uint64_t _htable_key64(const hash512_t h, uint8_t hlen)
+{
+	register uint64_t k = *((uint64_t *) &h[0]);
+
+	if (hlen < 8)
+		k &= ((uint64_t) 1 << (hlen << 3)) - 1;
+	return k;
+}
+
+/*
+ * Returns the first (up to) 4 bytes of a hash value,
+ * shorter values are scaled to the full 32 bit range
+ */
+static inline uint32_t _htable_key32(const hash512_t h, uint8_t hlen)
+{
+	register uint32_t k = *((uint32_t *) &h[0]);
+
+	if (unlikely(hlen == 0))
+		return 0;
+	if (hlen < 4)
+		k <<= ((4 - hlen) << 3);
+	return k;
+}
+
+/*
+ * Retrieve bucket number from hash value
+ */
+static inline uint32_t _htable_bkt_no(const struct htable *ht, const hash512_t h)
+{
+	switch (ht->bkt_mode) {
+	case HTABLE_BKT_POW2:
+		return (uint32_t) (_htable_key64(h, ht->hlen) & ht->bkt_mask);
+	case HTABLE_BKT_FASTRANGE:
+		return (uint32_t) (((uint64_t) _htable_key32(h, ht->hlen) * ht->nb_bkts) >> 32);
+	default:
+		break;
+	}
+	return _htable_bkt_mod(h, ht->hlen, ht->nb_bkts);
+}
+
+/*
+ * Allocates a hash table
+ *  bkt_mode selects the bucket selection function (HTABLE_BKT_*)
+ *  NULL is returned on failure (errno = EINVAL for an unsupported mode)
  */
-struct htable *alloc_htable(uint32_t nb_bkts, uint32_t el_per_bkt, uint8_t hlen, size_t el_private_len, size_t align);
+struct htable *alloc_htable(uint32_t nb_bkts, uint32_t el_per_bkt, uint8_t hlen, size_t el_private_len, size_t align, uint8_t bkt_mode);
 void free_htable(struct htable *ht);
 
 /*
@@ -205,7 +368,7 @@ static inline struct htable_el *htable_pick(struct htable *ht, uint64_t el_idx)
 	}
 
 	b = ht->b[bkt_idx];
-	if (unlikely(hash_is_zero(b->h[el_idx_bkt], ht->hlen))) {
+	if (unlikely(hash_is_zero(_htable_bkt_h(b, el_idx_bkt), ht->hlen))) {
 		errno = ENOENT;
 		return NULL;
 	}
@@ -219,7 +382,7 @@ static inline struct htable_el *htable_pick(struct htable *ht, uint64_t el_idx)
  */
 static inline struct htable_el *htable_lookup(struct htable *ht, const hash512_t h)
 {
-	register uint32_t i;
+	register int64_t i;
 	register uint32_t bkt_idx;
 	struct htable_bkt *b;
 
@@ -228,12 +391,11 @@ static inline struct htable_el *htable_lookup(struct htable *ht, const hash512_t
 		goto err_out;
 	}
 
-	bkt_idx = _htable_bkt_no(h, ht->hlen, ht->nb_bkts);
+	bkt_idx = _htable_bkt_no(ht, h);
 	b = ht->b[bkt_idx];
-	for (i = 0; i < ht->el_per_bkt; ++i) {
-		if (hash_compare(b->h[i], h, ht->hlen) == 0)
-			return _htable_bkt_el(b, i);
-	}
+	i = _htable_bkt_probe(b, ht->el_per_bkt, h, ht->hlen);
+	if (i >= 0)
+		return _htable_bkt_el(b, i);
 
 	/* no entry found */
 	errno = ENOENT;
@@ -259,14 +421,14 @@ static inline struct htable_el *htable_add(struct htable *ht, const hash512_t h)
 		goto err_out;
 	}
 
-	bkt_idx = _htable_bkt_no(h, ht->hlen, ht->nb_bkts);
+	bkt_idx = _htable_bkt_no(ht, h);
 	b = ht->b[bkt_idx];
 	for (i = 0; i < ht->el_per_bkt; ++i) {
 		/* TODO: Check for already existence (preserve unique entries) */
-		if (hash_is_zero(b->h[i], ht->hlen)) {
+		if (b->fp[i] == 0) {
 			/* found */
 			el = _htable_bkt_el(b, i);
-			hash_copy(b->h[i], h, ht->hlen);
+			_htable_bkt_sethash(b, i, h, ht->hlen);
 
 			/* update linked list of elements */
 			if (!ht->head) {
@@ -302,7 +464,8 @@ static inline struct htable_el *htable_add(struct htable *ht, const hash512_t h)
 static inline struct htable_el *htable_lookup_add(struct htable *ht, const hash512_t h, int *is_new)
 {
 	register int empty_slot_found = 0;
-	register uint32_t i, e = 0;
+	register int64_t i;
+	register uint32_t e = 0;
 	register uint32_t bkt_idx;
 	struct htable_bkt *b;
 	struct htable_el *el;
@@ -312,19 +475,19 @@ static inline struct htable_el *htable_lookup_add(struct htable *ht, const hash5
 		return NULL;
 	}
 
-	bkt_idx = _htable_bkt_no(h, ht->hlen, ht->nb_bkts);
+	bkt_idx = _htable_bkt_no(ht, h);
 	b = ht->b[bkt_idx];
+	i = _htable_bkt_probe(b, ht->el_per_bkt, h, ht->hlen);
+	if (i >= 0) {
+		if (is_new)
+			*is_new = 0;
+		return _htable_bkt_el(b, i);
+	}
 	for (i = 0; i < ht->el_per_bkt; ++i) {
-		if (hash_compare(b->h[i], h, ht->hlen) == 0) {
-			if (is_new)
-				*is_new = 0;
-			return _htable_bkt_el(b, i);
-		}
-		if (!empty_slot_found) {
-			if (hash_is_zero(b->h[i], ht->hlen)) {
-				e = i;
-				empty_slot_found = 1;
-			}
+		if (b->fp[i] == 0) {
+			e = i;
+			empty_slot_found = 1;
+			break;
 		}
 	}
 
@@ -335,7 +498,7 @@ static inline struct htable_el *htable_lookup_add(struct htable *ht, const hash5
 	}
 
 	/* insert new element */
-	hash_copy(b->h[e], h, ht->hlen);
+	_htable_bkt_sethash(b, e, h, ht->hlen);
 	el = _htable_bkt_el(b, e);
 	if (!ht->head) {
 		ht->head = el;
@@ -373,6 +536,7 @@ static inline void htable_rm(struct htable *ht, struct htable_el *el)
 
 	/* clear hash value */
 	hash_clear(*el->h, ht->hlen);
+	*el->fp = 0;
 }
 
 /*
@@ -391,8 +555,10 @@ static inline void htable_clear(struct htable *ht)
 {
 	struct htable_el *el;
 
-	foreach_htable_el(ht, el)
+	foreach_htable_el(ht, el) {
 		hash_clear(*el->h, ht->hlen);
+		*el->fp = 0;
+	}
 	ht->head = NULL;
 	ht->tail = NULL;
 }
@@ -53,6 +53,9 @@ static err_t httpsess_recv   (void *argp, struct tcp_pcb *tpcb, struct pbuf *p,
 static void  httpsess_error  (void *argp, err_t err);
 static err_t httpsess_poll   (void *argp, struct tcp_pcb *tpcb);
 static err_t httpsess_acknowledge(struct http_sess *hsess, size_t len);
+#ifdef HTTP_PREFETCH
+static inline void httpsess_prefetch(struct http_sess *hsess);
+#endif
 static int httprecv_req_complete(struct http_parser *parser);
 static int httprecv_hdr_url(struct http_parser *parser, const char *buf, size_t len);
 
@@ -72,10 +75,16 @@ int init_http(uint16_t nb_sess, uint32_t nb_reqs)
 	err_t err;
 	int ret = 0;
 
+#ifdef HTTP_HOTCACHE
+	ret = http_hot_init();
+	if (ret < 0)
+		return ret;
+#endif
+
 	hs = target_malloc(CACHELINE_SIZE, sizeof(*hs));
 	if (!hs) {
 		ret = -ENOMEM;
-		goto err_out;
+		goto err_exit_hot;
 	}
 	hs->max_nb_sess = nb_sess;
 	hs->nb_sess = 0;
@@ -139,7 +148,11 @@ int init_http(uint16_t nb_sess, uint32_t nb_reqs)
 	free_mempool(hs->sess_pool);
  err_free_hs:
 	target_free(hs);
- err_out:
+	hs = NULL;
+ err_exit_hot:
+#ifdef HTTP_HOTCACHE
+	http_hot_exit();
+#endif
 	return ret;
 }
 
@@ -159,6 +172,9 @@ void exit_http(void)
 	free_mempool(hs->sess_pool);
 	target_free(hs);
 	hs = NULL;
+#ifdef HTTP_HOTCACHE
+	http_hot_exit();
+#endif
 }
 
 /*******************************************************************************
@@ -227,6 +243,9 @@ static inline struct http_req *httpreq_open(struct http_sess *hsess)
 	hreq->response.ftr_acked_len = 0;
 	hreq->smsg = NULL;
 	hreq->fd = NULL;
+#ifdef HTTP_HOTCACHE
+	hreq->hot = NULL;
+#endif
 	hreq->rlen = 0;
 	hreq->alen = 0;
 	hreq->is_stream = 0;
@@ -260,6 +279,10 @@ static inline void httpreq_close(struct http_req *hreq)
 		default:
 			break;
 		}
+#ifdef HTTP_HOTCACHE
+		if (hreq->hot)
+			http_hot_put(hreq->hot);
+#endif
 		shfs_fio_close(hreq->fd);
 	}
 	mempool_put(hreq->pobj);
@@ -297,6 +320,13 @@ static err_t httpsess_accept(void *argp, struct tcp_pcb *new_tpcb, err_t err)
 	hsess->aqueue_tail = NULL;
 	hsess->retry_replychain = 0;
 	hsess->_in_respond = 0;
+	shfs_cache_rastate_init(&hsess->ra);
+#ifdef HTTP_FIO_PINNING
+	hsess->pin_head = 0;
+	hsess->pin_len = 0;
+	hsess->pin_sent = 0;
+	hsess->pin_acked = 0;
+#endif
 
 	/* register tpcb */
 	hsess->tpcb = new_tpcb;
@@ -382,6 +412,9 @@ static err_t httpsess_close(struct http_sess *hsess, enum http_sess_close type)
 		httpreq_close(hreq);
 	if (hsess->cpreq)
 		httpreq_close(hsess->cpreq);
+#ifdef HTTP_FIO_PINNING
+	httpsess_unpin(hsess, 1);
+#endif
 
 	/* terminate connection */
 	switch (type) {
@@ -511,8 +544,17 @@ static err_t httpsess_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err
 				hsess->retry_replychain = 1;
 				goto out;
 			}
+#ifdef HTTP_PREFETCH
+			if (ret != ERR_OK)
+				goto out; /* connection got aborted */
+#else
 			goto out;
+#endif
 		}
+#ifdef HTTP_PREFETCH
+		if (hsess->rqueue_len > 1 && hsess->rqueue_len != prev_rqueue_len)
+			httpsess_prefetch(hsess);
+#endif
 		break;
 	default:
 		/* this case never happens */
@@ -614,6 +656,9 @@ err_t httpsess_write(struct http_sess *hsess, const void* buf, size_t *len, uint
 #endif
 	printd("leaving: sent %"PRIu64"/%"PRIu64" bytes\n", (uint64_t) s, (uint64_t) (*len));
 	hsess->sent_infly += s;
+#ifdef HTTP_FIO_PINNING
+	hsess->pin_sent += s;
+#endif
 	*len = s;
 	return err;
 }
@@ -625,6 +670,10 @@ static err_t httpsess_sent(void *argp, struct tcp_pcb *tpcb, uint16_t len)
 	printd("ACK for session %p\n", hsess);
 
 	hsess->sent_infly -= len;
+#ifdef HTTP_FIO_PINNING
+	hsess->pin_acked += len;
+	httpsess_unpin(hsess, 0);
+#endif
 	switch (hsess->state) {
 	case HSS_ESTABLISHED:
 		if (len)
@@ -753,8 +802,9 @@ static inline void httpreq_prepare_hdr(struct http_req *hreq)
 	char strsbuf[64];
 	char strlbuf[128];
 
-	/* check request method (GET, POST, ...) */
-	if (hreq->request.method != HTTP_GET) {
+	/* check request method (GET, HEAD, POST, ...) */
+	if (hreq->request.method != HTTP_GET &&
+	    hreq->request.method != HTTP_HEAD) {
 		printd("Invalid/unsupported request method: %u HTTP/%hu.%hu\n",
 		        hreq->request.method,
 		        hreq->request.http_major,
@@ -763,7 +813,8 @@ static inline void httpreq_prepare_hdr(struct http_req *hreq)
 	}
 
 #ifdef HTTP_DEBUG
-	printd("GET %s HTTP/%hu.%hu\n",
+	printd("%s %s HTTP/%hu.%hu\n",
+	        http_method_str(hreq->request.method),
 	        hreq->request.url,
 	        hreq->request.http_major,
 	        hreq->request.http_minor);
@@ -794,21 +845,47 @@ static inline void httpreq_prepare_hdr(struct http_req *hreq)
 		if (hash_is_max(h, shfs_vol.hlen))
 			goto testfile_hdr1; /* infinite testfile */
 	}
+#endif
+#ifdef HTTP_PREFETCH
+	if (hreq->fd)
+		goto link_hdr; /* remote link was opened by httpsess_prefetch() */
 #endif
 	hreq->fd = shfs_fio_open(&hreq->request.url[url_offset]);
 	if (!hreq->fd) {
+		if (errno == EAGAIN)
+			goto retry_hdr; /* hash table chunk is being loaded */
 		printd("Could not open requested file '%s': %s\n", &hreq->request.url[url_offset], strerror(errno));
 		if (errno == ENOENT || errno == ENODEV)
 			goto err404_hdr; /* 404 File not found */
 		goto err500_hdr; /* 500 Internal server error */
 	}
+#ifdef SHFS_VARIANTS
+	if (shfs_fio_vnext(hreq->fd)) {
+		hreq->fd = http_open_variant(&hreq->request.hdr, hreq->fd);
+		if (!hreq->fd)
+			goto retry_hdr; /* hash table chunk of a variant is being loaded */
+	}
+#endif
 #if defined SHFS_STATS && defined SHFS_STATS_HTTP
 	hreq->stats.el_stats = shfs_stats_from_fd(hreq->fd);
 #endif
 	if (shfs_fio_islink(hreq->fd)) {
 		if (shfs_fio_link_type(hreq->fd) == SHFS_LTYPE_REDIRECT)
 			goto red307_hdr; /* 307 temporary moved */
+		if (hreq->request.method == HTTP_HEAD) {
+			/* remote links are streamed to all clients of an origin connection */
+			shfs_fio_close(hreq->fd);
+			hreq->fd = NULL;
+			goto err501_hdr;
+		}
 
+#ifdef HTTP_PREFETCH
+		/* joining an origin connection would hold back its stream
+		 * until this request is served: defer it */
+		if (hreq != hreq->hsess->rqueue_head)
+			return;
+	link_hdr:
+#endif
 		/**
 		 * REMOTE LINK HANDLING
 		 * Note: header will be built in next phase (HRS_BUILDING_HDR)
@@ -836,6 +913,15 @@ static inline void httpreq_prepare_hdr(struct http_req *hreq)
 	hreq->state = HRS_FINALIZING_HDR;
 	return;
 
+	/**
+	 * RETRY (request stays in HRS_PREPARING_HDR)
+	 */
+ retry_hdr:
+	printd("Hash table entry of '%s' is not resident yet, retrying later\n",
+	       &hreq->request.url[url_offset]);
+	httpsess_register_ioretry(hreq->hsess);
+	return;
+
 	/**
 	 * REDIRECT HEADER
 	 */
@@ -937,6 +1023,33 @@ static inline void httpreq_prepare_hdr(struct http_req *hreq)
 	return;
 }
 
+#ifdef HTTP_PREFETCH
+/* Prepares the response of queued (pipelined) requests behind the one that
+ * is currently served and starts reading their first chunk of file data:
+ * disk latency overlaps with sending the current response */
+static inline void httpsess_prefetch(struct http_sess *hsess)
+{
+	struct http_req *hreq;
+	unsigned int i;
+
+	if (!hsess->rqueue_head)
+		return;
+
+	for (hreq = hsess->rqueue_head->next, i = 0;
+	     hreq && i < HTTPSESS_PREFETCH_MAXNB;
+	     hreq = hreq->next, ++i) {
+		if (hreq->state != HRS_PREPARING_HDR || hreq->fd)
+			continue; /* prepared already */
+
+		printd("prefetching queued request %p\n", hreq);
+		httpreq_prepare_hdr(hreq);
+		if (hreq->state == HRS_FINALIZING_HDR &&
+		    hreq->type == HRT_FIOMSG)
+			httpreq_fio_prefetch(hreq);
+	}
+}
+#endif
+
 static inline void httpreq_build_hdr(struct http_req *hreq)
 {
 	size_t nb_slines = 0;
@@ -994,6 +1107,17 @@ static inline void httpreq_finalize_hdr(struct http_req *hreq)
 	register unsigned l;
 #endif
 
+	/* HEAD: header only (Content-length describes the GET response) */
+	if (hreq->request.method == HTTP_HEAD && hreq->type != HRT_NOMSG) {
+		BUG_ON(hreq->type == HRT_LINKMSG);
+		hreq->type = HRT_NOMSG;
+		hreq->rlen = 0;
+		hreq->is_stream = 0;
+	}
+
+	if (http_sendhdr_is_preformatted(&hreq->response.hdr))
+		goto calc_len; /* header cache: default lines are included */
+
 	/* Default header lines */
 	http_sendhdr_add_shdr(&hreq->response.hdr, &nb_slines, HTTP_SHDR_SERVER);
 
@@ -1002,10 +1126,11 @@ static inline void httpreq_finalize_hdr(struct http_req *hreq)
 		http_sendhdr_add_shdr(&hreq->response.hdr, &nb_slines, HTTP_SHDR_CONN_CLOSE);
 	else
 		http_sendhdr_add_shdr(&hreq->response.hdr, &nb_slines, HTTP_SHDR_CONN_KEEPALIVE);
-
-	/* Calculate final header length */
 	http_sendhdr_set_nbslines(&hreq->response.hdr, nb_slines);
 	http_sendhdr_set_nbdlines(&hreq->response.hdr, nb_dlines);
+
+ calc_len:
+	/* Calculate final header length */
 	hreq->response.hdr_total_len = http_sendhdr_calc_totallen(&hreq->response.hdr);
 
 #ifdef HTTP_DEBUG
@@ -1109,6 +1234,9 @@ static inline int httpsess_eor(struct http_sess *hsess)
 		hsess->rqueue_head = hreq->next;
 		--hsess->rqueue_len;
 		httpreq_finalize(hreq);
+#ifdef HTTP_PREFETCH
+		httpsess_prefetch(hsess);
+#endif
 		return 1;
 	} else {
 		/* close connection/wait because of keepalive */
@@ -1151,6 +1279,8 @@ err_t httpsess_respond(struct http_sess *hsess)
 	switch (hreq->state) {
 	case HRS_PREPARING_HDR: /* atomic -> direct state transition */
 		httpreq_prepare_hdr(hreq);
+		if (hreq->state == HRS_PREPARING_HDR)
+			break; /* file could not be opened yet: retried with I/O */
 		if (hreq->state == HRS_FINALIZING_HDR) {
 			/* skipping next phase requested */
 			goto case_FINALIZING_HDR;
@@ -1186,6 +1316,16 @@ err_t httpsess_respond(struct http_sess *hsess)
 
 		if (hsess->sent == hreq->response.hdr_total_len) {
 			/* we are done -> switch to next phase */
+#if defined HTTP_HOTCACHE && defined SHFS_STATS && defined SHFS_STATS_HTTP
+			if (hreq->hot) {
+				/* object data was part of the header */
+#ifdef SHFS_STATS_HTTP_DPC
+				while (hreq->stats.dpc_i < SHFS_STATS_HTTP_DPCR)
+					++hreq->stats.el_stats->p[hreq->stats.dpc_i++];
+#endif
+				++hreq->stats.el_stats->c;
+			}
+#endif
 			if (hreq->type == HRT_NOMSG)
 				goto case_HRS_RESPONDING_EOM;
 			goto case_HRS_RESPONDING_MSG;
@@ -1462,6 +1602,7 @@ int shcmd_http_info(FILE *cio, int argc, char *argv[])
 		link_nb_buffers = httpreq_link_nb_buffers(shfs_vol.chunksize);
 		link_bffrlen = shfs_vol.chunksize * link_nb_buffers;
 	}
+
 	ps_sess  = mempool_size(hs->sess_pool);
 	ps_reqs  = mempool_size(hs->req_pool);
 	ps_links = mempool_size(hs->link_pool);
@@ -1482,6 +1623,9 @@ int shcmd_http_info(FILE *cio, int argc, char *argv[])
 	fprintf(cio, " (Warning: low buffer space!)");
 #endif
 	fprintf(cio, "\n");
+#ifdef HTTP_HOTCACHE
+	http_hot_info(cio);
+#endif
 	fprintf(cio, " HTTP parser version:                     %2hu.%hu.%hu\n",
 	        (pver >> 16) & 255, /* major */
 	        (pver >> 8) & 255, /* minor */
@@ -84,6 +84,10 @@ static const char __http_shdr34[] = "Accept-ranges: bytes\r\n";
 static const char __http_shdr35[] = "Transfer-encoding: chunked\r\n";
 static const char __http_shdr36[] = "User-Agent: "HTTP_SERVER_AGENT"\r\n";
 static const char __http_shdr37[] = "Cache-control: no-store, no-cache, must-revalidate, pre-check=0, post-check=0, max-age=0\r\n";
+static const char __http_shdr38[] = "HTTP/0.9 304\r\n";
+static const char __http_shdr39[] = "HTTP/1.0 304 Not modified\r\n";
+static const char __http_shdr40[] = "HTTP/1.1 304 Not modified\r\n";
+static const char __http_shdr41[] = "Vary: Accept-Encoding\r\n";
 
 static const char * const _http_shdr[] = {
 	__http_shdr00, __http_shdr01, __http_shdr02, __http_shdr03, __http_shdr04,
@@ -93,7 +97,8 @@ static const char * const _http_shdr[] = {
 	__http_shdr20, __http_shdr21, __http_shdr22, __http_shdr23, __http_shdr24,
 	__http_shdr25, __http_shdr26, __http_shdr27, __http_shdr28, __http_shdr29,
 	__http_shdr30, __http_shdr31, __http_shdr32, __http_shdr33, __http_shdr34,
-	__http_shdr35, __http_shdr36, __http_shdr37
+	__http_shdr35, __http_shdr36, __http_shdr37, __http_shdr38, __http_shdr39,
+	__http_shdr40, __http_shdr41
 };
 static const size_t _http_shdr_len[] = {
 	sizeof(__http_shdr00) - 1, sizeof(__http_shdr01) - 1,
@@ -114,7 +119,9 @@ static const size_t _http_shdr_len[] = {
 	sizeof(__http_shdr30) - 1, sizeof(__http_shdr31) - 1,
 	sizeof(__http_shdr32) - 1, sizeof(__http_shdr33) - 1,
 	sizeof(__http_shdr34) - 1, sizeof(__http_shdr35) - 1,
-	sizeof(__http_shdr36) - 1, sizeof(__http_shdr37) - 1
+	sizeof(__http_shdr36) - 1, sizeof(__http_shdr37) - 1,
+	sizeof(__http_shdr38) - 1, sizeof(__http_shdr39) - 1,
+	sizeof(__http_shdr40) - 1, sizeof(__http_shdr41) - 1
 };
 
 /* Indexes into _http_shdr */
@@ -156,6 +163,10 @@ static const size_t _http_shdr_len[] = {
 #define HTTP_SHDR_ENC_CHUNKED    35 /* Transfer-Encoding: chunked */
 #define HTTP_SHDR_USERAGENT      36 /* User agent */
 #define HTTP_SHDR_NOSTORE        37 /* No store */
+#define HTTP09_SHDR_304          38 /* 304 Not modified (HTTP/0.9) */
+#define HTTP10_SHDR_304          39 /* 304 Not modified (HTTP/1.0) */
+#define HTTP11_SHDR_304          40 /* 304 Not modified (HTTP/1.1) */
+#define HTTP_SHDR_VARY_ENCODING  41 /* Vary: Accept-Encoding */
 
 #define HTTP_SHDR_DEFAULT_TYPE   HTTP_SHDR_PLAIN
 
@@ -164,6 +175,8 @@ static const size_t _http_shdr_len[] = {
 	(((major) < 1) ? HTTP09_SHDR_200 : (((minor) < 1) ? HTTP10_SHDR_200 : HTTP11_SHDR_200))
 #define HTTP_SHDR_206(major, minor) \
 	(((major) < 1) ? HTTP09_SHDR_206 : (((minor) < 1) ? HTTP10_SHDR_206 : HTTP11_SHDR_206))
+#define HTTP_SHDR_304(major, minor) \
+	(((major) < 1) ? HTTP09_SHDR_304 : (((minor) < 1) ? HTTP10_SHDR_304 : HTTP11_SHDR_304))
 #define HTTP_SHDR_307(major, minor) \
 	(((major) < 1) ? HTTP09_SHDR_307 : (((minor) < 1) ? HTTP10_SHDR_307 : HTTP11_SHDR_307))
 #define HTTP_SHDR_400(major, minor) \
@@ -186,10 +199,14 @@ static const char __http_dhdr03[] = "Retry-after";
 static const char __http_dhdr04[] = "Location";
 static const char __http_dhdr05[] = "Host";
 static const char __http_dhdr06[] = "Icy-metadata";
+static const char __http_dhdr07[] = "ETag";
+static const char __http_dhdr08[] = "Last-modified";
+static const char __http_dhdr09[] = "Content-encoding";
 
 static const char * const _http_dhdr[] = {
 	__http_dhdr00, __http_dhdr01, __http_dhdr02, __http_dhdr03,
-	__http_dhdr04, __http_dhdr05, __http_dhdr06
+	__http_dhdr04, __http_dhdr05, __http_dhdr06, __http_dhdr07,
+	__http_dhdr08, __http_dhdr09
 };
 
 #define HTTP_DHDR_MIME            0 /* content-type */
@@ -199,6 +216,16 @@ static const char * const _http_dhdr[] = {
 #define HTTP_DHDR_LOCATION        4 /* location */
 #define HTTP_DHDR_HOST            5 /* host */
 #define HTTP_DHDR_ICYMETADATA     6 /* Icy-metadata */
+#define HTTP_DHDR_ETAG            7 /* entity tag */
+#define HTTP_DHDR_LASTMOD         8 /* last-modified */
+#define HTTP_DHDR_ENCODING        9 /* content-encoding */
+
+/* Content codings of pre-encoded variants in order of server preference
+ * (applied when the client weights multiple codings equally) */
+static const char * const _http_encpref[] = {
+	"br", "zstd", "gzip"
+};
+#define HTTP_NB_ENCPREF (sizeof(_http_encpref) / sizeof(_http_encpref[0]))
 
 static const char _http_err404p[] = \
 	"<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
@@ -92,7 +92,14 @@
 #endif
 
 #define HTTPREQ_FIO_MAXNB_BUFFERS         (SMAX(2,(DIV_ROUND_UP(HTTPREQ_SNDBUF, SHFS_MIN_CHUNKSIZE))))
+#define HTTPREQ_FIO_MAXNB_RANGES          8 /* max. nb of ranges in a multipart/byteranges response */
 #define HTTPREQ_LINK_MAXNB_BUFFERS        (SMAX(2,((DIV_ROUND_UP(HTTPREQ_SNDBUF, SHFS_MIN_CHUNKSIZE)) << 1)))
+#ifdef HTTP_FIO_PINNING
+#define HTTPSESS_MAXNB_PINS               (HTTPREQ_FIO_MAXNB_BUFFERS << 1) /* nb of cache buffers a session can pin (see: http_fio.h) */
+#endif
+#ifdef HTTP_PREFETCH
+#define HTTPSESS_PREFETCH_MAXNB           4 /* nb of queued (pipelined) requests that are prepared ahead */
+#endif
 
 #ifndef min
 #define min(a, b) \
@@ -156,6 +163,15 @@ struct http_srv {
 
 extern struct http_srv *hs;
 
+#ifdef HTTP_FIO_PINNING
+/* cache buffer that is referenced by data in flight:
+ * it is released as soon as the client acknowledged all session bytes up to end */
+struct http_sess_pin {
+	struct shfs_cache_entry *cce;
+	uint64_t end;
+};
+#endif
+
 enum http_sess_state {
 	HSS_UNDEF = 0,
 	HSS_ESTABLISHED,
@@ -185,6 +201,15 @@ struct http_sess {
 	struct http_req *aqueue_tail;
 	unsigned int rqueue_len; /* current number of simultaneous requests */
 
+	struct shfs_cache_rastate ra; /* read-ahead state of the requests of this session */
+#ifdef HTTP_FIO_PINNING
+	struct http_sess_pin pin[HTTPSESS_MAXNB_PINS]; /* ring of pinned cache buffers */
+	unsigned int pin_head;
+	unsigned int pin_len;
+	uint64_t pin_sent;  /* total nb of bytes passed to TCP */
+	uint64_t pin_acked; /* total nb of bytes acknowledged by the client */
+#endif
+
 	int retry_replychain; /* marker for rare cases: reply could not be initiated
 	                       * within recv because of ERR_MEM */
 	int _in_respond;      /* diables recursive httpsess_respond calls DELETEME */
@@ -219,21 +244,28 @@ enum http_req_type {
 struct http_req_fio_state { /* defined in http_fio.h */
 	/* SHFS I/O */
 	uint64_t fsize; /* file size */
-	uint64_t rfirst; /* (requested) first byte to read from file */
-	uint64_t rlast;  /* (requested) last byte to read from file */
-	chk_t volchk_first;
-	chk_t volchk_last;
-	uint32_t volchkoff_first;
-	uint32_t volchkoff_last;
+	struct http_range range[HTTPREQ_FIO_MAXNB_RANGES]; /* (requested) ranges to read from file */
+	uint64_t range_boff[HTTPREQ_FIO_MAXNB_RANGES]; /* offset of range data in message body */
+	unsigned int nb_ranges;
+	unsigned int range_idx; /* range that is currently sent */
+	uint32_t boundary; /* multipart/byteranges boundary (nb_ranges > 1) */
 
 	struct shfs_cache_entry *cce[HTTPREQ_FIO_MAXNB_BUFFERS];
 	SHFS_AIO_TOKEN *cce_t;
 	unsigned int cce_idx;
+	int cce_reqd; /* cce[cce_idx] was requested for the current range position */
 	unsigned int cce_idx_ack;
 	unsigned int cce_max_nb;
+	int ra_init; /* session read-ahead state was restarted for this request */
+#ifdef HTTP_HOTCACHE
+	int hot_fill; /* object data is passed to the hot object tier when read */
+#endif
 };
 
 struct http_req_link_origin; /* defined in http_link.h */
+#ifdef HTTP_HOTCACHE
+struct http_hot; /* defined in http_hot.h */
+#endif
 
 struct http_req_link_state {
 	struct http_req_link_origin *origin;
@@ -285,6 +317,9 @@ struct http_req {
 		struct http_req_fio_state  f;
 		struct http_req_link_state l;
 	};
+#ifdef HTTP_HOTCACHE
+	struct http_hot *hot; /* hot object that is sent (see: http_hot.h) */
+#endif
 
 #if defined SHFS_STATS && defined SHFS_STATS_HTTP
 	struct {
@@ -321,6 +356,145 @@ struct http_req {
 
 #define httpsess_flush(hsess) tcp_output((hsess)->tpcb)
 
+#ifdef SHFS_VARIANTS
+/*
+ * Content negotiation between an opened object and its pre-encoded variants
+ * (Accept-Encoding). Returns the file descriptor to serve: Either fd itself
+ * or an opened variant, fd is closed in the latter case.
+ * NULL is returned (fd is closed, errno is EAGAIN) when a variant could not
+ * be inspected yet because its hash table chunk is being loaded.
+ * Equally weighted codings are resolved by _http_encpref, identity comes last.
+ */
+static inline SHFS_FD http_open_variant(struct http_recv_hdr *rhdr, SHFS_FD fd)
+{
+	char enc[sizeof(((struct shfs_hentry *) 0)->f_attr.encoding) + 1];
+	const char *value;
+	SHFS_FD v, vsel = NULL;
+	unsigned int p, psel;
+	int q, qsel;
+	int l;
+
+	l = http_recvhdr_findfield(rhdr, "accept-encoding");
+	if (l < 0)
+		return fd;
+	value = rhdr->line[l].value.b;
+
+	qsel = http_accept_encoding_q(value, "identity");
+	if (qsel < 0)
+		qsel = 1000; /* identity is acceptable unless excluded */
+	psel = HTTP_NB_ENCPREF + 1;
+	for (v = shfs_fio_vnext(fd); v; v = shfs_fio_vnext(v)) {
+		if (shfs_fio_encoding(v, enc, sizeof(enc)) == -EAGAIN) {
+			shfs_fio_close(fd);
+			errno = EAGAIN;
+			return NULL;
+		}
+		q = http_accept_encoding_q(value, enc);
+		if (q <= 0)
+			continue;
+		for (p = 0; p < HTTP_NB_ENCPREF; ++p) {
+			if (strcasecmp(enc, _http_encpref[p]) == 0)
+				break;
+		}
+		if (q > qsel || (q == qsel && p < psel)) {
+			vsel = v;
+			qsel = q;
+			psel = p;
+		}
+	}
+	if (!vsel)
+		return fd;
+
+	v = shfs_fio_openv(vsel);
+	if (!v) {
+		if (errno == EAGAIN) {
+			shfs_fio_close(fd);
+			return NULL;
+		}
+		return fd; /* variant is being updated: serve identity */
+	}
+	shfs_fio_close(fd);
+	return v;
+}
+#endif
+
+#ifdef HTTP_HDRCACHE
+/*
+ * Header cache: Complete 200 response header of an object for HTTP/1.1
+ * keep-alive requests, it is attached to the object as persistent cookie
+ * on first access. Range, conditional and all other responses are still
+ * built per request.
+ */
+struct http_hdrcache {
+	char etag[HTTP_ETAG_MAXLEN];
+	int vary; /* object had variants when the header was built */
+#ifdef HTTP_HOTCACHE
+	struct http_hot *hot; /* object data (see: http_hot.h) */
+#endif
+	size_t len;
+	char b[];
+};
+
+#ifdef SHFS_VARIANTS
+#define _http_hdrcache_vary(fd) \
+	(shfs_fio_hasvariants((fd)) ? 1 : 0)
+#else
+#define _http_hdrcache_vary(fd) \
+	(0)
+#endif
+
+#define http_hdrcache_applicable(http_major, http_minor, keepalive) \
+	((http_major) == 1 && (http_minor) >= 1 && (keepalive))
+
+/* returns the header cache of an object (NULL if there is none usable) */
+static inline struct http_hdrcache *http_hdrcache_get(SHFS_FD fd)
+{
+	struct http_hdrcache *hc = shfs_fio_get_pcookie(fd);
+
+	if (hc && unlikely(hc->vary != _http_hdrcache_vary(fd)))
+		return NULL; /* variants were (un)registered by a remount */
+	return hc;
+}
+
+/*
+ * Completes a 200 response header of an object with the default lines
+ * of a keep-alive response, attaches it as header cache and replaces shdr
+ * with it. On errors (e.g., out of memory), shdr is left unmodified.
+ */
+static inline int http_hdrcache_fill(SHFS_FD fd, struct http_send_hdr *shdr, const char *etag)
+{
+	struct http_hdrcache *hc;
+	size_t nb_slines = http_sendhdr_get_nbslines(shdr);
+	size_t len;
+
+	if (shfs_fio_get_pcookie(fd))
+		return -EBUSY; /* an outdated one is still attached */
+
+	http_sendhdr_add_shdr(shdr, &nb_slines, HTTP_SHDR_SERVER);
+	http_sendhdr_add_shdr(shdr, &nb_slines, HTTP_SHDR_CONN_KEEPALIVE);
+	http_sendhdr_set_nbslines(shdr, nb_slines);
+	len = http_sendhdr_calc_totallen(shdr);
+
+	hc = target_malloc(CACHELINE_SIZE, sizeof(*hc) + len + 1);
+	if (unlikely(!hc)) {
+		http_sendhdr_set_nbslines(shdr, nb_slines - 2);
+		return -ENOMEM;
+	}
+	strncpy(hc->etag, etag, sizeof(hc->etag));
+	hc->vary = _http_hdrcache_vary(fd);
+#ifdef HTTP_HOTCACHE
+	hc->hot = NULL;
+#endif
+	hc->len = len;
+	http_sendhdr_serialize(shdr, hc->b);
+	hc->b[len] = '\0'; /* for debug output */
+	shfs_fio_set_pcookie(fd, hc);
+
+	http_sendhdr_set_preformatted(shdr, hc->b, hc->len);
+	return 0;
+}
+#endif
+
 err_t httpsess_write(struct http_sess *hsess, const void* buf, size_t *len, uint8_t apiflags);
 err_t httpsess_respond(struct http_sess *hsess);
 
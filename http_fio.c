@@ -43,7 +43,17 @@ void httpreq_fio_aiocb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
 	printd("Chunk %"PRIchk" loaded (cce: %p, t: %p/%p)\n", hreq->f.cce[hreq->f.cce_idx]->addr, hreq->f.cce[hreq->f.cce_idx], hreq->f.cce_t, t);
 
 	BUG_ON(t != hreq->f.cce_t);
+#ifdef HTTP_PREFETCH
+	if (hreq->state != HRS_RESPONDING_MSG) {
+		/* prefetched chunk of a queued request (see: httpreq_fio_prefetch()):
+		 * it is picked up when the request gets served */
+		shfs_aio_finalize(t);
+		hreq->f.cce_t = NULL;
+		return;
+	}
+#else
 	BUG_ON(hreq->state != HRS_RESPONDING_MSG);
+#endif
 
 	shfs_aio_finalize(t);
 	hreq->f.cce_t = NULL;
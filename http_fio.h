@@ -39,6 +39,9 @@
 
 #include "http_defs.h"
 #include "http_hdr.h"
+#ifdef HTTP_HOTCACHE
+#include "http_hot.h"
+#endif
 
 #define httpreq_fio_nb_buffers(chunksize)  (max(2,(DIV_ROUND_UP(HTTPREQ_SNDBUF, (size_t) chunksize))))
 
@@ -48,6 +51,146 @@ void httpreq_fio_aiocb(SHFS_AIO_TOKEN *t, void *cookie, void *argp);
 #define httpreq_fio_nextidx(fstate, idx) \
         ((idx + 1) % (hreq)->f.cce_max_nb)
 
+#ifdef HTTP_FIO_PINNING
+/*
+ * File data is passed to tcp_write() without copying it, so lwIP references
+ * cache buffers until the client acknowledged the data (retransmissions).
+ * Instead of keeping them on the buffer ring of a request (see:
+ * httpreq_ack_fio()), a session pins the buffers of its data in flight:
+ * A buffer slot of a request can be reused as soon as the chunk was passed
+ * to TCP and the pinned reference is dropped from the sent callback.
+ */
+#define httpsess_pin_tail(hsess) \
+	(&(hsess)->pin[((hsess)->pin_head + (hsess)->pin_len - 1) % HTTPSESS_MAXNB_PINS])
+
+/* returns 1 if writing data from cce requires a new pin */
+static inline int httpsess_pin_needed(struct http_sess *hsess, struct shfs_cache_entry *cce)
+{
+	return (!hsess->pin_len || httpsess_pin_tail(hsess)->cce != cce);
+}
+
+/* pins cce up to the last byte that was passed to TCP */
+static inline void httpsess_pin(struct http_sess *hsess, struct shfs_cache_entry *cce)
+{
+	struct http_sess_pin *pin;
+
+	if (httpsess_pin_needed(hsess, cce)) {
+		BUG_ON(hsess->pin_len == HTTPSESS_MAXNB_PINS);
+
+		shfs_cache_ref(cce);
+		++hsess->pin_len;
+	}
+	pin = httpsess_pin_tail(hsess);
+	pin->cce = cce;
+	pin->end = hsess->pin_sent;
+}
+
+/* releases pinned buffers of acknowledged data (all of them if all != 0) */
+static inline void httpsess_unpin(struct http_sess *hsess, int all)
+{
+	struct http_sess_pin *pin;
+
+	while (hsess->pin_len) {
+		pin = &hsess->pin[hsess->pin_head];
+		if (!all && pin->end > hsess->pin_acked)
+			break;
+
+		printd("Releasing pinned buffer of chunk %"PRIchk" (end: %"PRIu64", acked: %"PRIu64")\n",
+		       pin->cce->addr, pin->end, hsess->pin_acked);
+		shfs_cache_release(pin->cce); /* calls notify_retry */
+		hsess->pin_head = (hsess->pin_head + 1) % HTTPSESS_MAXNB_PINS;
+		--hsess->pin_len;
+	}
+}
+#endif
+
+/*
+ * Byte ranges
+ *
+ * The message body consists of the data of the requested ranges. In case of
+ * multiple ranges (multipart/byteranges), each range is preceded by a part
+ * header and the body is terminated by a closing delimiter:
+ *
+ *  [part hdr 0][range 0][part hdr 1][range 1]...[closing delimiter]
+ *
+ * range_boff[i] is the offset of the data of range i in the message body.
+ */
+#define HTTPREQ_FIO_MPHDR_MAXLEN 192
+
+#define httpreq_fio_multipart(hreq) \
+	((hreq)->f.nb_ranges > 1)
+#define httpreq_fio_rlen(hreq, i) \
+	((hreq)->f.range[(i)].last + 1 - (hreq)->f.range[(i)].first)
+#define httpreq_fio_bend(hreq, i) /* offset after data of range i in body */ \
+	((hreq)->f.range_boff[(i)] + httpreq_fio_rlen((hreq), (i)))
+
+/* formats the part header of range i into buf (closing delimiter if i == nb_ranges) */
+static inline size_t httpreq_fio_mphdr(struct http_req *hreq, unsigned int i, char *buf, size_t len)
+{
+	char strsbuf[64];
+	int ret;
+
+	if (i == hreq->f.nb_ranges)
+		return (size_t) snprintf(buf, len, "\r\n--%08"PRIx32"--\r\n", hreq->f.boundary);
+
+	shfs_fio_mime(hreq->fd, strsbuf, sizeof(strsbuf));
+	if (strsbuf[0] == '\0')
+		ret = snprintf(buf, len, "\r\n--%08"PRIx32"\r\n%s%s%"PRIu64"-%"PRIu64"/%"PRIu64"\r\n\r\n",
+		               hreq->f.boundary, _http_shdr[HTTP_SHDR_DEFAULT_TYPE],
+		               _http_dhdr[HTTP_DHDR_RANGE],
+		               hreq->f.range[i].first, hreq->f.range[i].last, hreq->f.fsize);
+	else
+		ret = snprintf(buf, len, "\r\n--%08"PRIx32"\r\n%s: %s\r\n%s%"PRIu64"-%"PRIu64"/%"PRIu64"\r\n\r\n",
+		               hreq->f.boundary, _http_dhdr[HTTP_DHDR_MIME], strsbuf,
+		               _http_dhdr[HTTP_DHDR_RANGE],
+		               hreq->f.range[i].first, hreq->f.range[i].last, hreq->f.fsize);
+	BUG_ON(ret < 0 || (size_t) ret >= len);
+	return (size_t) ret;
+}
+
+/*
+ * Returns the number of cache buffers that are consumed before body offset
+ * boff. Each range uses its own sequence of buffers on the buffer ring,
+ * even if neighboring ranges share a chunk.
+ */
+static inline uint64_t httpreq_fio_bufseq(struct http_req *hreq, size_t boff)
+{
+	register uint64_t seq = 0;
+	register unsigned int i;
+	chk_t first_chk;
+
+	for (i = 0; i < hreq->f.nb_ranges; ++i) {
+		if (httpreq_fio_rlen(hreq, i) == 0)
+			break;
+		first_chk = shfs_volchk_foff(hreq->fd, hreq->f.range[i].first);
+		if (boff < httpreq_fio_bend(hreq, i)) {
+			if (boff > hreq->f.range_boff[i])
+				seq += shfs_volchk_foff(hreq->fd, hreq->f.range[i].first +
+				                        (boff - hreq->f.range_boff[i])) - first_chk;
+			break;
+		}
+		seq += shfs_volchk_foff(hreq->fd, hreq->f.range[i].last) - first_chk + 1;
+	}
+	return seq;
+}
+
+/* writes the remaining part of the multipart header at body offset *sent */
+static inline err_t httpreq_write_fio_mphdr(struct http_req *hreq, size_t *sent)
+{
+	char buf[HTTPREQ_FIO_MPHDR_MAXLEN];
+	register unsigned int i = hreq->f.range_idx;
+	size_t hlen, hoff, slen;
+	err_t err;
+
+	hlen = httpreq_fio_mphdr(hreq, i, buf, sizeof(buf));
+	hoff = hlen - ((i == hreq->f.nb_ranges ? hreq->rlen : hreq->f.range_boff[i]) - *sent);
+	slen = hlen - hoff;
+	err = httpsess_write(hreq->hsess, buf + hoff, &slen,
+	                     TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
+	*sent += slen;
+	return err;
+}
+
 static inline int httpreq_fio_aioreq(struct http_req *hreq, chk_t addr, unsigned int cce_idx)
 {
 	/* called whenever an async I/O is completed */
@@ -55,12 +198,22 @@ static inline int httpreq_fio_aioreq(struct http_req *hreq, chk_t addr, unsigned
 
 	BUG_ON(hreq->f.cce_t);
 
-	ret = shfs_cache_aread(addr,
-	                       httpreq_fio_aiocb,
-	                       hreq,
-	                       NULL,
-	                       &(hreq->f.cce[cce_idx]),
-			       &(hreq->f.cce_t));
+	/* the read-ahead state is kept per session but restarted with the
+	 * first read of each request: otherwise, the first chunk of the next
+	 * object on a keep-alive connection would be detected as random access.
+	 * Read-ahead does not go beyond the end of the current request */
+	if (!hreq->f.ra_init) {
+		shfs_cache_rastate_init(&(hreq->hsess->ra));
+		hreq->f.ra_init = 1;
+	}
+	hreq->hsess->ra.end = shfs_volchk_foff(hreq->fd, hreq->f.range[hreq->f.range_idx].last) + 1;
+	ret = shfs_cache_aread_ra(addr,
+	                          &(hreq->hsess->ra),
+	                          httpreq_fio_aiocb,
+	                          hreq,
+	                          NULL,
+	                          &(hreq->f.cce[cce_idx]),
+	                          &(hreq->f.cce_t));
 	if (ret < 0)
 		printd("failed to perform request for chunk %"PRIchk" [cce_idx=%u]: %d\n", addr, cce_idx, ret);
 	else
@@ -68,9 +221,38 @@ static inline int httpreq_fio_aioreq(struct http_req *hreq, chk_t addr, unsigned
 	return ret;
 }
 
+#ifdef HTTP_PREFETCH
+/* requests the first chunk of a queued request while a previous request of
+ * the session is still sent. The session's read-ahead state is not touched
+ * because it follows the stream that is currently served. Failures are
+ * ignored: the chunk is requested again by httpreq_write_fio() */
+static inline void httpreq_fio_prefetch(struct http_req *hreq)
+{
+	chk_t addr;
+	int ret;
+
+	if (hreq->request.method == HTTP_HEAD || !hreq->rlen || hreq->f.cce_reqd)
+		return;
+
+	addr = shfs_volchk_foff(hreq->fd, hreq->f.range[0].first);
+	ret = shfs_cache_aread(addr,
+	                       httpreq_fio_aiocb,
+	                       hreq,
+	                       NULL,
+	                       &(hreq->f.cce[hreq->f.cce_idx]),
+	                       &(hreq->f.cce_t));
+	if (ret < 0) {
+		printd("prefetch of chunk %"PRIchk" failed: %d\n", addr, ret);
+		return;
+	}
+	printd("prefetching chunk %"PRIchk" [cce_idx=%u]: %d\n", addr, hreq->f.cce_idx, ret);
+	hreq->f.cce_reqd = 1;
+}
+#endif
+
 static inline err_t httpreq_write_fio(struct http_req *hreq, size_t *sent)
 {
-	register size_t roff, foff;
+	register size_t foff;
 	register size_t left;
 	register chk_t  cur_chk;
 	register size_t chk_off;
@@ -78,13 +260,13 @@ static inline err_t httpreq_write_fio(struct http_req *hreq, size_t *sent)
 	size_t slen;
 	err_t err;
 	int ret;
+#ifdef HTTP_HOTCACHE
+	struct http_hdrcache *hc;
+#endif
 
 	idx = hreq->f.cce_idx;
-	roff = *sent; /* offset in request */
-	if (unlikely(roff == hreq->rlen))
+	if (unlikely(*sent == hreq->rlen))
 		return ERR_OK; /* request is done already but we got called */
-	foff = roff + hreq->f.rfirst;  /* offset in file */
-	cur_chk = shfs_volchk_foff(hreq->fd, foff);
 
 	/* unlink session from ioretry chain if it was linked before */
 	/* TODO: Still needed? !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
@@ -92,8 +274,48 @@ static inline err_t httpreq_write_fio(struct http_req *hreq, size_t *sent)
  next:
 	err = ERR_OK;
 
+	/* find range of current offset in request */
+	while (hreq->f.range_idx < hreq->f.nb_ranges &&
+	       *sent >= httpreq_fio_bend(hreq, hreq->f.range_idx))
+		++hreq->f.range_idx;
+	if (unlikely(httpreq_fio_multipart(hreq) &&
+	             (hreq->f.range_idx == hreq->f.nb_ranges ||
+	              *sent < hreq->f.range_boff[hreq->f.range_idx]))) {
+		/* part header or closing delimiter */
+		err = httpreq_write_fio_mphdr(hreq, sent);
+		if (unlikely(err != ERR_OK ||
+		             (hreq->f.range_idx < hreq->f.nb_ranges &&
+		              *sent < hreq->f.range_boff[hreq->f.range_idx]))) {
+			printd("sending part header failed, aborting this round\n");
+			httpsess_flush(hreq->hsess); /* send buffer might be full:
+			                                we need to wait for ack */
+			goto out;
+		}
+		if (*sent == hreq->rlen)
+			goto out;
+		goto next;
+	}
+	foff = hreq->f.range[hreq->f.range_idx].first +
+	       (*sent - hreq->f.range_boff[hreq->f.range_idx]); /* offset in file */
+	cur_chk = shfs_volchk_foff(hreq->fd, foff);
+
 	/* is the chunk already requested? */
-	if (unlikely(!hreq->f.cce[idx])) {
+	if (!hreq->f.cce_reqd) {
+		/* is the buffer slot still in use by a previous chunk? */
+		if (unlikely(hreq->f.cce[idx] != NULL)) {
+#ifdef HTTP_FIO_PINNING
+			if (!hreq->f.cce_t) {
+				/* old chunk was passed to TCP already and is pinned */
+				printd("[idx=%u] releasing slot of chunk %"PRIchk"\n", idx, hreq->f.cce[idx]->addr);
+				shfs_cache_release(hreq->f.cce[idx]);
+				hreq->f.cce[idx] = NULL;
+				goto next;
+			}
+#endif
+			printd("[idx=%u] buffer cannot be used yet. client did not acknowledge yet\n", idx);
+			goto out;
+		}
+
 		ret = httpreq_fio_aioreq(hreq, cur_chk, idx);
 		if (unlikely(ret == -EAGAIN)) {
 			/* Retry I/O later because we are out of memory currently */
@@ -109,7 +331,9 @@ static inline err_t httpreq_write_fio(struct http_req *hreq, size_t *sent)
 			httpsess_flush(hreq->hsess); /* enforce sending of enqueued data */
 			err = ERR_ABRT;
 			goto out;
-		} else if (ret == 1) {
+		}
+		hreq->f.cce_reqd = 1;
+		if (ret == 1) {
 			/* current request is not done yet (hit+wait),
 			 * we need to wait. httpsess_response
 			 * will be recalled from within callback */
@@ -120,12 +344,7 @@ static inline err_t httpreq_write_fio(struct http_req *hreq, size_t *sent)
 			goto out; /* we need to wait for completion */
 		}
 	}
-
-	/* is the available chunk the one that we want to send out? */
-	if (unlikely(cur_chk != hreq->f.cce[idx]->addr)) {
-		printd("[idx=%u] buffer cannot be used yet. client did not acknowledge yet\n", idx);
-		goto out;
-	}
+	BUG_ON(cur_chk != hreq->f.cce[idx]->addr);
 
 	/* is the chunk to process ready now? */
 	if (unlikely(!shfs_aio_is_done(hreq->f.cce_t))) {
@@ -141,8 +360,29 @@ static inline err_t httpreq_write_fio(struct http_req *hreq, size_t *sent)
 		goto out;
 	}
 
+#ifdef HTTP_FIO_PINNING
+	if (unlikely(hreq->hsess->pin_len == HTTPSESS_MAXNB_PINS &&
+	             httpsess_pin_needed(hreq->hsess, hreq->f.cce[idx]))) {
+		printd("[idx=%u] all pins in use, waiting for ack\n", idx);
+		httpsess_flush(hreq->hsess); /* we need to wait for ack */
+		goto out;
+	}
+#endif
+
 	chk_off = shfs_volchkoff_foff(hreq->fd, foff);
-	left = min(shfs_vol.chunksize - chk_off, hreq->rlen - roff);
+#ifdef HTTP_HOTCACHE
+	if (unlikely(hreq->f.hot_fill)) {
+		/* the whole object is in this chunk: pass it to the hot object tier */
+		hc = http_hdrcache_get(hreq->fd);
+		if (hc && !hc->hot)
+			http_hot_fill(hreq->fd, hc,
+			              ((uint8_t *) (hreq->f.cce[idx]->buffer)) + chk_off,
+			              hreq->f.fsize);
+		hreq->f.hot_fill = 0;
+	}
+#endif
+	left = min(shfs_vol.chunksize - chk_off,
+	           httpreq_fio_bend(hreq, hreq->f.range_idx) - *sent);
 	slen = left;
 	err  = httpsess_write(hreq->hsess,
 	                      ((uint8_t *) (hreq->f.cce[idx]->buffer)) + chk_off,
@@ -157,15 +397,21 @@ static inline err_t httpreq_write_fio(struct http_req *hreq, size_t *sent)
 	printd("[idx=%u] sent %u bytes (%"PRIu64"-%"PRIu64", left on this chunk: %"PRIu64", available on sndbuf: %"PRIu32", sndqueuelen: %"PRIu16", infly: %"PRIu64")\n",
 	        idx, slen, chk_off, chk_off + slen, left - slen, tcp_sndbuf(hreq->hsess->tpcb),
 	        tcp_sndqueuelen(hreq->hsess->tpcb), (uint64_t) hreq->hsess->sent_infly);
+#ifdef HTTP_FIO_PINNING
+	httpsess_pin(hreq->hsess, hreq->f.cce[idx]);
+	if (slen == left && !hreq->f.cce_t) {
+		/* done with this chunk: the pin keeps it until it is acknowledged */
+		shfs_cache_release(hreq->f.cce[idx]);
+		hreq->f.cce[idx] = NULL;
+	}
+#endif
 
 	/* are we done with this chunkbuffer and there is still data that needs to be sent?
 	 *  -> continue with next buffer */
 	if (slen == left && *sent < hreq->rlen) {
 		printd("[idx=%u] switch to next buffer [idx=%u]\n", idx, httpreq_fio_nextidx(hreq, idx));
 		idx = httpreq_fio_nextidx(hreq, idx);
-		roff += slen; /* new offset */
-		foff += slen;
-		cur_chk = shfs_volchk_foff(hreq->fd, foff);
+		hreq->f.cce_reqd = 0;
 		goto next;
 	}
 
@@ -188,6 +434,13 @@ static inline void httpreq_fio_init(struct http_req *hreq)
 	for (i = 0; i < hreq->f.cce_max_nb; ++i)
 		hreq->f.cce[i] = NULL;
 	hreq->f.cce_t = NULL;
+	hreq->f.cce_reqd = 0;
+	hreq->f.ra_init = 0;
+	hreq->f.nb_ranges = 0;
+	hreq->f.range_idx = 0;
+#ifdef HTTP_HOTCACHE
+	hreq->f.hot_fill = 0;
+#endif
 
 	BUG_ON(hreq->f.cce_max_nb > HTTPREQ_FIO_MAXNB_BUFFERS);
 }
@@ -197,58 +450,99 @@ static inline int httpreq_fio_build_hdr(struct http_req *hreq)
 	size_t nb_slines = http_sendhdr_get_nbslines(&hreq->response.hdr);
 	size_t nb_dlines = http_sendhdr_get_nbdlines(&hreq->response.hdr);
 	char strsbuf[64];
+	char mphdr[HTTPREQ_FIO_MPHDR_MAXLEN];
+	char etagbuf[HTTP_ETAG_MAXLEN];
+	char date[HTTP_DATE_MAXLEN];
+	const char *etag = NULL;
+	hash512_t h;
+	register unsigned int i;
 	int ret;
+#ifdef HTTP_HDRCACHE
+	struct http_hdrcache *hc = NULL;
+	int hdrcache = 0;
+#endif
 
 	httpreq_fio_init(hreq);
 
 	shfs_fio_size(hreq->fd, &hreq->f.fsize);
 
+#ifdef HTTP_HDRCACHE
+	if (http_hdrcache_applicable(hreq->request.http_major, hreq->request.http_minor,
+	                             hreq->request.keepalive)) {
+		hc = http_hdrcache_get(hreq->fd);
+		if (hc)
+			etag = hc->etag;
+	}
+#endif
+
+	/* Validators: conditional requests are answered from the hentry only */
+	if (!etag) {
+		shfs_fio_hash(hreq->fd, h);
+		http_fmt_etag(etagbuf, h, shfs_vol.hlen);
+		etag = etagbuf;
+	}
+	if (http_recvhdr_notmodified(&hreq->request.hdr, etag, shfs_fio_ts_creation(hreq->fd))) {
+		printd("Element was not modified\n");
+		goto not304_hdr;
+	}
+
 	/* File range requested? */
 	hreq->response.code = 200;	/* 200 OK */
-	hreq->f.rfirst = 0;
-	hreq->f.rlast  = hreq->f.fsize - 1;
 	ret = http_recvhdr_findfield(&hreq->request.hdr, "range");
 	if (ret >= 0) {
 		/* Because range requests require different answer codes
 		 * (e.g., 206 OK or 416 EINVAL), we need to check the
-		 * range request here already.
-		 * http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.16 */
-		hreq->response.code = 416;
-		if (strncasecmp("bytes=", hreq->request.hdr.line[ret].value.b, 6) == 0) {
-			uint64_t rfirst;
-			uint64_t rlast;
-
-			ret = sscanf(hreq->request.hdr.line[ret].value.b + 6,
-			             "%"PRIu64"-%"PRIu64,
-			             &rfirst, &rlast);
-			if (ret == 1) {
-				/* only rfirst specified */
-				if (rfirst < hreq->f.rlast) {
-					hreq->f.rfirst = rfirst;
-					hreq->response.code = 206;
-				}
-			} else if (ret == 2) {
-				/* both, rfirst and rlast, specified */
-				if ((rfirst < rlast) &&
-				    (rfirst < hreq->f.rlast) &&
-				    (rlast <= hreq->f.rlast)) {
-					hreq->f.rfirst = rfirst;
-					hreq->f.rlast = rlast;
-					hreq->response.code = 206;
-				}
-			}
-		}
-
-		if (hreq->response.code == 416) {
-			/* (parsing/out of range) error: response with 416 error header */
-			printd("Could not parse range request\n");
+		 * range request here already. */
+		ret = http_parse_ranges(hreq->request.hdr.line[ret].value.b, hreq->f.fsize,
+		                        hreq->f.range, HTTPREQ_FIO_MAXNB_RANGES);
+		if (ret < 0) {
+			/* out of range error: response with 416 error header */
+			printd("Requested ranges are not satisfiable\n");
 			goto err416_hdr;
 		}
+		if (ret > 0) {
+			hreq->f.nb_ranges = (unsigned int) ret;
+			hreq->response.code = 206;
+		}
+		/* otherwise the range field is ignored and the full file is served */
 
-		printd("Client requested range of element: %"PRIu64"-%"PRIu64"\n",
-		        hreq->f.rfirst, hreq->f.rlast);
+		printd("Client requested %u range(s) of element\n", hreq->f.nb_ranges);
+	}
+	if (hreq->f.nb_ranges == 0) {
+		hreq->f.nb_ranges = 1;
+		hreq->f.range[0].first = 0;
+		hreq->f.range[0].last  = hreq->f.fsize - 1;
 	}
 
+#ifdef HTTP_HDRCACHE
+	if (hreq->response.code == 200 &&
+	    http_hdrcache_applicable(hreq->request.http_major, hreq->request.http_minor,
+	                             hreq->request.keepalive)) {
+		if (hc) {
+			/* complete header is already there */
+			hreq->f.range_boff[0] = 0;
+			hreq->rlen = httpreq_fio_rlen(hreq, 0);
+#ifdef HTTP_HOTCACHE
+			if (hreq->request.method == HTTP_GET) {
+				hreq->hot = http_hot_get(hreq->fd, hc, hreq->f.fsize, &hreq->f.hot_fill);
+				if (hreq->hot) {
+					/* object data follows the header: both are sent
+					 * with a single write as preformatted header */
+					hreq->type = HRT_NOMSG;
+					hreq->rlen = 0;
+					http_sendhdr_set_preformatted(&hreq->response.hdr,
+					                              hreq->hot->b, hreq->hot->len);
+					return 0;
+				}
+			}
+#endif
+			http_sendhdr_set_preformatted(&hreq->response.hdr, hc->b, hc->len);
+			return 0;
+		}
+		hdrcache = 1; /* attach this header to the object */
+	}
+#endif
+
 	/* HTTP OK [first line] (code can be 216 or 200) */
 	if (hreq->response.code == 206)
 		http_sendhdr_add_shdr(&hreq->response.hdr, &nb_slines,
@@ -260,6 +554,45 @@ static inline int httpreq_fio_build_hdr(struct http_req *hreq)
 	/* Accept range */
 	http_sendhdr_add_shdr(&hreq->response.hdr, &nb_slines, HTTP_SHDR_ACC_BYTERANGE);
 
+	/* ETag, Last-modified */
+	http_fmt_date(date, sizeof(date), shfs_fio_ts_creation(hreq->fd));
+	http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
+			       "%s: \"%s\"\r\n", _http_dhdr[HTTP_DHDR_ETAG], etag);
+	http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
+			       "%s: %s\r\n", _http_dhdr[HTTP_DHDR_LASTMOD], date);
+
+#ifdef SHFS_VARIANTS
+	/* Content encoding (ranges refer to the encoded content) */
+	if (shfs_fio_hasvariants(hreq->fd))
+		http_sendhdr_add_shdr(&hreq->response.hdr, &nb_slines,
+				      HTTP_SHDR_VARY_ENCODING);
+	if (shfs_fio_isvariant(hreq->fd)) {
+		shfs_fio_encoding(hreq->fd, strsbuf, sizeof(strsbuf));
+		http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
+				       "%s: %s\r\n", _http_dhdr[HTTP_DHDR_ENCODING], strsbuf);
+	}
+#endif
+
+	if (httpreq_fio_multipart(hreq)) {
+		/* multipart/byteranges: MIME and content range are part of each part header */
+		hreq->f.boundary = (uint32_t) target_now_ns();
+		http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
+				       "%s: multipart/byteranges; boundary=%08"PRIx32"\r\n",
+				       _http_dhdr[HTTP_DHDR_MIME], hreq->f.boundary);
+
+		/* Content length (including part headers) */
+		hreq->rlen = 0;
+		for (i = 0; i < hreq->f.nb_ranges; ++i) {
+			hreq->rlen += httpreq_fio_mphdr(hreq, i, mphdr, sizeof(mphdr));
+			hreq->f.range_boff[i] = hreq->rlen;
+			hreq->rlen += httpreq_fio_rlen(hreq, i);
+		}
+		hreq->rlen += httpreq_fio_mphdr(hreq, hreq->f.nb_ranges, mphdr, sizeof(mphdr));
+		http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
+				       "%s: %"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_SIZE], hreq->rlen);
+		goto out;
+	}
+
 	/* MIME (by element or default) */
 	shfs_fio_mime(hreq->fd, strsbuf, sizeof(strsbuf));
 	if (strsbuf[0] == '\0')
@@ -270,7 +603,8 @@ static inline int httpreq_fio_build_hdr(struct http_req *hreq)
 				       "%s: %s\r\n", _http_dhdr[HTTP_DHDR_MIME], strsbuf);
 
 	/* Content length */
-	hreq->rlen = (hreq->f.rlast + 1) - hreq->f.rfirst;
+	hreq->f.range_boff[0] = 0;
+	hreq->rlen = httpreq_fio_rlen(hreq, 0);
 	http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
 			       "%s: %"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_SIZE], hreq->rlen);
 
@@ -279,27 +613,43 @@ static inline int httpreq_fio_build_hdr(struct http_req *hreq)
 		http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
 				       "%s%"PRIu64"-%"PRIu64"/%"PRIu64"\r\n",
 				       _http_dhdr[HTTP_DHDR_RANGE],
-				       hreq->f.rfirst, hreq->f.rlast, hreq->f.fsize);
-
-	/* Initialize volchk range values for I/O */
-	if (hreq->rlen != 0) {
-		hreq->f.volchk_first = shfs_volchk_foff(hreq->fd, hreq->f.rfirst);                     /* first volume chunk of file */
-		hreq->f.volchk_last  = shfs_volchk_foff(hreq->fd, hreq->f.rlast + hreq->f.rfirst);       /* last volume chunk of file */
-		hreq->f.volchkoff_first = shfs_volchkoff_foff(hreq->fd, hreq->f.rfirst);               /* first byte in first chunk */
-		hreq->f.volchkoff_last  = shfs_volchkoff_foff(hreq->fd, hreq->f.rlast + hreq->f.rfirst); /* last byte in last chunk */
-	}
+				       hreq->f.range[0].first, hreq->f.range[0].last, hreq->f.fsize);
  out:
 	http_sendhdr_set_nbslines(&hreq->response.hdr, nb_slines);
 	http_sendhdr_set_nbdlines(&hreq->response.hdr, nb_dlines);
+#ifdef HTTP_HDRCACHE
+	if (hdrcache)
+		http_hdrcache_fill(hreq->fd, &hreq->response.hdr, etag);
+#endif
 	return 0;
 
+ not304_hdr:
+	/* 304 Not modified (no message body) */
+	hreq->response.code = 304;
+	http_sendhdr_add_shdr(&hreq->response.hdr, &nb_slines,
+			      HTTP_SHDR_304(hreq->request.http_major, hreq->request.http_minor));
+	http_fmt_date(date, sizeof(date), shfs_fio_ts_creation(hreq->fd));
+	http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
+			       "%s: \"%s\"\r\n", _http_dhdr[HTTP_DHDR_ETAG], etag);
+	http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
+			       "%s: %s\r\n", _http_dhdr[HTTP_DHDR_LASTMOD], date);
+#ifdef SHFS_VARIANTS
+	if (shfs_fio_hasvariants(hreq->fd))
+		http_sendhdr_add_shdr(&hreq->response.hdr, &nb_slines,
+				      HTTP_SHDR_VARY_ENCODING);
+#endif
+	hreq->type = HRT_NOMSG;
+	goto out;
+
  err416_hdr:
 	/* 416 Range request error */
 	hreq->response.code = 416;
 	http_sendhdr_add_shdr(&hreq->response.hdr, &nb_slines,
 			      HTTP_SHDR_416(hreq->request.http_major, hreq->request.http_minor));
 	http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
-			       "%s: %"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_SIZE], 0);
+			       "%s: %"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_SIZE], (uint64_t) 0);
+	http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
+			       "%s*/%"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_RANGE], hreq->f.fsize);
 	hreq->type = HRT_NOMSG;
 	goto out;
 }
@@ -320,34 +670,31 @@ static inline void httpreq_fio_close(struct http_req *hreq)
 
 static inline void httpreq_ack_fio(struct http_req *hreq, size_t acked)
 {
-	register size_t roff, foff;
-	register chk_t start_chk;
-	register chk_t end_chk;
-	register chk_t nb_chk;
-	register chk_t i;
+#ifndef HTTP_FIO_PINNING
+	register uint64_t nb_bufs;
+	register uint64_t i;
 	register unsigned int idx;
 	struct shfs_cache_entry *cce;
 
-	roff = hreq->alen - acked; /* already ack'ed offset in request */
-	foff = roff + hreq->f.rfirst;  /* offset in file */
-	start_chk = shfs_volchk_foff(hreq->fd, foff);
-	end_chk  = shfs_volchk_foff(hreq->fd, foff + acked);
+	/* number of buffers that are completely acknowledged now */
+	nb_bufs = httpreq_fio_bufseq(hreq, hreq->alen) -
+	          httpreq_fio_bufseq(hreq, hreq->alen - acked);
 
 	printd("Client acknowledged %"PRIu64" bytes from buffers\n", (uint64_t) acked);
-	if (start_chk < end_chk) {
+	if (nb_bufs) {
 		/* release cache buffers */
-		nb_chk = end_chk - start_chk;
 		idx = hreq->f.cce_idx_ack;
-		for (i = 0; i < nb_chk; ++i) {
+		for (i = 0; i < nb_bufs; ++i) {
 			idx = httpreq_fio_nextidx(hreq, idx);
 			printd("[idx=%u] Releasing buffer because data got acknowledged\n", idx);
 			cce = hreq->f.cce[idx];
-			BUG_ON(cce->addr != start_chk + i);
+			BUG_ON(!cce);
 			hreq->f.cce[idx] = NULL;
 			shfs_cache_release(cce); /* calls notify_retry */
 		}
 		hreq->f.cce_idx_ack = idx;
 	}
+#endif /* HTTP_FIO_PINNING: buffers are released by httpsess_unpin() */
 }
 
 #endif
@@ -45,7 +45,7 @@
 
 #define HTTP_RECVHDR_MAXNB_LINES   12
 #define HTTP_SENDHDR_MAXNB_SLINES  8
-#define HTTP_SENDHDR_MAXNB_DLINES  4
+#define HTTP_SENDHDR_MAXNB_DLINES  7
 #define HTTP_HDR_DLINE_MAXLEN      80
 
 #ifndef min
@@ -109,6 +109,7 @@ struct http_send_hdr {
 	uint32_t nb_dlines;
 	size_t dlines_tlen;
 	size_t total_len;
+	int preformatted; /* sline[0] is the complete header (inclusive EOH line) */
 };
 
 #define http_sendhdr_add_sline(shdr, l, bffr, bffr_len) \
@@ -145,7 +146,19 @@ struct http_send_hdr {
 	do { \
 		http_sendhdr_set_nbdlines((shdr), 0);	\
 		http_sendhdr_set_nbslines((shdr), 0);	\
+		(shdr)->preformatted = 0;		\
 	} while(0)
+/* replaces the header with a complete one (e.g., see: http_sendhdr_serialize()) */
+#define http_sendhdr_set_preformatted(shdr, bffr, bffr_len) \
+	do { \
+		(shdr)->sline[0].b = (bffr);		\
+		(shdr)->sline[0].len = (bffr_len);	\
+		http_sendhdr_set_nbslines((shdr), 1);	\
+		http_sendhdr_set_nbdlines((shdr), 0);	\
+		(shdr)->preformatted = 1;		\
+	} while(0)
+#define http_sendhdr_is_preformatted(shdr) \
+	((shdr)->preformatted)
 #define http_sendhdr_calc_totallen(shdr) \
 	({ \
 		register unsigned l;					\
@@ -158,7 +171,9 @@ struct http_send_hdr {
 		for (l = 0; l < (shdr)->nb_dlines; ++l)		\
 		  (shdr)->dlines_tlen += (shdr)->dline[l].len;		\
 		(shdr)->total_len = (shdr)->slines_tlen + (shdr)->dlines_tlen;	\
-		ret = (shdr)->total_len + _http_sep_len;		\
+		ret = (shdr)->total_len;				\
+		if (!(shdr)->preformatted)				\
+		  ret += _http_sep_len;				\
 		ret;							\
 	})
 
@@ -216,7 +231,7 @@ static inline err_t http_sendhdr_write(struct http_send_hdr *shdr, size_t *sent,
 			}
 		}
 	}
-	if (apos >= shdr->total_len) {
+	if (apos >= shdr->total_len && !shdr->preformatted) {
 		/* end of header */
 		l_off  = apos - shdr->total_len;
 		l_left = _http_sep_len - l_off;
@@ -232,6 +247,27 @@ static inline err_t http_sendhdr_write(struct http_send_hdr *shdr, size_t *sent,
 	return err;
 }
 
+/*
+ * Copies the header (inclusive EOH line) to buf
+ * Note: http_sendhdr_calc_totallen() has to be called before,
+ *  its return value is the number of bytes that are copied
+ */
+static inline void http_sendhdr_serialize(struct http_send_hdr *shdr, char *buf)
+{
+	register unsigned l;
+
+	for (l = 0; l < shdr->nb_slines; ++l) {
+		memcpy(buf, shdr->sline[l].b, shdr->sline[l].len);
+		buf += shdr->sline[l].len;
+	}
+	for (l = 0; l < shdr->nb_dlines; ++l) {
+		memcpy(buf, shdr->dline[l].b, shdr->dline[l].len);
+		buf += shdr->dline[l].len;
+	}
+	if (!shdr->preformatted)
+		memcpy(buf, _http_sep, _http_sep_len);
+}
+
 static inline int httpparser_recvhdr_field(struct http_parser *parser, const char *buf, size_t len)
 {
 	struct http_recv_hdr *rhdr = (struct http_recv_hdr *) parser->data;
@@ -300,6 +336,307 @@ static inline int http_recvhdr_findfield(struct http_recv_hdr *rhdr, const char
 	return -1; /* not found */
 }
 
+struct http_range {
+	uint64_t first; /* first byte of range */
+	uint64_t last;  /* last byte of range */
+};
+
+#define _http_isdigit(c) \
+	((c) >= '0' && (c) <= '9')
+#define _http_skipws(p) \
+	do { while (*(p) == ' ' || *(p) == '\t') ++(p); } while (0)
+
+/*
+ * Parses the value of a range request header field (RFC 7233:
+ * "bytes=first-last", "bytes=first-", "bytes=-suffixlen", comma-separated)
+ * for a file of size fsize. Ranges are clamped to the file size and stored
+ * to r (up to max entries) in the requested order.
+ * Returns the number of satisfiable ranges, 0 if the header field has to be
+ * ignored (unsupported unit, syntax error, more than max ranges, value
+ * possibly truncated to the receive buffer) so that the full file is served,
+ * or -EINVAL if none of the ranges is satisfiable (-> 416)
+ * https://tools.ietf.org/html/rfc7233#section-2.1
+ */
+static inline int http_parse_ranges(const char *value, uint64_t fsize,
+                                    struct http_range *r, unsigned int max)
+{
+	const char *p = value;
+	char *end;
+	uint64_t first;
+	uint64_t last;
+	unsigned int nb = 0;
+	int nb_specs = 0;
+
+	if (strncasecmp("bytes=", p, 6) != 0)
+		return 0;
+	/* received header values are cut to the size of _hdr_dbuffer:
+	 * a value that filled the buffer might have lost the end of its last
+	 * range spec (e.g., "10-2000" -> "10-20") */
+	if (strnlen(value, HTTP_HDR_DLINE_MAXLEN) >= HTTP_HDR_DLINE_MAXLEN - 1)
+		return 0;
+	p += 6;
+
+	for (;;) {
+		_http_skipws(p);
+		if (*p == ',') { /* empty list element */
+			++p;
+			continue;
+		}
+		if (*p == '\0')
+			break;
+
+		if (*p == '-') {
+			/* suffix-byte-range-spec: last n bytes of the file */
+			++p;
+			if (!_http_isdigit(*p))
+				return 0;
+			last = strtoull(p, &end, 10);
+			p = end;
+			++nb_specs;
+			if (last == 0 || fsize == 0)
+				goto next; /* unsatisfiable */
+			first = (last >= fsize) ? 0 : fsize - last;
+			last = fsize - 1;
+		} else if (_http_isdigit(*p)) {
+			/* byte-range-spec: first-[last] */
+			first = strtoull(p, &end, 10);
+			p = end;
+			if (*p != '-')
+				return 0;
+			++p;
+			if (_http_isdigit(*p)) {
+				last = strtoull(p, &end, 10);
+				p = end;
+				if (last < first)
+					return 0; /* invalid spec */
+			} else {
+				last = UINT64_MAX;
+			}
+			++nb_specs;
+			if (first >= fsize)
+				goto next; /* unsatisfiable */
+			if (last >= fsize)
+				last = fsize - 1;
+		} else {
+			return 0;
+		}
+
+		if (nb == max)
+			return 0; /* too many ranges: serve full file */
+		r[nb].first = first;
+		r[nb].last  = last;
+		++nb;
+
+	next:
+		_http_skipws(p);
+		if (*p == ',')
+			++p;
+		else if (*p != '\0')
+			return 0;
+	}
+
+	if (!nb)
+		return nb_specs ? -EINVAL : 0;
+	return (int) nb;
+}
+
+/*
+ * Validators (RFC 7232)
+ * Entity tags are built from the hash digest of an object (hex, at most
+ * HTTP_ETAG_MAXHLEN bytes of the digest so that a header line fits into
+ * HTTP_HDR_DLINE_MAXLEN). Dates are formatted as IMF-fixdate
+ * ("Sun, 06 Nov 1994 08:49:37 GMT").
+ */
+#define HTTP_ETAG_MAXHLEN 32
+#define HTTP_ETAG_MAXLEN  (2 * HTTP_ETAG_MAXHLEN + 1)
+#define HTTP_DATE_MAXLEN  30
+
+static const char * const _http_wday[] = {
+	"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+static const char * const _http_month[] = {
+	"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+	"Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+/* formats hlen bytes of hash digest h as entity tag (without quotes) */
+static inline void http_fmt_etag(char *out, const uint8_t *h, uint8_t hlen)
+{
+	static const char hex[] = "0123456789abcdef";
+	register unsigned int i;
+
+	if (hlen > HTTP_ETAG_MAXHLEN)
+		hlen = HTTP_ETAG_MAXHLEN;
+	for (i = 0; i < hlen; ++i) {
+		out[2 * i]     = hex[h[i] >> 4];
+		out[2 * i + 1] = hex[h[i] & 0x0f];
+	}
+	out[2 * hlen] = '\0';
+}
+
+/* formats a UNIX timestamp (seconds) as IMF-fixdate */
+static inline void http_fmt_date(char *out, size_t len, uint64_t ts)
+{
+	uint64_t days = ts / 86400;
+	uint32_t secs = (uint32_t) (ts % 86400);
+	uint64_t z, era, doe, yoe, doy, mp, y;
+	unsigned int d, m;
+
+	/* civil date from days since 1970-01-01 */
+	z   = days + 719468;
+	era = z / 146097;
+	doe = z - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp  = (5 * doy + 2) / 153;
+	d   = (unsigned int) (doy - (153 * mp + 2) / 5 + 1);
+	m   = (unsigned int) (mp < 10 ? mp + 3 : mp - 9);
+	y   = yoe + era * 400 + (m <= 2);
+
+	snprintf(out, len, "%s, %02u %s %04"PRIu64" %02"PRIu32":%02"PRIu32":%02"PRIu32" GMT",
+	         _http_wday[(days + 4) % 7], d, _http_month[m - 1], y,
+	         secs / 3600, (secs / 60) % 60, secs % 60);
+}
+
+/*
+ * Parses an IMF-fixdate to a UNIX timestamp (seconds)
+ * Note: The obsolete RFC 850 and asctime() formats are not supported,
+ *       the caller has to treat those as invalid (e.g., ignore the field)
+ */
+static inline int http_parse_date(const char *value, uint64_t *ts)
+{
+	char wday[4], mon[4];
+	unsigned int d, y, H, M, S;
+	unsigned int m, yoe, doy, doe;
+	uint64_t era;
+
+	if (sscanf(value, "%3[A-Za-z], %2u %3[A-Za-z] %4u %2u:%2u:%2u GMT",
+	           wday, &d, mon, &y, &H, &M, &S) != 7)
+		return -EINVAL;
+	for (m = 0; m < 12; ++m)
+		if (strcasecmp(mon, _http_month[m]) == 0)
+			break;
+	if (m == 12 || d < 1 || d > 31 || y < 1970 || H > 23 || M > 59 || S > 60)
+		return -EINVAL;
+
+	/* days since 1970-01-01 from civil date */
+	++m;
+	if (m <= 2)
+		--y;
+	era = y / 400;
+	yoe = y - (unsigned int) era * 400;
+	doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	*ts = ((era * 146097 + doe - 719468) * 86400) + H * 3600 + M * 60 + S;
+	return 0;
+}
+
+/*
+ * Returns 1 if etag (without quotes) is listed in the value of an
+ * If-None-Match header field ("*" matches any), comparison is weak
+ */
+static inline int http_etag_match(const char *value, const char *etag)
+{
+	const char *p = value;
+	const char *end;
+	size_t elen = strlen(etag);
+
+	for (;;) {
+		while (*p == ' ' || *p == '\t' || *p == ',')
+			++p;
+		if (*p == '\0')
+			return 0;
+		if (*p == '*')
+			return 1;
+		if (strncmp(p, "W/", 2) == 0)
+			p += 2;
+		if (*p != '"')
+			return 0;
+		++p;
+		end = strchr(p, '"');
+		if (!end)
+			return 0; /* truncated */
+		if ((size_t) (end - p) == elen && strncmp(p, etag, elen) == 0)
+			return 1;
+		p = end + 1;
+	}
+}
+
+/*
+ * Evaluates the preconditions of a GET/HEAD request for an object with the
+ * entity tag etag that was modified at mtime (RFC 7232, section 6):
+ * If-None-Match takes precedence over If-Modified-Since.
+ * Returns 1 if the request can be answered with 304 (not modified)
+ */
+static inline int http_recvhdr_notmodified(struct http_recv_hdr *rhdr, const char *etag, uint64_t mtime)
+{
+	uint64_t ims;
+	int l;
+
+	l = http_recvhdr_findfield(rhdr, "if-none-match");
+	if (l >= 0)
+		return http_etag_match(rhdr->line[l].value.b, etag);
+	l = http_recvhdr_findfield(rhdr, "if-modified-since");
+	if (l >= 0 && http_parse_date(rhdr->line[l].value.b, &ims) == 0)
+		return (mtime <= ims);
+	return 0;
+}
+
+/*
+ * Returns the weight (quality value * 1000) that the value of an
+ * Accept-Encoding header field assigns to a content coding, either by
+ * naming it or via "*". -1 is returned if the coding is not covered
+ * https://tools.ietf.org/html/rfc7231#section-5.3.4
+ */
+static inline int http_accept_encoding_q(const char *value, const char *coding)
+{
+	const char *p = value;
+	const char *tok;
+	size_t tlen;
+	size_t clen = strlen(coding);
+	int q, q_coding = -1, q_any = -1;
+	unsigned int m;
+
+	for (;;) {
+		while (*p == ' ' || *p == '\t' || *p == ',')
+			++p;
+		if (*p == '\0')
+			break;
+		tok = p;
+		while (*p != '\0' && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+			++p;
+		tlen = (size_t) (p - tok);
+
+		q = 1000;
+		_http_skipws(p);
+		while (*p == ';') {
+			++p;
+			_http_skipws(p);
+			if ((*p == 'q' || *p == 'Q') && *(p + 1) == '=') {
+				p += 2;
+				q = 0;
+				if (*p == '1') {
+					q = 1000;
+				} else if (*p == '0' && *(p + 1) == '.') {
+					p += 2;
+					for (m = 100; m && _http_isdigit(*p); m /= 10, ++p)
+						q += (*p - '0') * m;
+				}
+			}
+			while (*p != '\0' && *p != ',' && *p != ';')
+				++p; /* skip (remaining) parameter value */
+		}
+		while (*p != '\0' && *p != ',')
+			++p;
+
+		if (tlen == clen && strncasecmp(tok, coding, clen) == 0)
+			q_coding = q;
+		else if (tlen == 1 && *tok == '*')
+			q_any = q;
+	}
+	return (q_coding >= 0) ? q_coding : q_any;
+}
+
 #define http_recvhdr_get_nblines(rhdr) \
 	(rhdr)->nb_lines
 #define http_recvhdr_reset(rhdr) \
@@ -0,0 +1,280 @@
+/*
+ * Fast HTTP Server Implementation for SHFS volumes
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#include <target/sys.h>
+#include "http_hot.h"
+
+struct http_hot_tier {
+	uint8_t *sketch; /* HTTP_HOT_SKETCH_DEPTH rows of 4-bit counters (one per byte) */
+	uint32_t nb_incr; /* increments since counters were halved */
+	size_t used; /* memory used by hot objects */
+	uint32_t nb_objs;
+	dlist_head(lru); /* most recently used first */
+
+	/* statistics */
+	uint64_t nb_hits;
+	uint64_t nb_admits;
+	uint64_t nb_rejects;
+	uint64_t nb_evicts;
+};
+
+static struct http_hot_tier *hot = NULL;
+
+static const uint64_t _http_hot_seed[HTTP_HOT_SKETCH_DEPTH] = {
+	0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL,
+	0x165667b19e3779f9ULL, 0xd6e8feb86659fd93ULL,
+};
+
+#define _http_hot_counter(key, row) \
+	(&hot->sketch[((row) * HTTP_HOT_SKETCH_WIDTH) + \
+	              (((key) * _http_hot_seed[(row)]) >> 32) % HTTP_HOT_SKETCH_WIDTH])
+
+static inline uint64_t _http_hot_key(SHFS_FD fd)
+{
+	hash512_t h;
+	uint64_t key = 0xcbf29ce484222325ULL; /* FNV-1a */
+	register unsigned int i;
+
+	shfs_fio_hash(fd, h);
+	for (i = 0; i < shfs_vol.hlen; ++i) {
+		key ^= h[i];
+		key *= 0x100000001b3ULL;
+	}
+	return key;
+}
+
+static inline unsigned int _http_hot_estimate(uint64_t key)
+{
+	register unsigned int i;
+	unsigned int freq = 15;
+
+	for (i = 0; i < HTTP_HOT_SKETCH_DEPTH; ++i)
+		freq = min(freq, (unsigned int) *_http_hot_counter(key, i));
+	return freq;
+}
+
+static inline void _http_hot_count(uint64_t key)
+{
+	register unsigned int i;
+	uint8_t *c;
+
+	for (i = 0; i < HTTP_HOT_SKETCH_DEPTH; ++i) {
+		c = _http_hot_counter(key, i);
+		if (*c < 15)
+			++(*c);
+	}
+
+	/* aging: old popularity fades out */
+	if (++hot->nb_incr == HTTP_HOT_SKETCH_SAMPLE) {
+		for (i = 0; i < HTTP_HOT_SKETCH_DEPTH * HTTP_HOT_SKETCH_WIDTH; ++i)
+			hot->sketch[i] >>= 1;
+		hot->nb_incr = 0;
+	}
+}
+
+static inline void _http_hot_evict(struct http_hot *o)
+{
+	BUG_ON(o->refcount);
+
+	dlist_unlink(o, hot->lru, lru);
+	o->hc->hot = NULL;
+	hot->used -= sizeof(*o) + o->len;
+	--hot->nb_objs;
+	target_free(o);
+}
+
+/* releases the header cache of an object (see: shfs_pcookie_release) */
+static void http_hot_release_hdrcache(void *pcookie)
+{
+	struct http_hdrcache *hc = pcookie;
+
+	if (hc->hot)
+		_http_hot_evict(hc->hot);
+	target_free(hc);
+}
+
+int http_hot_init(void)
+{
+	hot = target_malloc(CACHELINE_SIZE, sizeof(*hot));
+	if (!hot)
+		return -ENOMEM;
+	hot->sketch = target_malloc(CACHELINE_SIZE, HTTP_HOT_SKETCH_DEPTH * HTTP_HOT_SKETCH_WIDTH);
+	if (!hot->sketch) {
+		target_free(hot);
+		hot = NULL;
+		return -ENOMEM;
+	}
+	memset(hot->sketch, 0, HTTP_HOT_SKETCH_DEPTH * HTTP_HOT_SKETCH_WIDTH);
+	hot->nb_incr = 0;
+	hot->used = 0;
+	hot->nb_objs = 0;
+	dlist_init_head(hot->lru);
+	hot->nb_hits = 0;
+	hot->nb_admits = 0;
+	hot->nb_rejects = 0;
+	hot->nb_evicts = 0;
+
+	shfs_pcookie_release = http_hot_release_hdrcache;
+	return 0;
+}
+
+void http_hot_exit(void)
+{
+	struct http_hot *o;
+
+	/* hot objects are not in use anymore: drop them, header caches stay */
+	while ((o = dlist_first_el(hot->lru, struct http_hot)) != NULL)
+		_http_hot_evict(o);
+	shfs_pcookie_release = NULL;
+
+	target_free(hot->sketch);
+	target_free(hot);
+	hot = NULL;
+}
+
+struct http_hot *http_hot_get(SHFS_FD fd, struct http_hdrcache *hc, uint64_t fsize, int *admissible)
+{
+	struct http_hot *o = hc->hot;
+
+	*admissible = 0;
+	if (o) {
+		_http_hot_count(o->key);
+		dlist_relink_head(o, hot->lru, lru);
+		++o->refcount;
+		++hot->nb_hits;
+		return o;
+	}
+
+	/* object has to fit into a single chunk */
+	if (fsize == 0 || fsize > HTTP_HOTCACHE_MAXOBJLEN ||
+	    shfs_volchk_foff(fd, 0) != shfs_volchk_foff(fd, fsize - 1))
+		return NULL;
+	if (sizeof(*o) + hc->len + fsize > HTTP_HOTCACHE_SIZE)
+		return NULL;
+
+	_http_hot_count(_http_hot_key(fd));
+	*admissible = 1;
+	return NULL;
+}
+
+int http_hot_fill(SHFS_FD fd, struct http_hdrcache *hc, const void *data, size_t len)
+{
+	struct http_hot *o, *v, *vprev;
+	uint64_t key;
+	unsigned int freq;
+	size_t need, avail;
+
+	BUG_ON(hc->hot);
+
+	key = _http_hot_key(fd);
+	freq = _http_hot_estimate(key);
+	if (freq < HTTP_HOT_MINFREQ)
+		return -EAGAIN;
+
+	/* TinyLFU: find least recently used victims that are less popular */
+	need = sizeof(*o) + hc->len + len;
+	avail = HTTP_HOTCACHE_SIZE - hot->used;
+	for (v = dlist_last_el(hot->lru, struct http_hot);
+	     v && avail < need;
+	     v = dlist_prev_el(v, lru)) {
+		if (v->refcount)
+			continue; /* still sent out */
+		if (_http_hot_estimate(v->key) >= freq)
+			break;
+		avail += sizeof(*v) + v->len;
+	}
+	if (avail < need) {
+		printd("Object rejected by hot object tier (estimated frequency: %u)\n", freq);
+		++hot->nb_rejects;
+		return -ENOSPC;
+	}
+
+	o = target_malloc(CACHELINE_SIZE, need);
+	if (!o)
+		return -ENOMEM;
+
+	/* evict victims */
+	for (v = dlist_last_el(hot->lru, struct http_hot);
+	     v && HTTP_HOTCACHE_SIZE - hot->used < need;
+	     v = vprev) {
+		vprev = dlist_prev_el(v, lru);
+		if (v->refcount)
+			continue;
+		_http_hot_evict(v);
+		++hot->nb_evicts;
+	}
+
+	o->hc = hc;
+	o->key = key;
+	o->refcount = 0;
+	o->len = hc->len + len;
+	memcpy(o->b, hc->b, hc->len);
+	memcpy(o->b + hc->len, data, len);
+	dlist_prepend(o, hot->lru, lru);
+	hot->used += need;
+	++hot->nb_objs;
+	++hot->nb_admits;
+	hc->hot = o;
+
+	printd("Object admitted to hot object tier (%"PRIu64" B, estimated frequency: %u)\n",
+	       (uint64_t) len, freq);
+	return 0;
+}
+
+#ifdef HTTP_INFO
+void http_hot_info(FILE *cio)
+{
+	uint64_t used, hits, admits, rejects, evicts;
+	uint32_t nb_objs;
+
+	if (!hot)
+		return;
+
+	/* copy values in order to print them
+	 * (writing to cio can lead to thread switching) */
+	used    = hot->used;
+	nb_objs = hot->nb_objs;
+	hits    = hot->nb_hits;
+	admits  = hot->nb_admits;
+	rejects = hot->nb_rejects;
+	evicts  = hot->nb_evicts;
+
+	fprintf(cio, " Hot objects:                           %8"PRIu32" (%"PRIu64"/%"PRIu64" KiB)\n",
+	        nb_objs, used / 1024, (uint64_t) HTTP_HOTCACHE_SIZE / 1024);
+	fprintf(cio, " Hot object hits:                       %8"PRIu64"\n", hits);
+	fprintf(cio, " Hot object admissions/rejects/evicts:  %8"PRIu64"/%"PRIu64"/%"PRIu64"\n",
+	        admits, rejects, evicts);
+}
+#endif
@@ -0,0 +1,103 @@
+/*
+ * Fast HTTP Server Implementation for SHFS volumes
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _HTTP_HOT_H_
+#define _HTTP_HOT_H_
+
+/*
+ * Hot object tier: Whole small objects are kept in memory, contiguously
+ * behind a copy of their cached 200 response header (see: struct
+ * http_hdrcache). A hit is served with a single write of header and data.
+ *
+ * Admission is frequency based (TinyLFU): accesses are counted in a
+ * count-min sketch with 4-bit counters that are halved periodically.
+ * A new object is only admitted when it was accessed more often than the
+ * least recently used objects it would replace.
+ *
+ * A hot object belongs to the header cache of its file: it is released
+ * together with it when the object is updated by a remount or on unmount.
+ */
+#include "http_defs.h"
+#include "shfs_fio.h"
+#include "dlist.h"
+
+#ifndef HTTP_HOTCACHE_MAXOBJLEN
+#define HTTP_HOTCACHE_MAXOBJLEN   16384 /* objects up to this size are considered (has to fit into one chunk) */
+#endif
+#ifndef HTTP_HOTCACHE_SIZE
+#define HTTP_HOTCACHE_SIZE        (16 << 20) /* memory limit for hot objects (bytes) */
+#endif
+#define HTTP_HOT_SKETCH_DEPTH     4
+#define HTTP_HOT_SKETCH_WIDTH     4096 /* counters per row (power of 2) */
+#define HTTP_HOT_SKETCH_SAMPLE    (HTTP_HOT_SKETCH_WIDTH * 10) /* accesses until counters are halved */
+#define HTTP_HOT_MINFREQ          2 /* min. estimated frequency for admission */
+
+struct http_hot {
+	dlist_el(lru);
+	struct http_hdrcache *hc; /* owner */
+	uint64_t key; /* sketch key */
+	uint32_t refcount; /* requests that are sending this object */
+	size_t len; /* header + object data */
+	char b[];
+};
+
+int  http_hot_init(void);
+void http_hot_exit(void);
+
+/*
+ * Counts an access to an object with a cached header and returns its hot
+ * object (reference is taken) or NULL if there is none. In the latter case,
+ * admissible is set to 1 if the object should be filled in (see:
+ * http_hot_fill()) when its data was read.
+ */
+struct http_hot *http_hot_get(SHFS_FD fd, struct http_hdrcache *hc, uint64_t fsize, int *admissible);
+/*
+ * Admits an object to the tier with its data. Less frequently used objects
+ * are evicted to make space. Returns a negative value if the object was
+ * not admitted.
+ */
+int http_hot_fill(SHFS_FD fd, struct http_hdrcache *hc, const void *data, size_t len);
+
+static inline void http_hot_put(struct http_hot *hot)
+{
+	BUG_ON(hot->refcount == 0);
+	--hot->refcount;
+}
+
+#ifdef HTTP_INFO
+void http_hot_info(FILE *cio);
+#endif
+
+#endif /* _HTTP_HOT_H_ */
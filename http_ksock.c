@@ -0,0 +1,986 @@
+/*
+ * HTTP front end on kernel sockets (Linux target)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+
+#define _GNU_SOURCE /* accept4() */
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <linux/tcp.h> /* TCP_KEEP*: <netinet/tcp.h> would clash with lwIP's TCP_MSS */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "http_defs.h"
+#include "http_ksock.h"
+
+#define HTTPK_LISTEN_BACKLOG   128
+#define HTTPK_MAXNB_EVENTS     64
+#define HTTPK_RBUF_LEN         2048
+#define HTTPK_SENDFILE_MAXLEN  (1 << 20) /* max. number of bytes per sendfile() call */
+
+enum httpk_sess_state {
+	HKS_PARSING = 0,
+	HKS_PREPARING_HDR, /* waits for the hash table entry of the object */
+	HKS_RESPONDING_HDR,
+	HKS_RESPONDING_MSG
+};
+
+struct httpk_sess {
+	struct httpk_sess *next;
+	struct httpk_sess *prev;
+
+	struct mempool_obj *pobj;
+	int sfd;
+	enum httpk_sess_state state;
+	uint32_t events; /* registered epoll events */
+
+	struct http_parser parser;
+	char rbuf[HTTPK_RBUF_LEN]; /* receive buffer (holds pipelined requests) */
+	size_t rbuf_len;
+	size_t rbuf_pos;
+
+	/* current request */
+	struct http_recv_hdr rhdr;
+	char url[HTTPHDR_URL_MAXLEN + 1];
+	size_t url_len;
+	int url_overflow;
+	char *url_argp;
+	int keepalive;
+	unsigned short http_major;
+	unsigned short http_minor;
+	unsigned int method;
+
+	/* current response */
+	enum http_req_type type;
+	int code;
+	struct http_send_hdr shdr;
+	size_t hdr_total_len;
+	size_t hdr_sent;
+	SHFS_FD fd;
+	const char *smsg;
+	uint64_t rfirst;
+	uint64_t rlen;
+	uint64_t sent;
+#if defined SHFS_STATS && defined SHFS_STATS_HTTP
+	struct shfs_el_stats *el_stats;
+#if defined SHFS_STATS_HTTP_DPC
+	uint64_t dpc_threshold[SHFS_STATS_HTTP_DPCR];
+	unsigned int dpc_i;
+#endif
+#endif
+	dlist_el(ioretry_chain);
+};
+
+struct httpk_srv {
+	int lfd; /* listening socket */
+	int efd; /* epoll instance */
+
+	struct mempool *sess_pool;
+	uint16_t nb_sess;
+	uint16_t max_nb_sess;
+	struct httpk_sess *hsess_head;
+	struct httpk_sess *hsess_tail;
+	struct dlist_head ioretry_chain; /* sessions waiting for HKS_PREPARING_HDR */
+
+	/* volume members opened for sendfile() */
+	uuid_t vol_uuid;
+	unsigned int nb_mfds;
+	int mfd[SHFS_MAX_NB_MEMBERS];
+};
+
+static struct httpk_srv *hks = NULL;
+
+static int httpk_recv_url(struct http_parser *parser, const char *buf, size_t len);
+static int httpk_recv_complete(struct http_parser *parser);
+
+static http_parser_settings _httpk_parser_settings = {
+	.on_message_begin = NULL,
+	.on_url = httpk_recv_url,
+	.on_status = NULL,
+	.on_header_field = httpparser_recvhdr_field,
+	.on_header_value = httpparser_recvhdr_value,
+	.on_headers_complete = NULL,
+	.on_body = NULL,
+	.on_message_complete = httpk_recv_complete
+};
+
+/*******************************************************************************
+ * Volume members
+ ******************************************************************************/
+static void httpk_close_members(void)
+{
+	while (hks->nb_mfds)
+		close(hks->mfd[--hks->nb_mfds]);
+}
+
+/*
+ * Opens the members of the mounted volume for sendfile(): They are opened
+ * again without O_DIRECT (sendfile() reads through the page cache of the
+ * host) and reopened when a different volume got mounted in between
+ */
+static int httpk_open_members(void)
+{
+	unsigned int m;
+	int ret;
+
+	if (hks->nb_mfds == shfs_vol.nb_members &&
+	    uuid_compare(hks->vol_uuid, shfs_vol.uuid) == 0)
+		return 0; /* up to date */
+
+	httpk_close_members();
+	for (m = 0; m < shfs_vol.nb_members; ++m) {
+		hks->mfd[m] = open(blkdev_id(shfs_vol.member[m].bd), O_RDONLY | O_CLOEXEC);
+		if (hks->mfd[m] < 0) {
+			ret = -errno;
+			printd("Could not open volume member %u for sendfile(): %s\n",
+			       m, strerror(errno));
+			goto err_close;
+		}
+		++hks->nb_mfds;
+	}
+	uuid_copy(hks->vol_uuid, shfs_vol.uuid);
+	return 0;
+
+ err_close:
+	httpk_close_members();
+	return ret;
+}
+
+/*******************************************************************************
+ * Session handling
+ ******************************************************************************/
+static inline void httpk_sess_events(struct httpk_sess *hsess, uint32_t events)
+{
+	struct epoll_event ev;
+
+	if (hsess->events == events)
+		return;
+	ev.events = events;
+	ev.data.ptr = hsess;
+	if (epoll_ctl(hks->efd, EPOLL_CTL_MOD, hsess->sfd, &ev) == 0)
+		hsess->events = events;
+}
+
+static inline void httpk_req_reset(struct httpk_sess *hsess)
+{
+	http_recvhdr_reset(&hsess->rhdr);
+	hsess->url_len = 0;
+	hsess->url_overflow = 0;
+	hsess->url_argp = NULL;
+	http_sendhdr_reset(&hsess->shdr);
+	hsess->hdr_total_len = 0;
+	hsess->hdr_sent = 0;
+	hsess->type = HRT_UNDEF;
+	hsess->fd = NULL;
+	hsess->smsg = NULL;
+	hsess->rlen = 0;
+	hsess->sent = 0;
+#if defined SHFS_STATS && defined SHFS_STATS_HTTP && defined SHFS_STATS_HTTP_DPC
+	hsess->dpc_i = 0;
+#endif
+	hsess->state = HKS_PARSING;
+}
+
+static inline void httpk_req_close(struct httpk_sess *hsess)
+{
+	if (hsess->fd) {
+		shfs_fio_close(hsess->fd);
+		hsess->fd = NULL;
+	}
+}
+
+static void httpk_sess_close(struct httpk_sess *hsess)
+{
+	printd("Closing session %p\n", hsess);
+
+	httpk_req_close(hsess);
+	if (dlist_is_linked(hsess, hks->ioretry_chain, ioretry_chain))
+		dlist_unlink(hsess, hks->ioretry_chain, ioretry_chain);
+	epoll_ctl(hks->efd, EPOLL_CTL_DEL, hsess->sfd, NULL);
+	close(hsess->sfd);
+
+	/* unlink session from session list */
+	if (hsess->prev)
+		hsess->prev->next = hsess->next;
+	else
+		hks->hsess_head = hsess->next;
+	if (hsess->next)
+		hsess->next->prev = hsess->prev;
+	else
+		hks->hsess_tail = hsess->prev;
+
+	mempool_put(hsess->pobj);
+	--hks->nb_sess;
+}
+
+static void httpk_accept(void)
+{
+	struct mempool_obj *hsobj;
+	struct httpk_sess *hsess;
+	struct epoll_event ev;
+	int one = 1;
+	int val;
+	int sfd;
+
+	for (;;) {
+		sfd = accept4(hks->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (sfd < 0)
+			return; /* no pending connections left */
+
+		hsobj = mempool_pick(hks->sess_pool);
+		if (!hsobj) {
+			printd("Session establishment declined "
+			       "(currently, there are %"PRIu16"/%"PRIu16" open sessions)\n",
+			       hks->nb_sess, hks->max_nb_sess);
+			close(sfd);
+			continue;
+		}
+		hsess = hsobj->data;
+		hsess->pobj = hsobj;
+		hsess->sfd = sfd;
+		hsess->rbuf_len = 0;
+		hsess->rbuf_pos = 0;
+		httpk_req_reset(hsess);
+		dlist_init_el(hsess, ioretry_chain);
+
+		/* Turn on TCP Keepalive */
+		setsockopt(sfd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+		val = HTTP_TCPKEEPALIVE_IDLE;
+		setsockopt(sfd, IPPROTO_TCP, TCP_KEEPIDLE, &val, sizeof(val));
+		val = HTTP_TCPKEEPALIVE_TIMEOUT;
+		setsockopt(sfd, IPPROTO_TCP, TCP_KEEPINTVL, &val, sizeof(val));
+		val = 1;
+		setsockopt(sfd, IPPROTO_TCP, TCP_KEEPCNT, &val, sizeof(val));
+
+		/* init parser */
+		hsess->parser.data = (void *) &hsess->rhdr;
+		http_parser_init(&hsess->parser, HTTP_REQUEST);
+
+		hsess->events = EPOLLIN;
+		ev.events = hsess->events;
+		ev.data.ptr = hsess;
+		if (epoll_ctl(hks->efd, EPOLL_CTL_ADD, sfd, &ev) < 0) {
+			printd("Could not register session: %s\n", strerror(errno));
+			mempool_put(hsobj);
+			close(sfd);
+			continue;
+		}
+
+		/* register session to session list */
+		if (!hks->hsess_head) {
+			hks->hsess_head = hsess;
+			hsess->prev = NULL;
+		} else {
+			hks->hsess_tail->next = hsess;
+			hsess->prev = hks->hsess_tail;
+		}
+		hsess->next = NULL;
+		hks->hsess_tail = hsess;
+
+		++hks->nb_sess;
+		printd("New HTTP session accepted "
+		       "(currently, there are %"PRIu16"/%"PRIu16" open sessions)\n",
+		       hks->nb_sess, hks->max_nb_sess);
+	}
+}
+
+/*******************************************************************************
+ * Request parsing
+ ******************************************************************************/
+static int httpk_recv_url(struct http_parser *parser, const char *buf, size_t len)
+{
+	struct httpk_sess *hsess = container_of(parser, struct httpk_sess, parser);
+	register size_t i, curpos, maxlen;
+
+	curpos = hsess->url_len;
+	maxlen = sizeof(hsess->url) - 1 - curpos;
+	if (unlikely(len > maxlen)) {
+		hsess->url_overflow = 1; /* Out of memory */
+		len = maxlen;
+	}
+
+	if (!hsess->url_argp) {
+		for (i = 0; i < len; ++i) {
+			if (buf[i] == HTTPURL_ARGS_INDICATOR) {
+				hsess->url_argp = &hsess->url[curpos + i];
+				break;
+			}
+		}
+	}
+	memcpy(&hsess->url[curpos], buf, len);
+	hsess->url_len += len;
+	return 0;
+}
+
+static int httpk_recv_complete(struct http_parser *parser)
+{
+	struct httpk_sess *hsess = container_of(parser, struct httpk_sess, parser);
+
+	hsess->keepalive = http_should_keep_alive(parser);
+	hsess->http_major = parser->http_major;
+	hsess->http_minor = parser->http_minor;
+	hsess->method = parser->method;
+
+	/* finalize request lines by adding terminating '\0' */
+	http_recvhdr_terminate(&hsess->rhdr);
+	hsess->url[hsess->url_len] = '\0';
+
+	/* stop parsing: pipelined requests stay in the receive buffer
+	 * until the response to this one was sent out */
+	http_parser_pause(parser, 1);
+	return 0;
+}
+
+/* returns 1 when a request was received completely, 0 when more data
+ * is required and a negative value on errors or when the peer closed */
+static int httpk_sess_parse(struct httpk_sess *hsess)
+{
+	ssize_t rlen;
+	size_t plen;
+
+	for (;;) {
+		if (hsess->rbuf_pos < hsess->rbuf_len) {
+			plen = http_parser_execute(&hsess->parser, &_httpk_parser_settings,
+			                           &hsess->rbuf[hsess->rbuf_pos],
+			                           hsess->rbuf_len - hsess->rbuf_pos);
+			hsess->rbuf_pos += plen;
+			if (HTTP_PARSER_ERRNO(&hsess->parser) == HPE_PAUSED) {
+				http_parser_pause(&hsess->parser, 0);
+				return 1;
+			}
+			if (unlikely(HTTP_PARSER_ERRNO(&hsess->parser) != HPE_OK)) {
+				printd("HTTP parsing error: %s\n",
+				       http_errno_description(HTTP_PARSER_ERRNO(&hsess->parser)));
+				return -EINVAL;
+			}
+		}
+
+		/* everything parsed: receive more data */
+		hsess->rbuf_pos = 0;
+		hsess->rbuf_len = 0;
+		rlen = recv(hsess->sfd, hsess->rbuf, sizeof(hsess->rbuf), 0);
+		if (rlen < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -errno;
+		}
+		if (rlen == 0)
+			return -ECONNRESET; /* connection closed by peer */
+		hsess->rbuf_len = (size_t) rlen;
+	}
+}
+
+/*******************************************************************************
+ * Response
+ ******************************************************************************/
+static inline void httpk_prepare_fio_hdr(struct httpk_sess *hsess, size_t *nb_slines, size_t *nb_dlines)
+{
+	char strsbuf[64];
+	char etagbuf[HTTP_ETAG_MAXLEN];
+	char date[HTTP_DATE_MAXLEN];
+	const char *etag = NULL;
+	hash512_t h;
+	uint64_t fsize;
+	int ret;
+#ifdef HTTP_HDRCACHE
+	struct http_hdrcache *hc = NULL;
+	int hdrcache = 0;
+#endif
+
+	shfs_fio_size(hsess->fd, &fsize);
+	hsess->code = 200;
+	hsess->rfirst = 0;
+	hsess->rlen = fsize;
+
+#ifdef HTTP_HDRCACHE
+	if (http_hdrcache_applicable(hsess->http_major, hsess->http_minor, hsess->keepalive)) {
+		hc = http_hdrcache_get(hsess->fd);
+		if (hc)
+			etag = hc->etag;
+	}
+#endif
+
+	/* Validators */
+	if (!etag) {
+		shfs_fio_hash(hsess->fd, h);
+		http_fmt_etag(etagbuf, h, shfs_vol.hlen);
+		etag = etagbuf;
+	}
+	if (http_recvhdr_notmodified(&hsess->rhdr, etag, shfs_fio_ts_creation(hsess->fd))) {
+		hsess->code = 304;
+		hsess->rlen = 0;
+		http_sendhdr_add_shdr(&hsess->shdr, nb_slines,
+		                      HTTP_SHDR_304(hsess->http_major, hsess->http_minor));
+		hsess->type = HRT_NOMSG;
+		goto validators;
+	}
+
+	ret = http_recvhdr_findfield(&hsess->rhdr, "range");
+	if (ret >= 0) {
+		struct http_range range;
+
+		/* multiple ranges are not supported by sendfile():
+		 * the range field is ignored and the full file is served */
+		ret = http_parse_ranges(hsess->rhdr.line[ret].value.b, fsize, &range, 1);
+		if (ret < 0) {
+			printd("Requested range is not satisfiable\n");
+			hsess->code = 416;
+			hsess->rlen = 0;
+			http_sendhdr_add_shdr(&hsess->shdr, nb_slines,
+			                      HTTP_SHDR_416(hsess->http_major, hsess->http_minor));
+			http_sendhdr_add_dline(&hsess->shdr, nb_dlines,
+			                       "%s: %"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_SIZE], (uint64_t) 0);
+			http_sendhdr_add_dline(&hsess->shdr, nb_dlines,
+			                       "%s*/%"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_RANGE], fsize);
+			hsess->type = HRT_NOMSG;
+			return;
+		}
+		if (ret > 0) {
+			hsess->code = 206;
+			hsess->rfirst = range.first;
+			hsess->rlen = (range.last + 1) - range.first;
+		}
+	}
+
+#ifdef HTTP_HDRCACHE
+	if (hsess->code == 200 &&
+	    http_hdrcache_applicable(hsess->http_major, hsess->http_minor, hsess->keepalive)) {
+		if (hc) {
+			/* complete header is already there */
+			http_sendhdr_set_preformatted(&hsess->shdr, hc->b, hc->len);
+			hsess->type = HRT_FIOMSG;
+			return;
+		}
+		hdrcache = 1; /* attach this header to the object */
+	}
+#endif
+
+	if (hsess->code == 206)
+		http_sendhdr_add_shdr(&hsess->shdr, nb_slines,
+		                      HTTP_SHDR_206(hsess->http_major, hsess->http_minor));
+	else
+		http_sendhdr_add_shdr(&hsess->shdr, nb_slines,
+		                      HTTP_SHDR_200(hsess->http_major, hsess->http_minor));
+	http_sendhdr_add_shdr(&hsess->shdr, nb_slines, HTTP_SHDR_ACC_BYTERANGE);
+
+	/* MIME (by element or default) */
+	shfs_fio_mime(hsess->fd, strsbuf, sizeof(strsbuf));
+	if (strsbuf[0] == '\0')
+		http_sendhdr_add_shdr(&hsess->shdr, nb_slines, HTTP_SHDR_DEFAULT_TYPE);
+	else
+		http_sendhdr_add_dline(&hsess->shdr, nb_dlines,
+		                       "%s: %s\r\n", _http_dhdr[HTTP_DHDR_MIME], strsbuf);
+
+#ifdef SHFS_VARIANTS
+	/* Content encoding (the range refers to the encoded content) */
+	if (shfs_fio_isvariant(hsess->fd)) {
+		shfs_fio_encoding(hsess->fd, strsbuf, sizeof(strsbuf));
+		http_sendhdr_add_dline(&hsess->shdr, nb_dlines,
+		                       "%s: %s\r\n", _http_dhdr[HTTP_DHDR_ENCODING], strsbuf);
+	}
+#endif
+
+	/* Content length */
+	http_sendhdr_add_dline(&hsess->shdr, nb_dlines,
+	                       "%s: %"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_SIZE], hsess->rlen);
+
+	/* Content range */
+	if (hsess->code == 206)
+		http_sendhdr_add_dline(&hsess->shdr, nb_dlines,
+		                       "%s%"PRIu64"-%"PRIu64"/%"PRIu64"\r\n",
+		                       _http_dhdr[HTTP_DHDR_RANGE],
+		                       hsess->rfirst, hsess->rfirst + hsess->rlen - 1, fsize);
+	hsess->type = HRT_FIOMSG;
+
+ validators:
+	http_fmt_date(date, sizeof(date), shfs_fio_ts_creation(hsess->fd));
+	http_sendhdr_add_dline(&hsess->shdr, nb_dlines,
+	                       "%s: \"%s\"\r\n", _http_dhdr[HTTP_DHDR_ETAG], etag);
+	http_sendhdr_add_dline(&hsess->shdr, nb_dlines,
+	                       "%s: %s\r\n", _http_dhdr[HTTP_DHDR_LASTMOD], date);
+#ifdef SHFS_VARIANTS
+	if (shfs_fio_hasvariants(hsess->fd))
+		http_sendhdr_add_shdr(&hsess->shdr, nb_slines, HTTP_SHDR_VARY_ENCODING);
+#endif
+#ifdef HTTP_HDRCACHE
+	if (hdrcache) {
+		http_sendhdr_set_nbslines(&hsess->shdr, *nb_slines);
+		http_sendhdr_set_nbdlines(&hsess->shdr, *nb_dlines);
+		http_hdrcache_fill(hsess->fd, &hsess->shdr, etag);
+	}
+#endif
+}
+
+/* returns -EAGAIN when the object cannot be opened yet
+ * (hash table chunk is being loaded), the call has to be repeated */
+static int httpk_prepare_hdr(struct httpk_sess *hsess)
+{
+	size_t url_offset = 0;
+	size_t nb_slines = 0;
+	size_t nb_dlines = 0;
+#if defined SHFS_STATS && defined SHFS_STATS_HTTP && defined SHFS_STATS_HTTP_DPC
+	register unsigned int i;
+#endif
+	char strsbuf[64];
+	char strlbuf[128];
+
+	if (hsess->method != HTTP_GET &&
+	    hsess->method != HTTP_HEAD) {
+		printd("Invalid/unsupported request method: %u HTTP/%hu.%hu\n",
+		       hsess->method, hsess->http_major, hsess->http_minor);
+		goto err501_hdr;
+	}
+
+	/* eliminate leading '/'s */
+	while (hsess->url[url_offset] == '/')
+		++url_offset;
+#ifdef HTTP_URL_CUTARGS
+	/* remove args from URL when there was a filename passed (-> "open by filename") */
+	if (hsess->url_argp &&
+	    &(hsess->url[url_offset]) != hsess->url_argp)
+		*(hsess->url_argp) = '\0';
+#endif
+
+	hsess->fd = shfs_fio_open(&hsess->url[url_offset]);
+	if (!hsess->fd) {
+		if (errno == EAGAIN)
+			return -EAGAIN;
+		printd("Could not open requested file '%s': %s\n", &hsess->url[url_offset], strerror(errno));
+		if (errno == ENOENT || errno == ENODEV)
+			goto err404_hdr;
+		goto err500_hdr;
+	}
+#ifdef SHFS_VARIANTS
+	if (shfs_fio_vnext(hsess->fd)) {
+		hsess->fd = http_open_variant(&hsess->rhdr, hsess->fd);
+		if (!hsess->fd)
+			return -EAGAIN;
+	}
+#endif
+#if defined SHFS_STATS && defined SHFS_STATS_HTTP
+	hsess->el_stats = shfs_stats_from_fd(hsess->fd);
+#endif
+	if (shfs_fio_islink(hsess->fd)) {
+		if (shfs_fio_link_type(hsess->fd) == SHFS_LTYPE_REDIRECT)
+			goto red307_hdr;
+		/* remote links are served by the lwIP front end only */
+		goto err501_hdr;
+	}
+
+	if (httpk_open_members() < 0)
+		goto err500_hdr;
+	httpk_prepare_fio_hdr(hsess, &nb_slines, &nb_dlines);
+#if defined SHFS_STATS && defined SHFS_STATS_HTTP && defined SHFS_STATS_HTTP_DPC
+	for (i = 0; i < SHFS_STATS_HTTP_DPCR; ++i)
+		hsess->dpc_threshold[i] = SHFS_STATS_HTTP_DPC_THRESHOLD(hsess->rlen, i);
+#endif
+	goto out;
+
+ red307_hdr:
+	hsess->code = 307;
+	http_sendhdr_add_shdr(&hsess->shdr, &nb_slines,
+	                      HTTP_SHDR_307(hsess->http_major, hsess->http_minor));
+	strshfshost(strsbuf, sizeof(strsbuf),
+	            shfs_fio_link_rhost(hsess->fd));
+	shfs_fio_link_rpath(hsess->fd, strlbuf, sizeof(strlbuf));
+	http_sendhdr_add_dline(&hsess->shdr, &nb_dlines,
+	                       "%s: http://%s:%"PRIu16"/%s\r\n", _http_dhdr[HTTP_DHDR_LOCATION],
+	                       strsbuf, shfs_fio_link_rport(hsess->fd), strlbuf);
+	hsess->type = HRT_NOMSG;
+	goto out;
+
+ err404_hdr:
+	hsess->code = 404;
+	http_sendhdr_add_shdr(&hsess->shdr, &nb_slines,
+	                      HTTP_SHDR_404(hsess->http_major, hsess->http_minor));
+	http_sendhdr_add_shdr(&hsess->shdr, &nb_slines, HTTP_SHDR_HTML);
+	http_sendhdr_add_shdr(&hsess->shdr, &nb_slines, HTTP_SHDR_NOCACHE);
+	hsess->smsg = _http_err404p;
+	hsess->rlen = _http_err404p_len;
+	goto err_out;
+
+ err500_hdr:
+	hsess->code = 500;
+	http_sendhdr_add_shdr(&hsess->shdr, &nb_slines,
+	                      HTTP_SHDR_500(hsess->http_major, hsess->http_minor));
+	http_sendhdr_add_shdr(&hsess->shdr, &nb_slines, HTTP_SHDR_HTML);
+	hsess->smsg = _http_err500p;
+	hsess->rlen = _http_err500p_len;
+	goto err_out;
+
+ err501_hdr:
+	hsess->code = 501;
+	http_sendhdr_add_shdr(&hsess->shdr, &nb_slines,
+	                      HTTP_SHDR_501(hsess->http_major, hsess->http_minor));
+	http_sendhdr_add_shdr(&hsess->shdr, &nb_slines, HTTP_SHDR_HTML);
+	hsess->smsg = _http_err501p;
+	hsess->rlen = _http_err501p_len;
+	goto err_out;
+
+ err_out:
+	/* Content length */
+	http_sendhdr_add_dline(&hsess->shdr, &nb_dlines,
+	                       "%s: %"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_SIZE], hsess->rlen);
+	hsess->type = HRT_SMSG;
+ out:
+	/* HEAD: header only (Content-length describes the GET response) */
+	if (hsess->method == HTTP_HEAD) {
+		hsess->type = HRT_NOMSG;
+		hsess->rlen = 0;
+	}
+
+	if (http_sendhdr_is_preformatted(&hsess->shdr))
+		goto calc_len; /* header cache: default lines are included */
+
+	/* Default header lines */
+	http_sendhdr_add_shdr(&hsess->shdr, &nb_slines, HTTP_SHDR_SERVER);
+	if (!hsess->keepalive)
+		http_sendhdr_add_shdr(&hsess->shdr, &nb_slines, HTTP_SHDR_CONN_CLOSE);
+	else
+		http_sendhdr_add_shdr(&hsess->shdr, &nb_slines, HTTP_SHDR_CONN_KEEPALIVE);
+
+	http_sendhdr_set_nbslines(&hsess->shdr, nb_slines);
+	http_sendhdr_set_nbdlines(&hsess->shdr, nb_dlines);
+ calc_len:
+	hsess->hdr_total_len = http_sendhdr_calc_totallen(&hsess->shdr);
+#ifdef HTTP_DEBUG_PRINTACCESS
+	printk("[%03u] %s\n", hsess->code, hsess->url);
+#endif
+	return 0;
+}
+
+/* tcpwrite_fn_t for http_sendhdr_write() */
+static err_t httpk_write(void *argp, const void *buf, size_t *len, uint8_t apiflags)
+{
+	struct httpk_sess *hsess = argp;
+	int flags = MSG_NOSIGNAL;
+	ssize_t ret;
+
+	/* cork only if the body follows: MSG_MORE would delay the last segment */
+	if ((apiflags & TCP_WRITE_FLAG_MORE) && hsess->rlen)
+		flags |= MSG_MORE;
+	ret = send(hsess->sfd, buf, *len, flags);
+	if (ret < 0) {
+		*len = 0;
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return ERR_MEM; /* send buffer is full */
+		return ERR_CONN;
+	}
+	*len = (size_t) ret;
+	return ERR_OK;
+}
+
+/*
+ * Sends the requested file range with sendfile() from the volume members:
+ * The file offset is translated to volume chunks (f_attr.chunk/offset of
+ * the hentry) and then to member offsets. Stripes that are contiguous on a
+ * member are handed over with a single call.
+ * Returns 0 when the body was sent completely, -EAGAIN when the socket
+ * buffer is full, or another negative errno on failures.
+ */
+static int httpk_sendfile(struct httpk_sess *hsess)
+{
+	uint64_t foff;
+	uint64_t left;
+	uint64_t off, noff;
+	unsigned int m, nm;
+	size_t len, nlen;
+	off_t loff;
+	ssize_t ret;
+
+	while (hsess->sent < hsess->rlen) {
+		left = hsess->rlen - hsess->sent;
+		foff = hsess->rfirst + hsess->sent;
+		len  = shfs_volchk_locate(shfs_volchk_foff(hsess->fd, foff),
+		                          shfs_volchkoff_foff(hsess->fd, foff),
+		                          &m, &off);
+		len  = min(len, left);
+		while (len < HTTPK_SENDFILE_MAXLEN && len < left) {
+			nlen = shfs_volchk_locate(shfs_volchk_foff(hsess->fd, foff + len),
+			                          shfs_volchkoff_foff(hsess->fd, foff + len),
+			                          &nm, &noff);
+			if (nm != m || noff != off + len)
+				break; /* not contiguous on this member */
+			len += min(nlen, left - len);
+		}
+		len = min(len, (size_t) HTTPK_SENDFILE_MAXLEN);
+
+		loff = (off_t) off;
+		ret = sendfile(hsess->sfd, hks->mfd[m], &loff, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return -EAGAIN;
+			printd("sendfile() from member %u failed: %s\n", m, strerror(errno));
+			return -errno;
+		}
+		if (unlikely(ret == 0))
+			return -EIO; /* unexpected end of member */
+		hsess->sent += (uint64_t) ret;
+
+#if defined SHFS_STATS && defined SHFS_STATS_HTTP && defined SHFS_STATS_HTTP_DPC
+		while (unlikely(hsess->dpc_i < SHFS_STATS_HTTP_DPCR &&
+		                hsess->sent >= hsess->dpc_threshold[hsess->dpc_i]))
+			++hsess->el_stats->p[hsess->dpc_i++];
+#endif
+	}
+	return 0;
+}
+
+static int httpk_sendmsg(struct httpk_sess *hsess)
+{
+	ssize_t ret;
+
+	while (hsess->sent < hsess->rlen) {
+		ret = send(hsess->sfd, hsess->smsg + hsess->sent,
+		           (size_t) (hsess->rlen - hsess->sent), MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return -EAGAIN;
+			return -errno;
+		}
+		hsess->sent += (uint64_t) ret;
+	}
+	return 0;
+}
+
+static void httpk_sess_respond(struct httpk_sess *hsess)
+{
+	err_t err;
+	int ret;
+
+	for (;;) {
+		switch (hsess->state) {
+		case HKS_PARSING:
+			ret = httpk_sess_parse(hsess);
+			if (ret < 0)
+				goto close;
+			if (ret == 0) {
+				httpk_sess_events(hsess, EPOLLIN); /* wait for more data */
+				return;
+			}
+			if (hsess->url_overflow || hsess->rhdr.overflow)
+				goto close; /* request does not fit into our buffers */
+			hsess->state = HKS_PREPARING_HDR;
+			/* fall through */
+
+		case HKS_PREPARING_HDR:
+			if (httpk_prepare_hdr(hsess) == -EAGAIN) {
+				/* retried by http_ksock_poll() */
+				if (!dlist_is_linked(hsess, hks->ioretry_chain, ioretry_chain))
+					dlist_append(hsess, hks->ioretry_chain, ioretry_chain);
+				httpk_sess_events(hsess, 0); /* errors are still reported */
+				return;
+			}
+			hsess->state = HKS_RESPONDING_HDR;
+			/* fall through */
+
+		case HKS_RESPONDING_HDR:
+			err = http_sendhdr_write(&hsess->shdr, &hsess->hdr_sent,
+			                         (tcpwrite_fn_t) httpk_write, (void *) hsess);
+			if (err != ERR_OK && err != ERR_MEM)
+				goto close;
+			if (hsess->hdr_sent < hsess->hdr_total_len) {
+				httpk_sess_events(hsess, EPOLLOUT); /* wait for buffer space */
+				return;
+			}
+			hsess->state = HKS_RESPONDING_MSG;
+			/* fall through */
+
+		case HKS_RESPONDING_MSG:
+			if (hsess->type == HRT_FIOMSG)
+				ret = httpk_sendfile(hsess);
+			else if (hsess->type == HRT_SMSG)
+				ret = httpk_sendmsg(hsess);
+			else
+				ret = 0;
+			if (ret == -EAGAIN) {
+				httpk_sess_events(hsess, EPOLLOUT); /* wait for buffer space */
+				return;
+			}
+			if (ret < 0)
+				goto close;
+
+#if defined SHFS_STATS && defined SHFS_STATS_HTTP
+			if (hsess->type == HRT_FIOMSG)
+				++hsess->el_stats->c; /* successfully completed request */
+#endif
+			httpk_req_close(hsess);
+			if (!hsess->keepalive)
+				goto close;
+			httpk_req_reset(hsess); /* continue with next request */
+			break;
+
+		default:
+			goto close;
+		}
+	}
+
+ close:
+	httpk_sess_close(hsess);
+}
+
+/*******************************************************************************
+ * Front end
+ ******************************************************************************/
+int init_http_ksock(uint16_t port, uint16_t nb_sess)
+{
+	struct sockaddr_in sin;
+	struct epoll_event ev;
+	int one = 1;
+	int ret;
+
+	hks = target_malloc(CACHELINE_SIZE, sizeof(*hks));
+	if (!hks) {
+		ret = -ENOMEM;
+		goto err_out;
+	}
+	hks->max_nb_sess = nb_sess;
+	hks->nb_sess = 0;
+	hks->hsess_head = NULL;
+	hks->hsess_tail = NULL;
+	dlist_init_head(hks->ioretry_chain);
+	hks->nb_mfds = 0;
+
+	hks->sess_pool = alloc_simple_mempool(hks->max_nb_sess, sizeof(struct httpk_sess));
+	if (!hks->sess_pool) {
+		ret = -ENOMEM;
+		goto err_free_hks;
+	}
+
+	/* listening socket */
+	hks->lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (hks->lfd < 0) {
+		ret = -errno;
+		goto err_free_sesspool;
+	}
+	setsockopt(hks->lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_ANY);
+	sin.sin_port = htons(port);
+	if (bind(hks->lfd, (struct sockaddr *) &sin, sizeof(sin)) < 0 ||
+	    listen(hks->lfd, HTTPK_LISTEN_BACKLOG) < 0) {
+		ret = -errno;
+		goto err_close_lfd;
+	}
+
+	hks->efd = epoll_create1(EPOLL_CLOEXEC);
+	if (hks->efd < 0) {
+		ret = -errno;
+		goto err_close_lfd;
+	}
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL; /* listener */
+	if (epoll_ctl(hks->efd, EPOLL_CTL_ADD, hks->lfd, &ev) < 0) {
+		ret = -errno;
+		goto err_close_efd;
+	}
+
+	printd("HTTP kernel socket front end listening on port %"PRIu16"\n", port);
+	return 0;
+
+ err_close_efd:
+	close(hks->efd);
+ err_close_lfd:
+	close(hks->lfd);
+ err_free_sesspool:
+	free_mempool(hks->sess_pool);
+ err_free_hks:
+	target_free(hks);
+	hks = NULL;
+ err_out:
+	return ret;
+}
+
+void exit_http_ksock(void)
+{
+	if (!hks)
+		return;
+
+	/* terminate connections that are still open */
+	while (hks->hsess_head)
+		httpk_sess_close(hks->hsess_head);
+	BUG_ON(hks->nb_sess != 0);
+
+	httpk_close_members();
+	close(hks->efd);
+	close(hks->lfd);
+	free_mempool(hks->sess_pool);
+	target_free(hks);
+	hks = NULL;
+}
+
+void http_ksock_poll(void)
+{
+	struct epoll_event ev[HTTPK_MAXNB_EVENTS];
+	struct httpk_sess *hsess;
+	struct httpk_sess *hsess_next;
+	int nb_ev;
+	int i;
+
+	/* retry opening objects whose hash table chunk got loaded meanwhile
+	 * (the list is detached first: sessions can re-register themselves) */
+	hsess = dlist_first_el(hks->ioretry_chain, struct httpk_sess);
+	dlist_init_head(hks->ioretry_chain);
+	while (hsess) {
+		hsess_next = dlist_next_el(hsess, ioretry_chain);
+		hsess->ioretry_chain.next = NULL;
+		hsess->ioretry_chain.prev = NULL;
+		httpk_sess_respond(hsess);
+		hsess = hsess_next;
+	}
+
+	nb_ev = epoll_wait(hks->efd, ev, HTTPK_MAXNB_EVENTS, 0);
+	for (i = 0; i < nb_ev; ++i) {
+		if (!ev[i].data.ptr) {
+			httpk_accept();
+			continue;
+		}
+		if (ev[i].events & (EPOLLERR | EPOLLHUP) &&
+		    !(ev[i].events & (EPOLLIN | EPOLLOUT))) {
+			httpk_sess_close(ev[i].data.ptr);
+			continue;
+		}
+		httpk_sess_respond(ev[i].data.ptr);
+	}
+}
@@ -62,6 +62,50 @@ static inline size_t align_up(size_t size, size_t align)
   return (size + align - 1) & ~(align - 1);
 }
 
+#ifdef MEMPOOL_HUGEPAGES
+struct mempool_huge_stats mempool_huge_stats = { 0, 0, 0 };
+#endif
+
+/* allocates the object area of a pool: large areas are tried to be backed by
+ * huge pages first (*huge_len is set to the mapped length in this case) */
+static inline void *mempool_area_alloc(size_t align, size_t size, size_t *huge_len)
+{
+  *huge_len = 0;
+#ifdef MEMPOOL_HUGEPAGES
+  if (size >= MEMPOOL_HUGEPAGES_MINSIZE) {
+#ifdef TARGET_HUGEPAGES
+    void *area = target_malloc_huge(size, huge_len);
+
+    if (area) {
+      ++mempool_huge_stats.nb_pools;
+      mempool_huge_stats.size += *huge_len;
+      printd("%"PRIu64" bytes backed by huge pages @ %p (mapped: %"PRIu64" bytes)\n",
+             (uint64_t) size, area, (uint64_t) *huge_len);
+      return area;
+    }
+    *huge_len = 0;
+#endif
+    ++mempool_huge_stats.nb_fallbacks;
+    printd("No huge pages available for %"PRIu64" bytes: Falling back to regular allocation\n",
+           (uint64_t) size);
+  }
+#endif
+  return target_malloc(align, size);
+}
+
+static inline void mempool_area_free(void *area, size_t huge_len)
+{
+#if defined MEMPOOL_HUGEPAGES && defined TARGET_HUGEPAGES
+  if (huge_len) {
+    --mempool_huge_stats.nb_pools;
+    mempool_huge_stats.size -= huge_len;
+    target_free_huge(area, huge_len);
+    return;
+  }
+#endif
+  target_free(area);
+}
+
 struct mempool *alloc_enhanced_mempool(uint32_t nb_objs,
 					 size_t obj_size, size_t obj_data_align, size_t obj_headroom, size_t obj_tailroom, size_t obj_private_len, int sep_obj_data,
 					 void (*obj_init_func)(struct mempool_obj *, void *), void *obj_init_func_argp,
@@ -72,6 +116,7 @@ struct mempool *alloc_enhanced_mempool(uint32_t nb_objs,
   struct mempool_obj *obj;
   size_t h_size, p_size, m_size, o_size;
   size_t pool_size, data_size;
+  size_t huge_len;
   uint32_t i;
 
   if (obj_data_align)
@@ -123,8 +168,8 @@ struct mempool *alloc_enhanced_mempool(uint32_t nb_objs,
         errno = ENOMEM;
         goto error;
     }
-    p->obj_data_area = target_malloc(obj_data_align, data_size);
-    if (!p) {
+    p->obj_data_area = mempool_area_alloc(obj_data_align, data_size, &huge_len);
+    if (!p->obj_data_area) {
         errno = ENOMEM;
         goto error_free_p;
     }
@@ -134,13 +179,14 @@ struct mempool *alloc_enhanced_mempool(uint32_t nb_objs,
     pool_size = h_size + nb_objs * o_size;
     data_size = 0;
 
-    p = target_malloc(obj_data_align, pool_size);
+    p = mempool_area_alloc(obj_data_align, pool_size, &huge_len);
     if (!p) {
         errno = ENOMEM;
         goto error;
     }
     p->obj_data_area = NULL; /* no extra object data area*/
   }
+  p->huge_len = huge_len;
 
   /* initialize pool management */
   p->nb_objs            = nb_objs;
@@ -269,8 +315,11 @@ void free_mempool(struct mempool *p)
 {
   if (p) {
 	BUG_ON(p->nb_free_objs != p->nb_objs); /* some objects of this pool may be still in use */
-	if (p->obj_data_area)
-	  target_free(p->obj_data_area);
-	target_free(p);
+	if (p->obj_data_area) {
+	  mempool_area_free(p->obj_data_area, p->huge_len);
+	  target_free(p);
+	} else {
+	  mempool_area_free(p, p->huge_len);
+	}
   }
 }
@@ -123,8 +123,28 @@ struct mempool {
   uint32_t nb_free_objs;
   size_t pool_size;
   void *obj_data_area; /* points to data allocation when sep_obj_data = 1 */
+  size_t huge_len; /* mapped length when the object area is huge page backed, 0 otherwise */
 };
 
+#ifdef MEMPOOL_HUGEPAGES
+/*
+ * Pools with an object area of at least MEMPOOL_HUGEPAGES_MINSIZE bytes
+ * are backed by huge pages if the target provides them
+ * (fewer TLB misses when copying and checksumming objects)
+ * Otherwise, the regular allocation is used as fallback.
+ */
+#ifndef MEMPOOL_HUGEPAGES_MINSIZE
+#define MEMPOOL_HUGEPAGES_MINSIZE (2 * 1024 * 1024)
+#endif
+
+struct mempool_huge_stats {
+  uint32_t nb_pools; /* pools backed by huge pages */
+  uint32_t nb_fallbacks; /* pools that fell back to regular allocations */
+  uint64_t size; /* bytes mapped with huge pages */
+};
+extern struct mempool_huge_stats mempool_huge_stats;
+#endif
+
 /*
  * Callback obj_init_func will be called while objects are initialized for this memory pool
  *  void obj_init_func(struct mempool_obj *obj, void *argp)
@@ -228,6 +248,15 @@ static inline int mempool_pick_multiple(struct mempool *p, struct mempool_obj *o
 
 #define mempool_size(p) ((p)->pool_size)
 
+/*
+ * Object data area of pools that were allocated with sep_obj_data
+ * (all object data is placed in a single contiguous area, NULL otherwise)
+ */
+#define mempool_obj_data_area(p) ((p)->obj_data_area)
+#define mempool_obj_data_area_len(p) \
+	((p)->obj_data_area ? \
+	 ((size_t) (p)->nb_objs * ((p)->obj_headroom + (p)->obj_size + (p)->obj_tailroom)) : 0)
+
 /*
  * Put an object back to its depending memory pool.
  * This is like free() for memory pool objects
@@ -62,6 +62,9 @@
 #include "likely.h"
 #include "mempool.h"
 #include "http.h"
+#ifdef HTTP_KSOCK
+#include "http_ksock.h"
+#endif
 #ifdef HAVE_SHELL
 #include "shell.h"
 #include "shell_extras.h"
@@ -74,6 +77,12 @@
 #ifdef SHFS_STATS
 #include "shfs_stats.h"
 #endif
+#ifdef SHFS_CACHE_WARM
+#include "shfs_warm.h"
+#endif
+#ifdef SHFS_PREFETCH
+#include "shfs_prefetch.h"
+#endif
 #ifdef TESTSUITE
 #include "testsuite.h"
 #endif
@@ -269,12 +278,17 @@ struct mcargs {
     ip4_addr_t      dns1;
 #endif
     unsigned int    nb_http_sess;
+#ifdef HTTP_KSOCK
+    uint16_t        http_ksock_port; /* 0: kernel socket front end disabled */
+#endif
 
     int             bd_detect;
     unsigned int    nb_bds;
     blkdev_id_t     bd_id[MAX_NB_TRY_BLKDEVS];
     int             stats_bd;
     blkdev_id_t     stats_bd_id;
+    int             warm_bd;
+    blkdev_id_t     warm_bd_id;
 
     int             no_ctldir;
 
@@ -403,6 +417,7 @@ static int parse_args(int argc, char *argv[])
 #endif
     args.nb_bds = 0;
     args.stats_bd = 0; /* disable stats bd */
+    args.warm_bd = 0; /* disable cache snapshot bd */
 #ifdef CAN_DETECT_BLKDEVS
     args.bd_detect = 1;
 #else
@@ -412,6 +427,9 @@ static int parse_args(int argc, char *argv[])
     args.startup_delay = 0;
     args.no_ctldir = 0;
     args.nb_http_sess = CONFIG_LWIP_NUM_TCPCON;
+#ifdef HTTP_KSOCK
+    args.http_ksock_port = 0;
+#endif
 #if (!MEMP_MEM_MALLOC) && ((CONFIG_LWIP_NUM_TCPCON) < (MEMP_NUM_TCP_PCB))
     #error "MEMP_NUM_TCP_PCB has to be a least CONFIG_LWIP_NUM_TCPCON"
 #endif
@@ -423,6 +441,12 @@ static int parse_args(int argc, char *argv[])
 #endif
 #ifdef SHFS_STATS
                          "x:"
+#endif
+#ifdef SHFS_CACHE_WARM
+                         "p:"
+#endif
+#ifdef HTTP_KSOCK
+                         "k:"
 #endif
                           )) != -1) {
          switch(opt) {
@@ -525,6 +549,20 @@ static int parse_args(int argc, char *argv[])
 	      args.stats_bd = 1; /* enable stats bd */
 	      blkdev_id_cpy(args.stats_bd_id, ibd);
               break;
+#endif
+#ifdef SHFS_CACHE_WARM
+         case 'p': /* virtual block device for persisting cache snapshots */
+              if (blkdev_id_parse(optarg, &ibd) < 0) {
+	           printk("invalid block device id specified\n");
+	           return -1;
+              }
+	      if (args.warm_bd) {
+		   printk("only one cache snapshot device can be specified\n");
+	           return -1;
+	      }
+	      args.warm_bd = 1; /* enable cache snapshot bd */
+	      blkdev_id_cpy(args.warm_bd_id, ibd);
+              break;
 #endif
          case 'c': /* number of http connections */
 	      ret = parse_args_setval_int(&ival, optarg);
@@ -535,6 +573,16 @@ static int parse_args(int argc, char *argv[])
 	      }
 	      args.nb_http_sess = ival;
               break;
+#ifdef HTTP_KSOCK
+         case 'k': /* port of kernel socket front end */
+	      ret = parse_args_setval_int(&ival, optarg);
+	      if (ret < 0 || ival < 1 || ival > 65535) {
+		      printk("invalid port for kernel socket front end specified\n");
+	           return -1;
+	      }
+	      args.http_ksock_port = (uint16_t) ival;
+              break;
+#endif
 
          default:
 	      return -1;
@@ -821,6 +869,17 @@ int main(int argc, char *argv[])
      * ----------------------------------- */
     printk("Loading SHFS...\n");
     init_shfs();
+#ifdef SHFS_CACHE_WARM
+    if (args.warm_bd) {
+	    /* has to be opened before the automount replays a snapshot */
+	    printk("Initializing cache snapshot device...\n");
+	    ret = init_shfs_warm(args.warm_bd_id);
+	    if (ret < 0) {
+		    printk("Warning: Could not open cache snapshot device: %s\n", strerror(-ret));
+		    args.warm_bd = 0;
+	    }
+    }
+#endif
 #ifdef CONFIG_AUTOMOUNT
     if (args.nb_bds) {
 	    printk("Automount cache filesystem...\n");
@@ -846,9 +905,24 @@ int main(int argc, char *argv[])
 #endif
     printk("Starting HTTP server (max number of connections: %u)...\n",
            args.nb_http_sess);
-    init_http(args.nb_http_sess,
-              args.nb_http_sess << 1); /* nb reqs have to be at least double to
-					* ensure all connections can be used simultaneously */
+    ret = init_http(args.nb_http_sess,
+                    args.nb_http_sess << 1); /* nb reqs have to be at least double to
+					      * ensure all connections can be used simultaneously */
+    if (ret < 0) {
+	    printk("FATAL: Could not start HTTP server: %s\n", strerror(-ret));
+	    goto out;
+    }
+#ifdef HTTP_KSOCK
+    if (args.http_ksock_port) {
+	    printk("Starting HTTP kernel socket front end on port %"PRIu16"...\n",
+	           args.http_ksock_port);
+	    ret = init_http_ksock(args.http_ksock_port, args.nb_http_sess);
+	    if (ret < 0) {
+		    printk("Warning: Could not start HTTP kernel socket front end: %s\n", strerror(-ret));
+		    args.http_ksock_port = 0;
+	    }
+    }
+#endif
 
     /* add custom commands to the shell */
 #ifdef HAVE_SHELL
@@ -860,6 +934,13 @@ int main(int argc, char *argv[])
 #else
     register_shfs_tools();
 #endif
+#ifdef SHFS_CACHE_WARM
+#ifdef HAVE_CTLDIR
+    register_shfs_warm_tools(cd); /* Note: cd might be NULL */
+#else
+    register_shfs_warm_tools();
+#endif
+#endif
 #endif
 
 #ifdef SHFS_STATS
@@ -882,6 +963,9 @@ int main(int argc, char *argv[])
 #else
     register_shfs_stats_tools();
 #endif
+#if defined SHFS_PREFETCH && defined HAVE_SHELL
+    register_shfs_prefetch_tools();
+#endif
 #endif /* SHFS_STATS */
 
     /* -----------------------------------
@@ -988,6 +1072,18 @@ int main(int argc, char *argv[])
 
 	/* poll IO retry chain of HTTP */
 	http_poll_ioretry();
+#ifdef SHFS_CACHE_WARM
+	/* replay cache snapshot (rate limited) */
+	shfs_warm_poll();
+#endif
+#ifdef SHFS_PREFETCH
+	/* prefetch popular objects while the volume is idle */
+	shfs_prefetch_poll();
+#endif
+#ifdef HTTP_KSOCK
+	if (args.http_ksock_port)
+		http_ksock_poll();
+#endif
 
 #ifdef CONFIG_LWIP_NOTHREADS
         /* NIC handling loop (single threaded lwip) */
@@ -1051,6 +1147,10 @@ int main(int argc, char *argv[])
     }
 #endif
     printk("Stopping HTTP server...\n");
+#ifdef HTTP_KSOCK
+    if (args.http_ksock_port)
+	    exit_http_ksock();
+#endif
     exit_http();
 #ifdef HAVE_SHELL
     printk("Stopping shell...\n");
@@ -1058,6 +1158,9 @@ int main(int argc, char *argv[])
 #endif
     printk("Unmounting cache filesystem...\n");
     umount_shfs(0); /* we cannot enforce unmount but all files should be closed here anyways */
+#ifdef SHFS_CACHE_WARM
+    exit_shfs_warm(); /* snapshot was saved by umount */
+#endif
     exit_shfs();
     printk("Stopping networking...\n");
     netif_set_down(&netif);
@@ -40,6 +40,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <time.h>
+#include <string.h>
 #include "likely.h"
 
 #ifdef SHELL_DEBUG
@@ -48,8 +49,11 @@
 #include "debug.h"
 
 #include "shell_extras.h"
+#ifdef MEMPOOL_HUGEPAGES
+#include "mempool.h"
+#endif
 
-#ifdef __MINIOS__
+#if defined __MINIOS__ || defined MEMPOOL_HUGEPAGES
 static int shcmd_free(FILE *cio, int argc, char *argv[]);
 #endif
 #if defined HAVE_LIBC && !defined CONFIG_ARM
@@ -67,7 +71,7 @@ int register_shell_extras(struct ctldir *cd)
 {
 	/* ctldir entries (ignore errors) */
 	if (cd) {
-#ifdef __MINIOS__
+#if defined __MINIOS__ || defined MEMPOOL_HUGEPAGES
 		ctldir_register_shcmd(cd, "free",   shcmd_free);
 #endif
 #if defined HAVE_LIBC && !(defined __MINIOS__ && defined CONFIG_ARM)
@@ -84,7 +88,7 @@ int register_shell_extras(struct ctldir *cd)
 int register_shell_extras(void)
 {
 #endif
-#ifdef __MINIOS__
+#if defined __MINIOS__ || defined MEMPOOL_HUGEPAGES
     shell_register_cmd("free",   shcmd_free);
 #endif
 #if defined HAVE_LIBC && !(defined __MINIOS__ && defined CONFIG_ARM)
@@ -100,6 +104,17 @@ int register_shell_extras(void)
     return 0;
 }
 
+#ifdef MEMPOOL_HUGEPAGES
+/* memory of pools that are backed by huge pages */
+static inline void _shcmd_free_huge(FILE *cio, uint64_t base)
+{
+    fprintf(cio, "Huge:  %12"PRIu64" (%"PRIu32" pools, %"PRIu32" fallbacks to regular pages)\n",
+            mempool_huge_stats.size / base,
+            mempool_huge_stats.nb_pools,
+            mempool_huge_stats.nb_fallbacks);
+}
+#endif
+
 #if defined __MINIOS__
 #include <mini-os/mm.h>
 
@@ -203,6 +218,9 @@ static int shcmd_free(FILE *cio, int argc, char *argv[])
 	    fprintf(cio, "%12"PRIu64" ", heap_s / base);
 #endif
 	    fprintf(cio, "%12"PRIu64"\n", free_s /base);
+#ifdef MEMPOOL_HUGEPAGES
+	    _shcmd_free_huge(cio, base);
+#endif
         } while(0);
         break;
     }
@@ -212,6 +230,34 @@ static int shcmd_free(FILE *cio, int argc, char *argv[])
     fprintf(cio, "%s [[-k|-m|-g|-p|-u]]\n", argv[0]);
     return -1;
 }
+#elif defined MEMPOOL_HUGEPAGES
+static int shcmd_free(FILE *cio, int argc, char *argv[])
+{
+    uint64_t base;
+
+    /* parsing */
+    base = 1;
+    if (argc == 2) {
+	    if (strcmp(argv[1], "-k") == 0)
+		    base = 1024;
+	    else if (strcmp(argv[1], "-m") == 0)
+		    base = 1024 * 1024;
+	    else if (strcmp(argv[1], "-g") == 0)
+		    base = 1024 * 1024 * 1024;
+	    else
+		    goto usage;
+    } else if (argc > 2) {
+	    goto usage;
+    }
+
+    /* output */
+    _shcmd_free_huge(cio, base);
+    return 0;
+
+ usage:
+    fprintf(cio, "%s [[-k|-m|-g]]\n", argv[0]);
+    return -1;
+}
 #endif
 
 #if defined HAVE_LIBC && !defined CONFIG_ARM
@@ -74,6 +74,7 @@ static inline int sem_stub(uint64_t s) { return 1; }
 #define shfs_free_cache()
 #define free_mempool(a)
 #define shfs_flush_cache()
+#define shfs_cache_invalidate(start, end)
 
 static inline int mempool_free_count(struct mempool *a)
 {
@@ -70,7 +70,7 @@ static struct vol_info shfs_vol;
 /******************************************************************************
  * ARGUMENT PARSING                                                           *
  ******************************************************************************/
-const char *short_opts = "h?vVfa:u:r:c:d:Cm:n:t:D:li";
+const char *short_opts = "h?vVfa:u:r:c:d:Cm:e:n:t:D:li";
 
 static struct option long_opts[] = {
 	{"help",		no_argument,		NULL,	'h'},
@@ -84,6 +84,7 @@ static struct option long_opts[] = {
 	{"set-default",		required_argument,	NULL,	'd'},
 	{"clear-default",	no_argument,		NULL,	'C'},
 	{"mime",		required_argument,	NULL,	'm'},
+	{"encoding",		required_argument,	NULL,	'e'},
 	{"name",		required_argument,	NULL,	'n'},
 	{"digest",		required_argument,	NULL,	'D'},
 	{"type",		required_argument,	NULL,	't'},
@@ -117,7 +118,10 @@ static void print_usage(char *argv0)
 	                                        "hash function 'Manual')\n");
 	printf("  For each add-obj token:\n");
 	printf("    -m, --mime [MIME]          sets the MIME type for the object\n");
-	//printf("    -e, --encoding [ENCODING]  sets encoding type for preencoded content\n");
+	printf("    -e, --encoding [ENCODING]  sets the content encoding of a pre-encoded object\n");
+	printf("                               ENCODING can be: gzip, br, zstd\n");
+	printf("                               (the object becomes a variant of the object\n");
+	printf("                                with the same name)\n");
 	printf("  For each add-lnk token:\n");
 	printf("    -t, --type [TYPE]          sets the TYPE for a linked object\n");
 	printf("                               TYPE can be: redirect, raw, auto\n");
@@ -130,6 +134,9 @@ static void print_usage(char *argv0)
 	printf("\n");
 	printf("Example (adding a file):\n");
 	printf(" %s --add-obj song.mp3 -m audio/mpeg3 /dev/ram15\n", argv0);
+	printf("Example (adding a file with a gzip variant):\n");
+	printf(" %s --add-obj index.html -m text/html --add-obj index.html.gz -m text/html \\\n"
+	       "   -n index.html -e gzip /dev/ram15\n", argv0);
 }
 
 static void release_args(struct args *args)
@@ -147,6 +154,8 @@ static void release_args(struct args *args)
 			free(ctoken->optstr0);
 		if (ctoken->optstr1)
 			free(ctoken->optstr1);
+		if (ctoken->optstr3)
+			free(ctoken->optstr3);
 		ntoken = ctoken->next;
 		free(ctoken);
 		ctoken = ntoken;
@@ -195,6 +204,15 @@ static inline int parse_args_set_ltype(enum ltype *out, const char *arg)
 	return -EINVAL;
 }
 
+static inline int parse_args_check_encoding(const char *arg)
+{
+	if (strcmp("gzip", arg) == 0 ||
+	    strcmp("br", arg) == 0 ||
+	    strcmp("zstd", arg) == 0)
+		return 0;
+	return -EINVAL;
+}
+
 static int parse_args(int argc, char **argv, struct args *args)
 /*
  * Parse arguments on **argv (number of args on argc)
@@ -263,6 +281,18 @@ static int parse_args(int argc, char **argv, struct args *args)
 			if (parse_args_setval_str(&ctoken->optstr0, optarg) < 0)
 				die();
 			break;
+		case 'e': /* encoding */
+			if (!ctoken || (ctoken->action != ADDOBJ)) {
+				eprintf("Please set encoding after an add-obj token\n");
+				return -EINVAL;
+			}
+			if (parse_args_check_encoding(optarg) < 0) {
+				eprintf("Encoding '%s' is invalid and not supported\n", optarg);
+				return -EINVAL;
+			}
+			if (parse_args_setval_str(&ctoken->optstr3, optarg) < 0)
+				die();
+			break;
 		case 'n': /* name */
 			if (!ctoken || (ctoken->action != ADDOBJ && ctoken->action != ADDLNK)) {
 				eprintf("Please set name after an add-obj, add-lnk token\n");
@@ -446,6 +476,7 @@ static void load_vol_cconf(char *path[], unsigned int count)
 	memcpy(shfs_vol.uuid, hdr_common->vol_uuid, 16);
 	memcpy(shfs_vol.volname, hdr_common->vol_name, 16);
 	shfs_vol.volname[17] = '\0'; /* ensure nullterminated volume name */
+	shfs_vol.minor = hdr_common->version[1];
 	shfs_vol.s.stripesize = hdr_common->member_stripesize;
 	shfs_vol.s.stripemode = hdr_common->member_stripemode;
 	if (shfs_vol.s.stripemode != SHFS_SM_COMBINED &&
@@ -529,9 +560,11 @@ static void load_vol_hconf(void)
 	shfs_vol.hfunc                        = hdr_config->hfunc;
 	shfs_vol.hlen                         = hdr_config->hlen;
 	shfs_vol.allocator                    = hdr_config->allocator;
+	shfs_vol.htable_bucket_mode           = SHFS_HTABLE_BUCKET_MODE(shfs_vol.minor, hdr_config);
 
 	/* brief configuration check */
-	if (shfs_vol.htable_len == 0)
+	if (shfs_vol.htable_len == 0 ||
+	    !SHFS_HTABLE_BUCKET_MODE_VALID(shfs_vol.htable_bucket_mode, hdr_config))
 		dief("Malformed SHFS configuration\n");
 
 	free(chk1);
@@ -554,7 +587,8 @@ static void load_vol_htable(void)
 	dprintf(D_L0, "Allocating btable...\n");
 	shfs_vol.bt = shfs_alloc_btable(shfs_vol.htable_nb_buckets,
 	                                shfs_vol.htable_nb_entries_per_bucket,
-	                                shfs_vol.hlen);
+	                                shfs_vol.hlen,
+	                                shfs_vol.htable_bucket_mode);
 	if (!shfs_vol.bt)
 		die();
 
@@ -913,10 +947,12 @@ static int actn_addfile(struct token *j)
 	hentry->ts_creation = gettimestamp_s();
 	hentry->flags = 0;
 	memset(hentry->f_attr.mime, 0, sizeof(hentry->f_attr.mime));
-	memset(hentry->f_attr.encoding, 0, sizeof(hentry->f_attr.encoding));  /* currently unused */
+	memset(hentry->f_attr.encoding, 0, sizeof(hentry->f_attr.encoding));
 	memset(hentry->name, 0, sizeof(hentry->name));
 	if (j->optstr0) /* mime */
 		strncpy(hentry->f_attr.mime, j->optstr0, sizeof(hentry->f_attr.mime));
+	if (j->optstr3) /* encoding */
+		strncpy(hentry->f_attr.encoding, j->optstr3, sizeof(hentry->f_attr.encoding));
 	if (j->optstr1) /* filename */
 		strncpy(hentry->name, j->optstr1, sizeof(hentry->name));
 	else
@@ -1433,10 +1469,13 @@ static int actn_ls(struct token *token)
 	struct shfs_hentry *hentry;
 	char str_hash[(shfs_vol.hlen * 2) + 1];
 	char str_mime[sizeof(hentry->f_attr.mime) + 1];
+	char str_enc[sizeof(hentry->f_attr.encoding) + 1];
 	char str_name[sizeof(hentry->name) + 1];
 	char str_date[20];
 
 	str_hash[(shfs_vol.hlen * 2)] = '\0';
+	str_mime[sizeof(hentry->f_attr.mime)] = '\0';
+	str_enc[sizeof(hentry->f_attr.encoding)] = '\0';
 	str_name[sizeof(hentry->name)] = '\0';
 	str_date[0] = '\0';
 
@@ -1462,8 +1501,10 @@ static int actn_ls(struct token *token)
 		strncpy(str_name, hentry->name, sizeof(hentry->name));
 		strftimestamp_s(str_date, sizeof(str_date),
 		                "%b %e, %g %H:%M", hentry->ts_creation);
-		if (!SHFS_HENTRY_ISLINK(hentry))
+		if (!SHFS_HENTRY_ISLINK(hentry)) {
 			strncpy(str_mime, hentry->f_attr.mime, sizeof(hentry->f_attr.mime));
+			strncpy(str_enc, hentry->f_attr.encoding, sizeof(hentry->f_attr.encoding));
+		}
 
 		/* hash */
 		if (shfs_vol.hlen <= 32)
@@ -1501,7 +1542,8 @@ static int actn_ls(struct token *token)
 
 			printf("%-24s ", " ");
 		} else {
-			printf("      ");
+			/* encoding of variants */
+			printf("%5.5s ", str_enc);
 			printf("%-24s ", str_mime);
 		}
 
@@ -69,6 +69,7 @@ struct token {
 	char *optstr0;
 	char *optstr1;
 	char *optstr2;
+	char *optstr3;
 	enum ltype optltype;
 };
 
@@ -82,6 +83,7 @@ struct args {
 struct vol_info {
 	uuid_t uuid;
 	char volname[17];
+	uint8_t minor; /* minor version of the volume format */
 	uint32_t chunksize;
 	chk_t volsize;
 
@@ -98,6 +100,7 @@ struct vol_info {
 	uint32_t htable_nb_entries;
 	uint32_t htable_nb_entries_per_bucket;
 	uint32_t htable_nb_entries_per_chunk;
+	uint8_t htable_bucket_mode;
 	uint8_t hfunc;
 	uint8_t hlen;
 
@@ -52,7 +52,7 @@ int force = 0;
 /******************************************************************************
  * ARGUMENT PARSING                                                           *
  ******************************************************************************/
-const char *short_opts = "h?vVfn:s:cb:e:xF:l:";
+const char *short_opts = "h?vVfn:s:cb:e:m:xF:l:";
 
 static struct option long_opts[] = {
 	{"help",		no_argument,		NULL,	'h'},
@@ -64,6 +64,7 @@ static struct option long_opts[] = {
 	{"combined-striping",	no_argument,		NULL,	'c'},
 	{"bucket-count",	required_argument,	NULL,	'b'},
 	{"entries-per-bucket",	required_argument,	NULL,	'e'},
+	{"bucket-mode",		required_argument,	NULL,	'm'},
 	{"erase",		no_argument,		NULL,	'x'},
 	{"hash-function",	required_argument,	NULL,	'F'},
 	{"hash-length",		required_argument,	NULL,	'l'},
@@ -98,6 +99,10 @@ static void print_usage(char *argv0)
 	printf(" Hash table related configuration:\n");
 	printf("  -b, --bucket-count [COUNT]       sets the total number of buckets\n");
 	printf("  -e, --entries-per-bucket [COUNT] sets the number of entries for each bucket\n");
+	printf("  -m, --bucket-mode [MODE]         sets the bucket selection function:\n");
+	printf("                                    modulo (default), pow2, fastrange\n");
+	printf("                                    pow2 requires a power of two bucket count,\n");
+	printf("                                    non-modulo volumes require SHFS v%u.%02u\n", SHFS_MAJOR, SHFS_MINOR);
 	printf("  -F, --hash-function [FUNCTION]   sets the object hashing function:\n");
 	printf("                                    sha (default), crc, md5, haval, manual\n");
 	printf("  -l, --hash-length [BYTES]        sets the the hash digest length in bytes\n");
@@ -143,6 +148,7 @@ static int parse_args(int argc, char **argv, struct args *args)
 	args->allocator = SALLOC_FIRSTFIT;
 	args->bucket_count = 2048;
 	args->entries_per_bucket = 8;
+	args->bucket_mode = SBKT_MODULO;
 	args->fullerase = 0;
 	args->combined_striping = 0;
 
@@ -203,6 +209,18 @@ static int parse_args(int argc, char **argv, struct args *args)
 			}
 			args->entries_per_bucket = (uint32_t) tmp;
 			break;
+		case 'm': /* bucket-mode */
+			if        (strcmp("modulo", optarg) == 0) {
+				args->bucket_mode = SBKT_MODULO;
+			} else if (strcmp("pow2", optarg) == 0) {
+				args->bucket_mode = SBKT_POW2;
+			} else if (strcmp("fastrange", optarg) == 0) {
+				args->bucket_mode = SBKT_FASTRANGE;
+			} else {
+				eprintf("Unknown bucket mode specified\n");
+				return -EINVAL;
+			}
+			break;
 		case 'x': /* erase whole volume (full format) */
 			args->fullerase = 1;
 			break;
@@ -309,6 +327,12 @@ static int parse_args(int argc, char **argv, struct args *args)
 		return -EINVAL;
 	}
 
+	/* power of two bucket selection */
+	if (args->bucket_mode == SBKT_POW2 && !POWER_OF_2(args->bucket_count)) {
+		printf("Bucket mode pow2 requires a power of two bucket count\n");
+		return -EINVAL;
+	}
+
 	/* extra arguments are devices... just add a reference of those to args */
 	if (argc <= optind) {
 		eprintf("Path to device(s) not specified\n");
@@ -362,7 +386,9 @@ static void mkfs(struct storage *s, struct args *args)
 	hdr_common->magic[2] = SHFS_MAGIC2;
 	hdr_common->magic[3] = SHFS_MAGIC3;
 	hdr_common->version[0] = SHFS_MAJOR;
-	hdr_common->version[1] = SHFS_MINOR;
+	/* modulo volumes stay readable by older implementations */
+	hdr_common->version[1] = (args->bucket_mode == SBKT_MODULO) ?
+	                         SHFS_MINOR_COMPAT : SHFS_MINOR;
 	uuid_generate(hdr_common->vol_uuid);
 	strncpy(hdr_common->vol_name, args->volname, 16);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -411,6 +437,7 @@ static void mkfs(struct storage *s, struct args *args)
 	hdr_config->htable_bucket_count = args->bucket_count;
 	hdr_config->htable_entries_per_bucket = args->entries_per_bucket;
 	hdr_config->allocator = args->allocator;
+	hdr_config->htable_bucket_mode = args->bucket_mode;
 
 	/*
 	 * Check device size
@@ -553,6 +580,7 @@ int main(int argc, char **argv)
 	printvar(args.hashlen, "%"PRIu32);
 	printvar(args.bucket_count, "%"PRIu32);
 	printvar(args.entries_per_bucket, "%"PRIu32);
+	printvar(args.bucket_mode, "%"PRIu8);
 
 	/*
 	 * MAIN
@@ -56,6 +56,7 @@ struct args {
 	uint8_t  hashlen;
 	uint32_t bucket_count;
 	uint32_t entries_per_bucket;
+	uint8_t  bucket_mode;
 };
 
 #endif /* _SHFS_MKFS_ */
@@ -251,6 +251,7 @@ void print_shfs_hdr_summary(struct shfs_hdr_common *hdr_common,
 	uint64_t htable_size;
 	chk_t    htable_size_chks;
 	uint32_t htable_total_entries;
+	uint8_t  bkt_mode;
 	uint8_t  m;
 	char str_uuid[37];
 	char str_date[20];
@@ -260,6 +261,7 @@ void print_shfs_hdr_summary(struct shfs_hdr_common *hdr_common,
 	htable_total_entries = SHFS_HTABLE_NB_ENTRIES(hdr_config);
 	htable_size_chks     = SHFS_HTABLE_SIZE_CHUNKS(hdr_config, chunksize);
 	htable_size          = CHUNKS_TO_BYTES(htable_size_chks, chunksize);
+	bkt_mode             = SHFS_HTABLE_BUCKET_MODE(hdr_common->version[1], hdr_config);
 
 	printf("SHFS version:      %2x.%02x\n",
 	       hdr_common->version[0],
@@ -290,6 +292,10 @@ void print_shfs_hdr_summary(struct shfs_hdr_common *hdr_common,
 	       htable_total_entries, hdr_config->htable_bucket_count,
 	       htable_size_chks, htable_size / 1024,
 	       hdr_config->htable_bak_ref ? "2nd copy enabled" : "No copy");
+	printf("Bucket selection:   %s\n",
+	       (bkt_mode == SBKT_MODULO ? "Modulo" :
+	        (bkt_mode == SBKT_POW2 ? "Power of two" :
+	         (bkt_mode == SBKT_FASTRANGE ? "Fastrange" : "Unknown"))));
 	printf("Entry size:         %"PRIu64" Bytes (raw: %zu Bytes)\n", hentry_size, sizeof(struct shfs_hentry));
 	printf("Metadata total:     %"PRIu64" chunks\n", metadata_size(hdr_common, hdr_config));
 	printf("Available space:    %"PRIu64" chunks\n", avail_space(hdr_common, hdr_config));
@@ -56,6 +56,12 @@ int shfs_errno;
 #include "shfs_stats_data.h"
 #include "shfs_stats.h"
 #endif
+#ifdef SHFS_CACHE_WARM
+#include "shfs_warm.h"
+#endif
+#ifdef SHFS_PREFETCH
+#include "shfs_prefetch.h"
+#endif
 
 #ifdef SHFS_DEBUG
 #define ENABLE_DEBUG
@@ -66,16 +72,26 @@ int shfs_errno;
 #define CACHELINE_SIZE 64
 #endif
 
-#if defined TRACE_BOOTTIME && CONFIG_AUTOMOUNT
+#ifdef TRACE_BOOTTIME
 #define TT_DECLARE(var) uint64_t (var) = 0
 #define TT_START(var) do { (var) = target_now_ns(); } while(0)
 #define TT_END(var) do { (var) = (target_now_ns() - (var)); } while(0)
-
+#define TT_ADD(sum, var) do { (sum) += (var); } while(0)
+#define TT_PRINT(desc, var)			\
+  printk(" %-32s: %"PRIu64".%06"PRIu64"s\n",		\
+	 (desc),				\
+	 (var) / 1000000000l,			\
+	 ((var) / 1000l) % 1000000l);
+
+#if CONFIG_AUTOMOUNT
 TT_DECLARE(shfs_tt_vbdopen);
+#endif
 #else /* TRACE_BOOTTIME */
 #define TT_DECLARE(var) while(0) {}
 #define TT_START(var) while(0) {}
 #define TT_END(var) while(0) {}
+#define TT_ADD(sum, var) while(0) {}
+#define TT_PRINT(desc, var) while(0) {}
 #endif
 
 
@@ -83,6 +99,7 @@ int shfs_mounted = 0;
 unsigned int shfs_nb_open = 0;
 sem_t shfs_mount_lock;
 struct vol_info shfs_vol;
+void (*shfs_pcookie_release)(void *pcookie) = NULL; /* NULL: target_free() */
 
 int init_shfs(void) {
 	init_SEMAPHORE(&shfs_mount_lock, 1);
@@ -230,6 +247,7 @@ static int load_vol_cconf(blkdev_id_t bd_id[], unsigned int count)
 	memcpy(shfs_vol.volname, hdr_common->vol_name, 16);
 	shfs_vol.volname[16] = '\0'; /* ensure nullterminated volume name */
 	shfs_vol.ts_creation = hdr_common->vol_ts_creation;
+	shfs_vol.minor = hdr_common->version[1];
 	shfs_vol.stripesize = hdr_common->member_stripesize;
 	shfs_vol.stripemode = hdr_common->member_stripemode;
 #if defined CONFIG_SELECT_POLL && defined CAN_POLL_BLKDEV
@@ -380,11 +398,13 @@ static int load_vol_hconf(void)
 	shfs_vol.htable_nb_entries            = SHFS_HTABLE_NB_ENTRIES(hdr_config);
 	shfs_vol.htable_nb_entries_per_chunk  = SHFS_HENTRIES_PER_CHUNK(shfs_vol.chunksize);
 	shfs_vol.htable_len                   = SHFS_HTABLE_SIZE_CHUNKS(hdr_config, shfs_vol.chunksize);
+	shfs_vol.htable_bucket_mode           = SHFS_HTABLE_BUCKET_MODE(shfs_vol.minor, hdr_config);
 	shfs_vol.hlen = hdr_config->hlen;
 	ret = 0;
 
 	/* brief configuration check */
-	if (shfs_vol.htable_len == 0) {
+	if (shfs_vol.htable_len == 0 ||
+	    !SHFS_HTABLE_BUCKET_MODE_VALID(shfs_vol.htable_bucket_mode, hdr_config)) {
 		printd("Malformed SHFS configuration\n");
 		ret = -ENOENT;
 		goto out_free_chk1;
@@ -424,12 +444,305 @@ static void _load_vol_htable_cb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
 		aiot->done = 1;
 }
 
+/**
+ * Reads all hash table chunks with up to SHFS_REMOUNT_NB_BUFFERS
+ *  parallel reads (into the remount chunk buffers) and hands over
+ *  each chunk to process() as soon as its read completed
+ * Note: process() is not called anymore after an I/O error
+ */
+static int scan_vol_htable(void (*process)(chk_t c, void *chk_buf), const char *desc)
+{
+	struct {
+		SHFS_AIO_TOKEN *t;
+		chk_t c;
+		void *buf;
+	} slot[SHFS_REMOUNT_NB_BUFFERS];
+	unsigned int nb_slots;
+	unsigned int nb_infly = 0;
+	unsigned int s;
+	chk_t next = 0;
+	int ioret;
+	int ret = 0;
+	TT_DECLARE(_tt_scan);
+	TT_DECLARE(_tt);
+	TT_DECLARE(_tt_io);
+	TT_DECLARE(_tt_process);
+
+	TT_START(_tt_scan);
+	nb_slots = (unsigned int) min((chk_t) SHFS_REMOUNT_NB_BUFFERS, shfs_vol.htable_len);
+	for (s = 0; s < nb_slots; ++s) {
+		slot[s].t = NULL;
+		slot[s].buf = (uint8_t *) shfs_vol.remount_chunk_buffer
+		              + (s * shfs_vol.chunksize);
+	}
+
+	for (;;) {
+		/* fill read window (no new reads after an error) */
+		for (s = 0; s < nb_slots && next < shfs_vol.htable_len && ret == 0; ++s) {
+			if (slot[s].t)
+				continue;
+			slot[s].t = shfs_aread_chunk(shfs_vol.htable_ref + next, 1, slot[s].buf,
+			                             NULL, NULL, NULL);
+			if (!slot[s].t) {
+				if (errno == EAGAIN || errno == EBUSY)
+					break; /* retry when a read completed */
+				printd("Could not setup async read: %s\n", strerror(errno));
+				ret = -EIO;
+				break;
+			}
+			slot[s].c = next++;
+			++nb_infly;
+		}
+		shfs_aio_submit();
+
+		if (!nb_infly) {
+			if (ret < 0 || next == shfs_vol.htable_len)
+				break; /* done */
+			/* tokens or device slots are exhausted by other users */
+			shfs_poll_blkdevs();
+			schedule();
+			continue;
+		}
+
+		/* wait for any read to complete */
+		TT_START(_tt);
+		for (;;) {
+			for (s = 0; s < nb_slots; ++s) {
+				if (slot[s].t && shfs_aio_is_done(slot[s].t))
+					break;
+			}
+			if (s < nb_slots)
+				break;
+			shfs_poll_blkdevs();
+			schedule();
+		}
+		TT_END(_tt);
+		TT_ADD(_tt_io, _tt);
+
+		ioret = shfs_aio_finalize(slot[s].t);
+		slot[s].t = NULL;
+		--nb_infly;
+		if (ioret < 0)
+			ret = -EIO;
+		if (ret < 0)
+			continue; /* wait for outstanding reads */
+
+		/* processing might yield the CPU:
+		 * reads of the other slots continue meanwhile */
+		TT_START(_tt);
+		process(slot[s].c, slot[s].buf);
+		TT_END(_tt);
+		TT_ADD(_tt_process, _tt);
+	}
+
+	TT_END(_tt_scan);
+	TT_PRINT(desc, _tt_scan);
+	TT_PRINT(" \\_ waiting for I/O", _tt_io);
+	TT_PRINT(" \\_ processing chunks", _tt_process);
+	return ret;
+}
+
+#ifdef SHFS_NAMEINDEX
+#define SHFS_NAMELEN sizeof(((struct shfs_hentry *) 0)->name)
+
+/* FNV-1a hash of a (not necessarily terminated) entry name */
+static inline uint32_t _nindex_hash(const char *name)
+{
+	register uint32_t h = 2166136261u;
+	register size_t i;
+
+	for (i = 0; i < SHFS_NAMELEN && name[i] != '\0'; ++i) {
+		h ^= (uint8_t) name[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static inline int _nindex_indexable(struct shfs_hentry *hentry)
+{
+	return (hentry->name[0] != '\0' && !SHFS_HENTRY_ISVARIANT(hentry));
+}
+
+static void _nindex_add(struct shfs_bentry *bentry)
+{
+	register uint32_t i;
+
+	if (!_nindex_indexable(bentry->hentry))
+		return;
+	bentry->nhash = _nindex_hash(bentry->hentry->name);
+	for (i = bentry->nhash & shfs_vol.nindex_mask;
+	     shfs_vol.nindex[i];
+	     i = (i + 1) & shfs_vol.nindex_mask)
+		BUG_ON(shfs_vol.nindex[i] == bentry);
+	shfs_vol.nindex[i] = bentry;
+}
+
+/* Note: uses the name hash that was stored by _nindex_add(),
+ *  the hentry is not accessed (it might not be resident) */
+static void _nindex_rm(struct shfs_bentry *bentry)
+{
+	register uint32_t i, j, k;
+	register uint32_t mask = shfs_vol.nindex_mask;
+
+	for (i = bentry->nhash & mask;
+	     shfs_vol.nindex[i] != bentry;
+	     i = (i + 1) & mask) {
+		if (!shfs_vol.nindex[i])
+			return; /* not indexed */
+	}
+
+	/* backward shift deletion: move up entries that
+	 * would not be found anymore otherwise */
+	for (j = (i + 1) & mask; shfs_vol.nindex[j]; j = (j + 1) & mask) {
+		k = shfs_vol.nindex[j]->nhash & mask;
+		if (((j - k) & mask) >= ((j - i) & mask)) {
+			shfs_vol.nindex[i] = shfs_vol.nindex[j];
+			i = j;
+		}
+	}
+	shfs_vol.nindex[i] = NULL;
+}
+
+static int alloc_vol_nindex(void)
+{
+#ifndef SHFS_HTABLE_LAZY
+	struct htable_el *el;
+#endif
+	uint32_t len;
+
+	len = 1;
+	while (len < (uint64_t) shfs_vol.htable_nb_entries * SHFS_NAMEINDEX_SLOTS_PER_ENTRY)
+		len <<= 1;
+	printd("Allocating name index (%"PRIu32" slots)...\n", len);
+	shfs_vol.nindex = target_malloc(CACHELINE_SIZE, sizeof(*shfs_vol.nindex) * len);
+	if (!shfs_vol.nindex)
+		return -ENOMEM;
+	memset(shfs_vol.nindex, 0, sizeof(*shfs_vol.nindex) * len);
+	shfs_vol.nindex_mask = len - 1;
+
+#ifndef SHFS_HTABLE_LAZY
+	foreach_htable_el(shfs_vol.bt, el)
+		_nindex_add((struct shfs_bentry *) el->private);
+#endif /* otherwise, entries are added while the hash table is scanned */
+	return 0;
+}
+
+static inline struct shfs_bentry *_shfs_lookup_bentry_byname(const char *name,
+                                                             int nowait)
+{
+	register uint32_t i;
+	register uint32_t h;
+	struct shfs_bentry *bentry;
+	struct shfs_hentry *hentry;
+
+	if (strlen(name) > SHFS_NAMELEN)
+		goto notfound;
+	h = _nindex_hash(name);
+	for (i = h & shfs_vol.nindex_mask;
+	     (bentry = shfs_vol.nindex[i]) != NULL;
+	     i = (i + 1) & shfs_vol.nindex_mask) {
+		if (bentry->nhash != h)
+			continue;
+		hentry = nowait ? shfs_bentry_hentry_nowait(bentry) : shfs_bentry_hentry(bentry);
+		if (!hentry && errno == EAGAIN)
+			return NULL; /* candidate is being loaded */
+		if (hentry && strncmp(name, hentry->name, SHFS_NAMELEN) == 0)
+			return bentry;
+	}
+ notfound:
+	errno = ENOENT;
+	return NULL;
+}
+
+struct shfs_bentry *shfs_lookup_bentry_byname(const char *name)
+{
+	return _shfs_lookup_bentry_byname(name, 1);
+}
+#endif
+
+#ifdef SHFS_VARIANTS
+/**
+ * Links pre-encoded variants to the object with the same name
+ * Note: This is done at (re-)mount time only
+ */
+static void index_vol_variants(void)
+{
+	struct htable_el *el;
+	struct shfs_bentry *bentry;
+	struct shfs_bentry *obentry;
+	struct shfs_hentry *hentry;
+	char name[sizeof(((struct shfs_hentry *) 0)->name) + 1];
+
+	foreach_htable_el(shfs_vol.bt, el)
+		((struct shfs_bentry *) el->private)->vnext = NULL;
+
+	foreach_htable_el(shfs_vol.bt, el) {
+		bentry = el->private;
+#ifdef SHFS_HTABLE_LAZY
+		if (!bentry->isvariant)
+			continue;
+		hentry = shfs_bentry_hentry(bentry); /* loads its chunk */
+		if (!hentry)
+			continue;
+#else
+		hentry = bentry->hentry;
+		if (!SHFS_HENTRY_ISVARIANT(hentry))
+			continue;
+#endif
+
+		strncpy(name, hentry->name, sizeof(name) - 1);
+		name[sizeof(name) - 1] = '\0';
+		obentry = _shfs_lookup_bentry_byname(name, 0); /* name was compared: hentry is resident */
+		if (!obentry || SHFS_HENTRY_ISLINK(obentry->hentry)) {
+			printd("Variant '%s' does not have an object to belong to\n", name);
+			continue;
+		}
+		bentry->vnext = obentry->vnext;
+		obentry->vnext = bentry;
+	}
+}
+#endif
+
+/* feeds an entry of the hash table to the btable */
+static struct shfs_bentry *load_vol_bentry(uint64_t i, struct shfs_hentry *hentry)
+{
+	struct shfs_bentry *bentry;
+
+	bentry = shfs_btable_feed(shfs_vol.bt, i, hentry->hash);
+	bentry->hentry = hentry;
+	bentry->hentry_htchunk = SHFS_HTABLE_CHUNK_NO(i, shfs_vol.htable_nb_entries_per_chunk);
+#ifndef SHFS_BENTRY_COMPACT
+	bentry->hentry_htoffset = SHFS_HTABLE_ENTRY_OFFSET(i, shfs_vol.htable_nb_entries_per_chunk);
+#endif
+	bentry->refcount = 0;
+	bentry->update = 0;
+	bentry->pcookie = NULL;
+#ifdef __KERNEL__
+	bentry->ino = i + LINUX_FIRST_INO_N;
+#endif
+#ifndef SHFS_BENTRY_COMPACT
+	init_SEMAPHORE(&bentry->updatelock, 1);
+#endif
+#ifdef SHFS_STATS
+	memset(&bentry->hstats, 0, sizeof(bentry->hstats));
+#ifdef SHFS_PREFETCH
+	bentry->pf_h = 0;
+	bentry->pf_score = 0;
+#endif
+#endif
+#ifdef SHFS_NAMEINDEX
+	bentry->nhash = 0;
+#endif
+	if (SHFS_HENTRY_ISDEFAULT(hentry))
+		shfs_vol.def_bentry = bentry;
+	return bentry;
+}
+
 static int load_vol_htable(void)
 {
 	struct _load_vol_htable_aiot aiot;
 	SHFS_AIO_TOKEN *aioret;
 	struct shfs_hentry *hentry;
-	struct shfs_bentry *bentry;
 	void *chk_buf;
 	unsigned int i;
 	chk_t c;
@@ -482,7 +795,8 @@ static int load_vol_htable(void)
 	printd("Allocating btable...\n");
 	shfs_vol.bt = shfs_alloc_btable(shfs_vol.htable_nb_buckets,
 	                                shfs_vol.htable_nb_entries_per_bucket,
-	                                shfs_vol.hlen);
+	                                shfs_vol.hlen,
+	                                shfs_vol.htable_bucket_mode);
 	if (!shfs_vol.bt) {
 		ret = -ENOMEM;
 		goto err_free_chunkcache;
@@ -508,22 +822,16 @@ static int load_vol_htable(void)
 
 		hentry = (struct shfs_hentry *)((uint8_t *) chk_buf
                          + SHFS_HTABLE_ENTRY_OFFSET(i, shfs_vol.htable_nb_entries_per_chunk));
-		bentry = shfs_btable_feed(shfs_vol.bt, i, hentry->hash);
-		bentry->hentry = hentry;
-		bentry->hentry_htchunk = c;
-		bentry->hentry_htoffset = SHFS_HTABLE_ENTRY_OFFSET(i, shfs_vol.htable_nb_entries_per_chunk);
-		bentry->refcount = 0;
-		bentry->update = 0;
-#ifdef __KERNEL__
-		bentry->ino = i + LINUX_FIRST_INO_N;
+		load_vol_bentry(i, hentry);
+	}
+#ifdef SHFS_NAMEINDEX
+	ret = alloc_vol_nindex();
+	if (ret < 0)
+		goto err_free_btable;
 #endif
-		init_SEMAPHORE(&bentry->updatelock, 1);
-#ifdef SHFS_STATS
-		memset(&bentry->hstats, 0, sizeof(bentry->hstats));
+#ifdef SHFS_VARIANTS
+	index_vol_variants();
 #endif
-		if (SHFS_HENTRY_ISDEFAULT(hentry))
-			shfs_vol.def_bentry = bentry;
-	}
 
 	return 0;
 
@@ -547,6 +855,371 @@ static int load_vol_htable(void)
 	return ret;
 }
 
+#ifdef SHFS_HTABLE_LAZY
+/* FNV-1a (64-bit) checksum of a hash table chunk */
+static uint64_t _htchunk_csum(const void *chk_buf)
+{
+	register const uint8_t *p = chk_buf;
+	register uint64_t h = 14695981039346656037ull;
+	register uint32_t i;
+
+	for (i = 0; i < shfs_vol.chunksize; ++i) {
+		h ^= p[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+/* points the bucket entries of a chunk to the entries in chk_buf
+ * (NULL: chunk is not resident) */
+static void _htchunk_link(chk_t c, void *chk_buf)
+{
+	register uint64_t i;
+	uint64_t end;
+
+	i = c * shfs_vol.htable_nb_entries_per_chunk;
+	end = min(i + shfs_vol.htable_nb_entries_per_chunk,
+	          (uint64_t) shfs_vol.htable_nb_entries);
+	for (; i < end; ++i)
+		shfs_btable_pick(shfs_vol.bt, i)->hentry = chk_buf ?
+			(struct shfs_hentry *)((uint8_t *) chk_buf
+			 + SHFS_HTABLE_ENTRY_OFFSET(i, shfs_vol.htable_nb_entries_per_chunk)) : NULL;
+}
+
+/* drops the least recently used unpinned chunk and returns its buffer
+ * NULL is returned if all resident chunks are pinned */
+static void *_htchunk_evict(void)
+{
+	struct shfs_htchunk *hc;
+	void *chk_buf;
+	chk_t c;
+
+	hc = dlist_first_el(shfs_vol.htable_lru, struct shfs_htchunk);
+	if (!hc)
+		return NULL;
+	c = (chk_t) (hc - shfs_vol.htable_chunk_state);
+	printd("Evicting hash table chunk %"PRIchk"\n", c);
+	dlist_unlink(hc, shfs_vol.htable_lru, lru);
+	_htchunk_link(c, NULL);
+	chk_buf = shfs_vol.htable_chunk_cache[c];
+	shfs_vol.htable_chunk_cache[c] = NULL;
+	--shfs_vol.htable_nb_resident;
+	return chk_buf;
+}
+
+/* makes a chunk resident (chk_buf has to be allocated with target_malloc())
+ * Note: The chunk is linked to the LRU list as unpinned chunk */
+static void _htchunk_insert(chk_t c, void *chk_buf)
+{
+	shfs_vol.htable_chunk_cache[c] = chk_buf;
+	++shfs_vol.htable_nb_resident;
+	_htchunk_link(c, chk_buf);
+	dlist_append(&shfs_vol.htable_chunk_state[c], shfs_vol.htable_lru, lru);
+}
+
+/* makes a chunk resident that was read from the device
+ * chk_buf is released if the chunk does not match the btable */
+static int _htchunk_verify_insert(chk_t c, void *chk_buf)
+{
+	if (_htchunk_csum(chk_buf) != shfs_vol.htable_chunk_state[c].csum) {
+		/* the hash table was modified on the device,
+		 * bucket entries are updated with the next remount */
+		printd("Hash table chunk %"PRIchk" was modified: remount required\n", c);
+		target_free(chk_buf);
+		return -ESTALE;
+	}
+	_htchunk_insert(c, chk_buf);
+
+	/* loads that were in flight at the same time might exceed the limit */
+	while (shfs_vol.htable_nb_resident > SHFS_HTABLE_LAZY_NB_CHUNKS &&
+	       dlist_first_el(shfs_vol.htable_lru, struct shfs_htchunk) != &shfs_vol.htable_chunk_state[c] &&
+	       (chk_buf = _htchunk_evict()) != NULL)
+		target_free(chk_buf);
+	return 0;
+}
+
+/* completes the l-th chunk load (its I/O has to be done) */
+static int _htchunk_load_finalize(unsigned int l)
+{
+	chk_t c = shfs_vol.htable_load[l].c;
+	void *chk_buf = shfs_vol.htable_load[l].chk_buf;
+	int ret;
+
+	ret = shfs_aio_finalize(shfs_vol.htable_load[l].t);
+	shfs_vol.htable_load[l] = shfs_vol.htable_load[--shfs_vol.htable_nb_loads];
+	if (ret < 0) {
+		target_free(chk_buf);
+		return -EIO;
+	}
+	if (shfs_vol.htable_chunk_cache[c]) {
+		/* chunk got loaded meanwhile (e.g., by a remount) */
+		target_free(chk_buf);
+		return 0;
+	}
+	return _htchunk_verify_insert(c, chk_buf);
+}
+
+/* completes the chunk loads whose I/O is done */
+static void _htchunk_reap_loads(void)
+{
+	unsigned int l;
+
+	for (l = 0; l < shfs_vol.htable_nb_loads; ) {
+		if (!shfs_aio_is_done(shfs_vol.htable_load[l].t)) {
+			++l;
+			continue;
+		}
+		_htchunk_load_finalize(l); /* moves the last load to l */
+	}
+}
+
+/* waits for the chunk loads that are in flight and completes them
+ * Note: This function busy-waits for the I/O */
+static void _htchunk_wait_loads(void)
+{
+	while (shfs_vol.htable_nb_loads) {
+		shfs_aio_wait_nosched(shfs_vol.htable_load[0].t);
+		_htchunk_load_finalize(0);
+	}
+}
+
+/* loads a chunk from the device if it is not resident
+ * With nowait, the read is only issued and -EAGAIN is returned until it
+ * completed. Otherwise, this function busy-waits for the I/O */
+static int _htchunk_fault(chk_t c, int nowait)
+{
+	void *chk_buf = NULL;
+	SHFS_AIO_TOKEN *t;
+	unsigned int l;
+	int ret;
+
+	if (shfs_vol.htable_chunk_cache[c])
+		return 0;
+
+	/* load in flight? */
+	for (l = 0; l < shfs_vol.htable_nb_loads; ++l) {
+		if (shfs_vol.htable_load[l].c == c) {
+			if (!shfs_aio_is_done(shfs_vol.htable_load[l].t)) {
+				if (nowait)
+					return -EAGAIN;
+				shfs_aio_wait_nosched(shfs_vol.htable_load[l].t);
+			}
+			return _htchunk_load_finalize(l);
+		}
+	}
+	if (nowait) {
+		_htchunk_reap_loads(); /* frees slots of loads nobody waits for */
+		if (shfs_vol.htable_nb_loads == SHFS_HTABLE_LAZY_NB_LOADS)
+			return -EAGAIN;
+	}
+
+	printd("Loading hash table chunk %"PRIchk"...\n", c);
+	if (shfs_vol.htable_nb_resident + shfs_vol.htable_nb_loads >= SHFS_HTABLE_LAZY_NB_CHUNKS)
+		chk_buf = _htchunk_evict(); /* reuse buffer */
+	if (!chk_buf) {
+		chk_buf = target_malloc(shfs_vol.ioalign, shfs_vol.chunksize);
+		if (!chk_buf)
+			return -ENOMEM;
+	}
+	if (!nowait) {
+		ret = shfs_read_chunk_nosched(shfs_vol.htable_ref + c, 1, chk_buf);
+		if (ret < 0) {
+			ret = -EIO;
+			goto err_free_buf;
+		}
+		return _htchunk_verify_insert(c, chk_buf);
+	}
+
+	t = shfs_aread_chunk(shfs_vol.htable_ref + c, 1, chk_buf, NULL, NULL, NULL);
+	if (!t) {
+		ret = (errno == EAGAIN || errno == EBUSY) ? -EAGAIN : -EIO;
+		goto err_free_buf;
+	}
+	shfs_aio_submit();
+	l = shfs_vol.htable_nb_loads++;
+	shfs_vol.htable_load[l].c = c;
+	shfs_vol.htable_load[l].chk_buf = chk_buf;
+	shfs_vol.htable_load[l].t = t;
+	return -EAGAIN;
+
+ err_free_buf:
+	target_free(chk_buf);
+	return ret;
+}
+
+static inline void _htchunk_pin(chk_t c)
+{
+	if (shfs_vol.htable_chunk_state[c].refcount++ == 0)
+		dlist_unlink(&shfs_vol.htable_chunk_state[c], shfs_vol.htable_lru, lru);
+}
+
+static inline void _htchunk_unpin(chk_t c)
+{
+	void *chk_buf;
+
+	if (--shfs_vol.htable_chunk_state[c].refcount == 0) {
+		dlist_append(&shfs_vol.htable_chunk_state[c], shfs_vol.htable_lru, lru);
+
+		/* shrink back to the limit that was exceeded while chunks were pinned */
+		while (shfs_vol.htable_nb_resident > SHFS_HTABLE_LAZY_NB_CHUNKS &&
+		       (chk_buf = _htchunk_evict()) != NULL)
+			target_free(chk_buf);
+	}
+}
+
+static inline struct shfs_hentry *_shfs_bentry_hentry(struct shfs_bentry *bentry,
+                                                      int nowait)
+{
+	struct shfs_htchunk *hc = &shfs_vol.htable_chunk_state[bentry->hentry_htchunk];
+	int ret;
+
+	if (!bentry->hentry) {
+		ret = _htchunk_fault(bentry->hentry_htchunk, nowait);
+		if (ret < 0) {
+			errno = -ret;
+			return NULL;
+		}
+	} else if (hc->refcount == 0) {
+		dlist_relink_tail(hc, shfs_vol.htable_lru, lru);
+	}
+	return bentry->hentry;
+}
+
+struct shfs_hentry *shfs_bentry_hentry(struct shfs_bentry *bentry)
+{
+	return _shfs_bentry_hentry(bentry, 0);
+}
+
+struct shfs_hentry *shfs_bentry_hentry_nowait(struct shfs_bentry *bentry)
+{
+	return _shfs_bentry_hentry(bentry, 1);
+}
+
+int shfs_bentry_pin(struct shfs_bentry *bentry)
+{
+	int ret;
+
+	ret = _htchunk_fault(bentry->hentry_htchunk, 1);
+	if (ret < 0)
+		return ret;
+	_htchunk_pin(bentry->hentry_htchunk);
+	return 0;
+}
+
+void shfs_bentry_unpin(struct shfs_bentry *bentry)
+{
+	_htchunk_unpin(bentry->hentry_htchunk);
+}
+
+/* feeds the entries of a scanned hash table chunk to the btable
+ * The chunk stays resident as long as the limit is not reached */
+static void load_vol_htable_chunk(chk_t c, void *chk_buf)
+{
+	struct shfs_hentry *hentry;
+	struct shfs_bentry *bentry;
+	void *res_buf = NULL;
+	uint64_t i, end;
+
+	i = c * shfs_vol.htable_nb_entries_per_chunk;
+	end = min(i + shfs_vol.htable_nb_entries_per_chunk,
+	          (uint64_t) shfs_vol.htable_nb_entries);
+	for (; i < end; ++i) {
+		hentry = (struct shfs_hentry *)((uint8_t *) chk_buf
+		         + SHFS_HTABLE_ENTRY_OFFSET(i, shfs_vol.htable_nb_entries_per_chunk));
+		bentry = load_vol_bentry(i, hentry);
+#ifdef SHFS_VARIANTS
+		bentry->isvariant = SHFS_HENTRY_ISVARIANT(hentry);
+#endif
+#ifdef SHFS_NAMEINDEX
+		if (!hash_is_zero(hentry->hash, shfs_vol.hlen))
+			_nindex_add(bentry);
+#endif
+	}
+	shfs_vol.htable_chunk_state[c].csum = _htchunk_csum(chk_buf);
+
+	if (shfs_vol.htable_nb_resident < SHFS_HTABLE_LAZY_NB_CHUNKS)
+		res_buf = target_malloc(shfs_vol.ioalign, shfs_vol.chunksize);
+	if (res_buf) {
+		memcpy(res_buf, chk_buf, shfs_vol.chunksize);
+		_htchunk_insert(c, res_buf);
+	} else {
+		_htchunk_link(c, NULL);
+	}
+}
+
+/*
+ * Lazy variant of load_vol_htable(): The hash table is scanned once with
+ * parallel reads to fill the btable (and the name index) but only up to
+ * SHFS_HTABLE_LAZY_NB_CHUNKS chunks are kept in memory. Other chunks are
+ * loaded on first access.
+ * Note: requires the remount chunk buffers
+ */
+static int load_vol_htable_lazy(void)
+{
+	chk_t c;
+	int ret;
+
+	shfs_vol.htable_chunk_cache = target_malloc(CACHELINE_SIZE, sizeof(void *) * shfs_vol.htable_len);
+	if (!shfs_vol.htable_chunk_cache) {
+		ret = -ENOMEM;
+		goto err_out;
+	}
+	memset(shfs_vol.htable_chunk_cache, 0, sizeof(void *) * shfs_vol.htable_len);
+	shfs_vol.htable_chunk_state = target_malloc(CACHELINE_SIZE,
+	                                            sizeof(*shfs_vol.htable_chunk_state) * shfs_vol.htable_len);
+	if (!shfs_vol.htable_chunk_state) {
+		ret = -ENOMEM;
+		goto err_free_chunkcache;
+	}
+	memset(shfs_vol.htable_chunk_state, 0, sizeof(*shfs_vol.htable_chunk_state) * shfs_vol.htable_len);
+	dlist_init_head(shfs_vol.htable_lru);
+	shfs_vol.htable_nb_resident = 0;
+	shfs_vol.htable_nb_loads = 0;
+
+	printd("Allocating btable...\n");
+	shfs_vol.bt = shfs_alloc_btable(shfs_vol.htable_nb_buckets,
+	                                shfs_vol.htable_nb_entries_per_bucket,
+	                                shfs_vol.hlen,
+	                                shfs_vol.htable_bucket_mode);
+	if (!shfs_vol.bt) {
+		ret = -ENOMEM;
+		goto err_free_chunkstate;
+	}
+#ifdef SHFS_NAMEINDEX
+	ret = alloc_vol_nindex();
+	if (ret < 0)
+		goto err_free_btable;
+#endif
+
+	printd("Scanning hash table...\n");
+	shfs_vol.def_bentry = NULL;
+	ret = scan_vol_htable(load_vol_htable_chunk, "hash table scan");
+	if (ret < 0)
+		goto err_free_nindex;
+#ifdef SHFS_VARIANTS
+	index_vol_variants();
+#endif
+	return 0;
+
+ err_free_nindex:
+#ifdef SHFS_NAMEINDEX
+	target_free(shfs_vol.nindex);
+ err_free_btable:
+#endif
+	shfs_free_btable(shfs_vol.bt);
+ err_free_chunkstate:
+	target_free(shfs_vol.htable_chunk_state);
+ err_free_chunkcache:
+	for (c = 0; c < shfs_vol.htable_len; ++c) {
+		if (shfs_vol.htable_chunk_cache[c])
+			target_free(shfs_vol.htable_chunk_cache[c]);
+	}
+	target_free(shfs_vol.htable_chunk_cache);
+ err_out:
+	return ret;
+}
+#endif /* SHFS_HTABLE_LAZY */
+
 #ifndef __KERNEL__
 static void _aiotoken_pool_objinit(struct mempool_obj *, void *);
 #endif
@@ -584,6 +1257,9 @@ int mount_shfs(blkdev_id_t bd_id[], unsigned int count)
 	if (!shfs_vol.aiotoken_pool)
 		goto err_close_members;
 	shfs_mounted = 1; /* required by next function calls */
+#ifdef SHFS_BENTRY_COMPACT
+	init_SEMAPHORE(&shfs_vol.updatewait, 0);
+#endif
 
 	/* load hash conf (uses shfs_sync_read_chunk) */
 	printd("Loading volume configuration...\n");
@@ -591,24 +1267,31 @@ int mount_shfs(blkdev_id_t bd_id[], unsigned int count)
 	if (ret < 0)
 		goto err_free_aiotoken_pool;
 
+	printd("Allocating remount chunk buffers...\n");
+	shfs_vol.remount_chunk_buffer = target_malloc(shfs_vol.ioalign,
+	                                              SHFS_REMOUNT_NB_BUFFERS * shfs_vol.chunksize);
+	if (!shfs_vol.remount_chunk_buffer) {
+		ret = -ENOMEM;
+		goto err_free_aiotoken_pool;
+	}
+
 	/* load htable (uses shfs_sync_read_chunk)
 	 * This function also allocates htable_chunk_cache,
 	 * htable_chunk_cache_state and btable */
 	printd("Loading volume hash table...\n");
+#ifdef SHFS_HTABLE_LAZY
+	ret = load_vol_htable_lazy(); /* scans with the remount chunk buffers */
+#else
 	ret = load_vol_htable();
+#endif
 	if (ret < 0)
-		goto err_close_members;
-
-	printd("Allocating remount chunk buffer...\n");
-	shfs_vol.remount_chunk_buffer = target_malloc(shfs_vol.ioalign, shfs_vol.chunksize);
-	if (!shfs_vol.remount_chunk_buffer)
-		goto err_free_htable;
+		goto err_free_remount_buffer;
 
 	/* chunk buffer cache for I/O */
 	printd("Allocating chunk cache...\n");
 	ret = shfs_alloc_cache();
 	if (ret < 0)
-		goto err_free_remount_buffer;
+		goto err_free_htable;
 
 #ifdef SHFS_STATS
 	printd("Initializing statistics...\n");
@@ -622,6 +1305,11 @@ int mount_shfs(blkdev_id_t bd_id[], unsigned int count)
 #endif
 
 	shfs_nb_open = 0;
+#ifdef SHFS_CACHE_WARM
+	/* replay the cache snapshot (if there is one for this volume) */
+	shfs_warm_load();
+	shfs_warm_start();
+#endif
 	up(&shfs_mount_lock);
 	printd("SHFS volume mounted\n");
 	return 0;
@@ -630,15 +1318,21 @@ int mount_shfs(blkdev_id_t bd_id[], unsigned int count)
 	goto  err_free_chunkcache;
  err_free_chunkcache:
 	shfs_free_cache();
- err_free_remount_buffer:
-	target_free(shfs_vol.remount_chunk_buffer);
  err_free_htable:
+#ifdef SHFS_NAMEINDEX
+	target_free(shfs_vol.nindex);
+#endif
 	for (i = 0; i < shfs_vol.htable_len; ++i) {
 		if (shfs_vol.htable_chunk_cache[i])
 			target_free(shfs_vol.htable_chunk_cache[i]);
 	}
 	target_free(shfs_vol.htable_chunk_cache);
+#ifdef SHFS_HTABLE_LAZY
+	target_free(shfs_vol.htable_chunk_state);
+#endif
 	shfs_free_btable(shfs_vol.bt);
+ err_free_remount_buffer:
+	target_free(shfs_vol.remount_chunk_buffer);
  err_free_aiotoken_pool:
 	free_mempool(shfs_vol.aiotoken_pool);
  err_close_members:
@@ -650,6 +1344,43 @@ int mount_shfs(blkdev_id_t bd_id[], unsigned int count)
 	return ret;
 }
 
+/*
+ * Forbids further opens of an entry and waits until it is closed
+ */
+static inline void _shfs_lock_bentry(struct shfs_bentry *bentry)
+{
+	bentry->update = 1; /* forbid further open() */
+#ifdef SHFS_BENTRY_COMPACT
+	while (bentry->refcount)
+		down(&shfs_vol.updatewait); /* woken up by shfs_fio_close() */
+#else
+	down(&bentry->updatelock); /* wait until file is closed */
+#endif
+}
+
+static inline void _shfs_unlock_bentry(struct shfs_bentry *bentry)
+{
+#ifndef SHFS_BENTRY_COMPACT
+	up(&bentry->updatelock);
+#endif
+	bentry->update = 0;
+}
+
+/*
+ * Releases the persistent cookie of an entry
+ * Note: The entry has to be locked or unused
+ */
+static inline void _shfs_release_pcookie(struct shfs_bentry *bentry)
+{
+	if (bentry->pcookie) {
+		if (shfs_pcookie_release)
+			shfs_pcookie_release(bentry->pcookie);
+		else
+			target_free(bentry->pcookie);
+		bentry->pcookie = NULL;
+	}
+}
+
 /**
  * Unmounts a previously mounted SHFS volume
  * Note: Because semaphores are used to sync with opened files,
@@ -657,16 +1388,24 @@ int mount_shfs(blkdev_id_t bd_id[], unsigned int count)
  *  from a context that is different from the one of the main loop
  */
 int umount_shfs(int force) {
+	struct htable_el *el;
 	unsigned int i;
 
 	down(&shfs_mount_lock);
 	if (shfs_mounted) {
 #ifndef __KERNEL__
+#ifdef SHFS_PREFETCH
+		shfs_prefetch_stop(); /* releases buffers and btable references */
+#endif
+#ifdef SHFS_CACHE_WARM
+		shfs_warm_stop(); /* releases the buffers of the replay */
+#endif
+#ifdef SHFS_HTABLE_LAZY
+		_htchunk_reap_loads(); /* releases the tokens of completed loads */
+#endif
 		if (shfs_nb_open ||
 		    mempool_free_count(shfs_vol.aiotoken_pool) < MAX_REQUESTS ||
 		    shfs_cache_ref_count()) {
-			struct htable_el *el;
-
 			/* there are still open files and/or async I/O is happening */
 			printd("Could not umount: SHFS is busy:\n");
 			printd(" Open files:               %u\n",
@@ -682,22 +1421,33 @@ int umount_shfs(int force) {
 			}
 
 			/* lock entries */
-			foreach_htable_el(shfs_vol.bt, el) {
-				struct shfs_bentry *bentry = el->private;
-				bentry->update = 1; /* forbid further open() */
-				down(&bentry->updatelock); /* wait until file is closed */
-			}
+			foreach_htable_el(shfs_vol.bt, el)
+				_shfs_lock_bentry((struct shfs_bentry *) el->private);
 		}
+#ifdef SHFS_CACHE_WARM
+		shfs_warm_save(); /* snapshot of the cache before it is freed */
+#endif
+#ifdef SHFS_HTABLE_LAZY
+		_htchunk_wait_loads();
+#endif
 		shfs_free_cache();
 #endif
 
 		shfs_mounted = 0;
+		foreach_htable_el(shfs_vol.bt, el)
+			_shfs_release_pcookie((struct shfs_bentry *) el->private);
 		target_free(shfs_vol.remount_chunk_buffer);
+#ifdef SHFS_NAMEINDEX
+		target_free(shfs_vol.nindex);
+#endif
 		for (i = 0; i < shfs_vol.htable_len; ++i) {
 			if (shfs_vol.htable_chunk_cache[i])
 				target_free(shfs_vol.htable_chunk_cache[i]);
 		}
 		target_free(shfs_vol.htable_chunk_cache);
+#ifdef SHFS_HTABLE_LAZY
+		target_free(shfs_vol.htable_chunk_state);
+#endif
 		shfs_free_btable(shfs_vol.bt);
 		free_mempool(shfs_vol.aiotoken_pool);
 		for(i = 0; i < shfs_vol.nb_members; ++i)
@@ -711,134 +1461,272 @@ int umount_shfs(int force) {
 	return 0;
 }
 
+/* drops the cached chunks of an object so that they get re-read from the device
+ * Note: links and empty entries do not have any chunks on the volume */
+static inline void _shfs_invalidate_hentry(struct shfs_hentry *hentry)
+{
+	if (hash_is_zero(hentry->hash, shfs_vol.hlen) ||
+	    SHFS_HENTRY_ISLINK(hentry))
+		return;
+
+	shfs_cache_invalidate(hentry->f_attr.chunk,
+	                      hentry->f_attr.chunk
+	                      + DIV_ROUND_UP(hentry->f_attr.offset + hentry->f_attr.len,
+	                                     shfs_vol.chunksize));
+}
+
 /**
- * This function re-reads the hash table from the device
- * Since semaphores are used to sync with opened files,
- *  this function has to be called from a context that
- *  is different from the one of the main loop
+ * Compares a re-read hash table chunk with the loaded one
+ * and applies the modified entries
  */
-static int reload_vol_htable(void) {
 #ifdef SHFS_STATS
+/*
+ * Moves the stats of a replaced object to the miss table
+ * or loads the stats of a new object from it
+ */
+static void _shfs_reload_stats(struct shfs_bentry *bentry, hash512_t chash,
+                               int chash_is_zero, hash512_t nhash)
+{
 	struct shfs_el_stats *el_stats;
+
+	if (!chash_is_zero) {
+		/* move current stats to miss table */
+		el_stats = shfs_stats_from_mstats(chash);
+		if (likely(el_stats != NULL))
+			memcpy(el_stats, &bentry->hstats, sizeof(*el_stats));
+
+		/* reset stats of element */
+		memset(&bentry->hstats, 0, sizeof(*el_stats));
+	} else {
+		/* load stats from miss table */
+		el_stats = shfs_stats_from_mstats(nhash);
+		if (likely(el_stats != NULL))
+			memcpy(&bentry->hstats, el_stats, sizeof(*el_stats));
+		else
+			memset(&bentry->hstats, 0, sizeof(*el_stats));
+
+		/* delete entry from miss stats */
+		shfs_stats_mstats_drop(nhash);
+	}
+#ifdef SHFS_PREFETCH
+	/* popularity does not carry over to the new object */
+	bentry->pf_h = bentry->hstats.h;
+	bentry->pf_score = 0;
+#endif
+}
 #endif
+
+#ifdef SHFS_HTABLE_LAZY
+/*
+ * Reloads a hash table chunk that is not resident:
+ * Since the previous entries are unknown, every non-empty entry
+ * is handled as updated. Only the hash digests of the btable tell
+ * if the stats have to be moved.
+ * Note: No entry of this chunk can be opened because
+ *  opened entries pin their chunk
+ */
+static void reload_vol_htable_chunk_lazy(chk_t c, void *nchk_buf)
+{
 	struct shfs_bentry *bentry;
-	struct shfs_hentry *chentry;
 	struct shfs_hentry *nhentry;
-	void *cchk_buf;
-	void *nchk_buf = shfs_vol.remount_chunk_buffer;
+	struct htable_el *el;
+	hash512_t chash;
 	int chash_is_zero, nhash_is_zero;
-	register chk_t c;
 	register unsigned int e;
-	int ret = 0;
 
-	printd("Re-reading hash table...\n");
-	for (c = 0; c < shfs_vol.htable_len; ++c) {
-		/* read chunk from disk */
-		ret = shfs_read_chunk(shfs_vol.htable_ref + c, 1, nchk_buf); /* calls schedule() */
-		if (ret < 0) {
-			ret = -EIO;
-			goto out;
-		}
-		cchk_buf = shfs_vol.htable_chunk_cache[c];
-
-		/* compare entries */
-		for (e = 0; e < shfs_vol.htable_nb_entries_per_chunk; ++e) {
-			chentry = (struct shfs_hentry *)((uint8_t *) cchk_buf
-			          + SHFS_HTABLE_ENTRY_OFFSET(e, shfs_vol.htable_nb_entries_per_chunk));
-			nhentry = (struct shfs_hentry *)((uint8_t *) nchk_buf
-			          + SHFS_HTABLE_ENTRY_OFFSET(e, shfs_vol.htable_nb_entries_per_chunk));
-			if (hash_compare(chentry->hash, nhentry->hash, shfs_vol.hlen)) {
-				chash_is_zero = hash_is_zero(chentry->hash, shfs_vol.hlen);
-				nhash_is_zero = hash_is_zero(nhentry->hash, shfs_vol.hlen);
-
-				if (!chash_is_zero || !nhash_is_zero) { /* process only if at least one hash
-				                                         * digest is non-zero */
-					printd("Chunk %"PRIchk", entry %u has been updated\n", c ,e);
-					/* Update hash of entry
-					 * Note: Any open file should not be affected, because
-					 *  there is no hash table lookup needed again
-					 *  The meta data is updated after all handles were closed
-					 * Note: Since we lock the file in the next step, 
-					 *  upcoming open of this entry will only be successful
-					 *  when the update has been finished */
-					bentry = shfs_btable_feed(shfs_vol.bt,
-					          (c * shfs_vol.htable_nb_entries_per_chunk) + e,
-					          nhentry->hash);
-					/* lock entry */
-					bentry->update = 1; /* forbid further open() */
-					down(&bentry->updatelock); /* wait until files is closed */
+	for (e = 0; e < shfs_vol.htable_nb_entries_per_chunk; ++e) {
+		nhentry = (struct shfs_hentry *)((uint8_t *) nchk_buf
+		          + SHFS_HTABLE_ENTRY_OFFSET(e, shfs_vol.htable_nb_entries_per_chunk));
+		el = shfs_btable_pick_el(shfs_vol.bt,
+		                         (c * shfs_vol.htable_nb_entries_per_chunk) + e);
+		chash_is_zero = hash_is_zero(*el->h, shfs_vol.hlen);
+		nhash_is_zero = hash_is_zero(nhentry->hash, shfs_vol.hlen);
+		if (chash_is_zero && nhash_is_zero)
+			continue;
+		hash_copy(chash, *el->h, shfs_vol.hlen);
+
+		bentry = shfs_btable_feed(shfs_vol.bt,
+		                          (c * shfs_vol.htable_nb_entries_per_chunk) + e,
+		                          nhentry->hash);
+		_shfs_lock_bentry(bentry);
 
 #ifdef SHFS_STATS
-					if (!chash_is_zero) {
-						/* move current stats to miss table */
-						el_stats = shfs_stats_from_mstats(chentry->hash);
-						if (likely(el_stats != NULL))
-							memcpy(el_stats, &bentry->hstats, sizeof(*el_stats));
-
-						/* reset stats of element */
-						memset(&bentry->hstats, 0, sizeof(*el_stats));
-		       			} else {
-						/* load stats from miss table */
-						el_stats = shfs_stats_from_mstats(nhentry->hash);
-						if (likely(el_stats != NULL))
-							memcpy(&bentry->hstats, el_stats, sizeof(*el_stats));
-						else
-							memset(&bentry->hstats, 0, sizeof(*el_stats));
-
-						/* delete entry from miss stats */
-						shfs_stats_mstats_drop(nhentry->hash);
-					}
-#endif
-					memcpy(chentry, nhentry, sizeof(*chentry));
-
-					shfs_flush_cache();
-
-					/* unlock entry */
-					up(&bentry->updatelock);
-					bentry->update = 0;
-
-					/* update default entry reference */
- 					if (shfs_vol.def_bentry == bentry &&
-					    !SHFS_HENTRY_ISDEFAULT(nhentry))
-						shfs_vol.def_bentry = NULL;
-					else if (SHFS_HENTRY_ISDEFAULT(nhentry))
-						shfs_vol.def_bentry = bentry;
-				}
-			} else {
-				/* in this case, at most the file location has been moved
-				 * or the contents has been changed
-				 *
-				 * Note: This is usually a bad thing but happens
-				 * if the tools were misused
-				 * Note: Since the hash digest did not change,
-				 * the stats keep the same */
-				bentry = shfs_btable_feed(shfs_vol.bt,
-				                          (c * shfs_vol.htable_nb_entries_per_chunk) + e,
-				                          nhentry->hash);
+		if (hash_compare(chash, nhentry->hash, shfs_vol.hlen))
+			_shfs_reload_stats(bentry, chash, chash_is_zero,
+			                   nhentry->hash);
+#endif
+#ifdef SHFS_NAMEINDEX
+		_nindex_rm(bentry);
+#endif
+		/* the old location is unknown: ensure re-reading from the new one */
+		_shfs_invalidate_hentry(nhentry);
+		bentry->hentry = nhentry; /* until the chunk is unlinked below */
+#ifdef SHFS_VARIANTS
+		bentry->isvariant = SHFS_HENTRY_ISVARIANT(nhentry);
+#endif
+#ifdef SHFS_NAMEINDEX
+		if (!nhash_is_zero)
+			_nindex_add(bentry);
+#endif
+		_shfs_release_pcookie(bentry);
 
-				/* lock entry */
-				bentry->update = 1; /* forbid further open() */
-				down(&bentry->updatelock); /* wait until this file is closed */
+		_shfs_unlock_bentry(bentry);
 
-				memcpy(chentry, nhentry, sizeof(*chentry));
+		/* update default entry reference */
+		if (shfs_vol.def_bentry == bentry &&
+		    !SHFS_HENTRY_ISDEFAULT(nhentry))
+			shfs_vol.def_bentry = NULL;
+		else if (SHFS_HENTRY_ISDEFAULT(nhentry))
+			shfs_vol.def_bentry = bentry;
+	}
+	_htchunk_link(c, NULL);
+}
+#endif
+
+static void reload_vol_htable_chunk(chk_t c, void *nchk_buf)
+{
+	struct shfs_bentry *bentry;
+	struct shfs_hentry *chentry;
+	struct shfs_hentry *nhentry;
+	void *cchk_buf;
+	int chash_is_zero, nhash_is_zero;
+	register unsigned int e;
+#ifdef SHFS_HTABLE_LAZY
+	uint64_t csum;
+
+	csum = _htchunk_csum(nchk_buf);
+	if (csum == shfs_vol.htable_chunk_state[c].csum)
+		return; /* no entry of this chunk was modified */
+	if (!shfs_vol.htable_chunk_cache[c]) {
+		reload_vol_htable_chunk_lazy(c, nchk_buf);
+		shfs_vol.htable_chunk_state[c].csum = csum;
+		return;
+	}
+	_htchunk_pin(c); /* keep it resident while we wait for closing files */
+	cchk_buf = shfs_vol.htable_chunk_cache[c];
+#else
+	cchk_buf = shfs_vol.htable_chunk_cache[c];
+	if (memcmp(cchk_buf, nchk_buf, shfs_vol.chunksize) == 0)
+		return; /* no entry of this chunk was modified */
+#endif
 
-				shfs_flush_cache(); /* to ensure re-reading this file */
+	/* compare entries */
+	for (e = 0; e < shfs_vol.htable_nb_entries_per_chunk; ++e) {
+		chentry = (struct shfs_hentry *)((uint8_t *) cchk_buf
+		          + SHFS_HTABLE_ENTRY_OFFSET(e, shfs_vol.htable_nb_entries_per_chunk));
+		nhentry = (struct shfs_hentry *)((uint8_t *) nchk_buf
+		          + SHFS_HTABLE_ENTRY_OFFSET(e, shfs_vol.htable_nb_entries_per_chunk));
+		if (hash_compare(chentry->hash, nhentry->hash, shfs_vol.hlen)) {
+			chash_is_zero = hash_is_zero(chentry->hash, shfs_vol.hlen);
+			nhash_is_zero = hash_is_zero(nhentry->hash, shfs_vol.hlen);
+
+			if (!chash_is_zero || !nhash_is_zero) { /* process only if at least one hash
+			                                         * digest is non-zero */
+				printd("Chunk %"PRIchk", entry %u has been updated\n", c ,e);
+				/* Update hash of entry
+				 * Note: Any open file should not be affected, because
+				 *  there is no hash table lookup needed again
+				 *  The meta data is updated after all handles were closed
+				 * Note: Since we lock the file in the next step, 
+				 *  upcoming open of this entry will only be successful
+				 *  when the update has been finished */
+				bentry = shfs_btable_feed(shfs_vol.bt,
+				          (c * shfs_vol.htable_nb_entries_per_chunk) + e,
+				          nhentry->hash);
+				_shfs_lock_bentry(bentry);
+
+#ifdef SHFS_STATS
+				_shfs_reload_stats(bentry, chentry->hash, chash_is_zero,
+				                   nhentry->hash);
+#endif
+#ifdef SHFS_NAMEINDEX
+				_nindex_rm(bentry);
+#endif
+				/* the new object might occupy chunks of a removed one */
+				_shfs_invalidate_hentry(chentry);
+				_shfs_invalidate_hentry(nhentry);
+				memcpy(chentry, nhentry, sizeof(*chentry));
+#if defined SHFS_HTABLE_LAZY && defined SHFS_VARIANTS
+				bentry->isvariant = SHFS_HENTRY_ISVARIANT(chentry);
+#endif
+#ifdef SHFS_NAMEINDEX
+				if (!nhash_is_zero)
+					_nindex_add(bentry);
+#endif
+				_shfs_release_pcookie(bentry);
 
-				/* unlock entry */
-				up(&bentry->updatelock);
-				bentry->update = 0;
+				_shfs_unlock_bentry(bentry);
 
 				/* update default entry reference */
-				if (shfs_vol.def_bentry == bentry &&
+ 					if (shfs_vol.def_bentry == bentry &&
 				    !SHFS_HENTRY_ISDEFAULT(nhentry))
 					shfs_vol.def_bentry = NULL;
 				else if (SHFS_HENTRY_ISDEFAULT(nhentry))
 					shfs_vol.def_bentry = bentry;
 			}
+		} else {
+			/* in this case, at most the file location has been moved
+			 * or the contents has been changed
+			 *
+			 * Note: This is usually a bad thing but happens
+			 * if the tools were misused
+			 * Note: Since the hash digest did not change,
+			 * the stats keep the same */
+			if (memcmp(chentry, nhentry, sizeof(*chentry)) == 0)
+				continue; /* entry is unchanged */
+
+			bentry = shfs_btable_feed(shfs_vol.bt,
+			                          (c * shfs_vol.htable_nb_entries_per_chunk) + e,
+			                          nhentry->hash);
+
+			_shfs_lock_bentry(bentry);
+
+#ifdef SHFS_NAMEINDEX
+			_nindex_rm(bentry);
+#endif
+			/* ensure re-reading this file from its old and new location */
+			_shfs_invalidate_hentry(chentry);
+			_shfs_invalidate_hentry(nhentry);
+			memcpy(chentry, nhentry, sizeof(*chentry));
+#if defined SHFS_HTABLE_LAZY && defined SHFS_VARIANTS
+			bentry->isvariant = SHFS_HENTRY_ISVARIANT(chentry);
+#endif
+#ifdef SHFS_NAMEINDEX
+			if (!hash_is_zero(nhentry->hash, shfs_vol.hlen))
+				_nindex_add(bentry);
+#endif
+			_shfs_release_pcookie(bentry);
+
+			_shfs_unlock_bentry(bentry);
+
+			/* update default entry reference */
+			if (shfs_vol.def_bentry == bentry &&
+			    !SHFS_HENTRY_ISDEFAULT(nhentry))
+				shfs_vol.def_bentry = NULL;
+			else if (SHFS_HENTRY_ISDEFAULT(nhentry))
+				shfs_vol.def_bentry = bentry;
 		}
 	}
+#ifdef SHFS_HTABLE_LAZY
+	shfs_vol.htable_chunk_state[c].csum = csum;
+	_htchunk_unpin(c);
+#endif
+}
 
- out:
+/**
+ * This function re-reads the hash table from the device
+ * Since semaphores are used to sync with opened files,
+ *  this function has to be called from a context that
+ *  is different from the one of the main loop
+ */
+static int reload_vol_htable(void) {
+	int ret;
+
+	printd("Re-reading hash table...\n");
+	ret = scan_vol_htable(reload_vol_htable_chunk, "hash table reload");
+#ifdef SHFS_VARIANTS
+	index_vol_variants(); /* names or encodings might have changed */
+#endif
 	return ret;
 }
 
@@ -859,7 +1747,22 @@ int remount_shfs(void) {
 
 	/* TODO: Re-read chunk0 and check if volume UUID still matches */
 
+	/* buffers referenced by the replay and the prefetcher
+	 * would not be flushed on updates. reload_vol_htable() yields the
+	 * CPU: the prefetcher must not start a new pass meanwhile */
+#ifdef SHFS_PREFETCH
+	shfs_prefetch_suspend();
+#endif
+#ifdef SHFS_CACHE_WARM
+	shfs_warm_save(); /* stops the replay */
+#endif
 	ret = reload_vol_htable();
+#ifdef SHFS_CACHE_WARM
+	shfs_warm_start();
+#endif
+#ifdef SHFS_PREFETCH
+	shfs_prefetch_resume();
+#endif
  out:
 	up(&shfs_mount_lock);
 	return ret;
@@ -979,3 +1882,122 @@ SHFS_AIO_TOKEN *shfs_aio_chunk(chk_t start, chk_t len, int write, void *buffer,
  err_out:
 	return NULL;
 }
+
+#ifdef BLKDEV_CAN_IOV
+#define SHFS_AIO_MAX_IOV BLKDEV_MAX_IOV
+#else
+#define SHFS_AIO_MAX_IOV 1
+#endif
+
+SHFS_AIO_TOKEN *shfs_aio_chunkv(chk_t start, chk_t len, int write, void **buffers,
+                                shfs_aiocb_t *cb, void *cb_cookie, void *cb_argp)
+{
+	int ret;
+	uint64_t num_req_per_member;
+	sector_t start_sec;
+	unsigned int m, spc;
+	SHFS_AIO_TOKEN *t;
+	strp_t start_s;
+	strp_t end_s;
+	strp_t strp, k;
+#ifdef BLKDEV_CAN_IOV
+	struct iovec iov[SHFS_AIO_MAX_IOV];
+#else
+	void *ptr;
+#endif
+	unsigned int iovcnt;
+
+	if (!shfs_mounted) {
+		errno = ENODEV;
+		goto err_out;
+	}
+
+	switch (shfs_vol.stripemode) {
+	case SHFS_SM_COMBINED:
+		start_s = (strp_t) start * (strp_t) shfs_vol.nb_members;
+		end_s = (strp_t) (start + len) * (strp_t) shfs_vol.nb_members;
+		spc = shfs_vol.nb_members; /* stripes per chunk */
+		break;
+	case SHFS_SM_INDEPENDENT:
+	default:
+		start_s = (strp_t) start + (strp_t) (shfs_vol.nb_members - 1);
+		end_s = (strp_t) (start_s + len);
+		spc = 1;
+		break;
+	}
+	num_req_per_member = DIV_ROUND_UP(DIV_ROUND_UP(end_s - start_s, shfs_vol.nb_members),
+	                                  SHFS_AIO_MAX_IOV);
+
+	/* check if each member has enough request objects available for this operation */
+	for (m = 0; m < shfs_vol.nb_members; ++m) {
+		if (blkdev_avail_req(shfs_vol.member[m].bd) < num_req_per_member) {
+			errno = EAGAIN;
+			goto err_out;
+		}
+	}
+
+	/* pick token */
+	t = shfs_aio_pick_token();
+	if (!t) {
+		errno = EAGAIN;
+		goto err_out;
+	}
+	t->cb = cb;
+	t->cb_argp = cb_argp;
+	t->cb_cookie = cb_cookie;
+
+	/* setup requests: stripes of a member are contiguous on its device
+	 * (every nb_members-th stripe), so they can be merged into one request */
+	for (k = 0; k < shfs_vol.nb_members && start_s + k < end_s; ++k) {
+		m = (start_s + k) % shfs_vol.nb_members;
+		iovcnt = 0;
+		start_sec = 0;
+
+		for (strp = start_s + k; strp < end_s; strp += shfs_vol.nb_members) {
+			if (iovcnt == 0)
+				start_sec = (strp / shfs_vol.nb_members) * shfs_vol.member[m].sfactor;
+#ifdef BLKDEV_CAN_IOV
+			iov[iovcnt].iov_base = (uint8_t *) buffers[(strp - start_s) / spc]
+			                       + ((strp - start_s) % spc) * shfs_vol.stripesize;
+			iov[iovcnt].iov_len  = shfs_vol.stripesize;
+#else
+			ptr = (uint8_t *) buffers[(strp - start_s) / spc]
+			      + ((strp - start_s) % spc) * shfs_vol.stripesize;
+#endif
+			++iovcnt;
+			if (iovcnt < SHFS_AIO_MAX_IOV &&
+			    strp + shfs_vol.nb_members < end_s)
+				continue; /* merge next stripe of this member */
+
+			printd("Request: member=%u, start=%"PRIsctr"s, len=%"PRIsctr"s, segments=%u\n",
+			       m, start_sec, shfs_vol.member[m].sfactor * iovcnt, iovcnt);
+#ifdef BLKDEV_CAN_IOV
+			if (iovcnt == 1)
+				ret = blkdev_async_io(shfs_vol.member[m].bd, start_sec, shfs_vol.member[m].sfactor,
+				                      write, iov[0].iov_base, _shfs_aio_cb, t);
+			else
+				ret = blkdev_async_iov(shfs_vol.member[m].bd, start_sec, iov, iovcnt,
+				                       write, _shfs_aio_cb, t);
+#else
+			ret = blkdev_async_io(shfs_vol.member[m].bd, start_sec, shfs_vol.member[m].sfactor,
+			                      write, ptr, _shfs_aio_cb, t);
+#endif
+			if (unlikely(ret < 0)) {
+				t->cb = NULL; /* erase callback */
+				printd("Error while setting up async I/O request for member %u: %d. "
+				       "Cancelling request...\n", m, ret);
+				shfs_aio_wait(t);
+				errno = -ret;
+				goto err_free_token;
+			}
+			++t->infly;
+			iovcnt = 0;
+		}
+	}
+	return t;
+
+ err_free_token:
+	shfs_aio_put_token(t);
+ err_out:
+	return NULL;
+}
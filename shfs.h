@@ -80,10 +80,48 @@ struct vol_member {
 	sector_t sfactor;
 };
 
+/* name index for open-by-name (not available to the kernel module) */
+#if defined SHFS_OPENBYNAME && !defined __KERNEL__
+#define SHFS_NAMEINDEX
+#endif
+#ifndef SHFS_NAMEINDEX_SLOTS_PER_ENTRY
+#define SHFS_NAMEINDEX_SLOTS_PER_ENTRY 2 /* limits the load factor of the name index */
+#endif
+
+#ifndef SHFS_REMOUNT_NB_BUFFERS
+#define SHFS_REMOUNT_NB_BUFFERS 8 /* hash table chunks that are re-read in parallel on remount */
+#endif
+
+#ifdef SHFS_HTABLE_LAZY
+#include "dlist.h"
+
+#ifndef SHFS_HTABLE_LAZY_NB_CHUNKS
+#define SHFS_HTABLE_LAZY_NB_CHUNKS 1024 /* max. number of resident hash table chunks */
+#endif
+#ifndef SHFS_HTABLE_LAZY_NB_LOADS
+#define SHFS_HTABLE_LAZY_NB_LOADS 8 /* max. number of chunk loads in flight */
+#endif
+
+/* state of a hash table chunk when the table is loaded on demand */
+struct shfs_htchunk {
+	uint32_t refcount; /* opened objects pin the chunk */
+	uint64_t csum; /* checksum of the contents the btable was built from */
+	dlist_el(lru); /* resident and unpinned chunks */
+};
+
+/* chunk load that was issued without waiting for it */
+struct shfs_htload {
+	chk_t c;
+	void *chk_buf;
+	struct _shfs_aio_token *t;
+};
+#endif
+
 struct vol_info {
 	uuid_t uuid;
 	char volname[17];
 	uint64_t ts_creation;
+	uint8_t minor; /* minor version of the volume format */
 	uint32_t chunksize;
 	chk_t volsize;
 
@@ -98,7 +136,14 @@ struct vol_info {
 
 	struct htable *bt; /* SHFS bucket entry table */
 	void **htable_chunk_cache;
-	void *remount_chunk_buffer;
+	void *remount_chunk_buffer; /* SHFS_REMOUNT_NB_BUFFERS chunks */
+#ifdef SHFS_HTABLE_LAZY
+	struct shfs_htchunk *htable_chunk_state;
+	dlist_head(htable_lru);
+	chk_t htable_nb_resident;
+	struct shfs_htload htable_load[SHFS_HTABLE_LAZY_NB_LOADS];
+	unsigned int htable_nb_loads;
+#endif
 	chk_t htable_ref;
 	chk_t htable_bak_ref;
 	chk_t htable_len;
@@ -106,9 +151,17 @@ struct vol_info {
 	uint32_t htable_nb_entries;
 	uint32_t htable_nb_entries_per_bucket;
 	uint32_t htable_nb_entries_per_chunk;
+	uint8_t htable_bucket_mode;
 	uint8_t hlen;
 
 	struct shfs_bentry *def_bentry;
+#ifdef SHFS_BENTRY_COMPACT
+	sem_t updatewait; /* entry updates wait here for the last close */
+#endif
+#ifdef SHFS_NAMEINDEX
+	struct shfs_bentry **nindex; /* open addressing index (linear probing): name -> bentry */
+	uint32_t nindex_mask;
+#endif
 
 	struct mempool *aiotoken_pool; /* token for async I/O */
 	struct shfs_cache *chunkcache; /* chunkcache */
@@ -122,6 +175,7 @@ extern struct vol_info shfs_vol;
 extern sem_t shfs_mount_lock;
 extern int shfs_mounted;
 extern unsigned int shfs_nb_open;
+extern void (*shfs_pcookie_release)(void *pcookie); /* see: shfs_fio_set_pcookie() */
 
 int init_shfs(void);
 int mount_shfs(blkdev_id_t bd_id[], unsigned int count);
@@ -129,9 +183,71 @@ int remount_shfs(void);
 int umount_shfs(int force);
 void exit_shfs(void);
 
+#ifdef SHFS_NAMEINDEX
+/*
+ * Looks up an object by its name with the name index
+ * Note: Pre-encoded variants share the name of their object and are
+ *  not part of the index
+ * Returns NULL and sets errno to ENOENT when the name is not found or to
+ * EAGAIN while the hash table chunk of a candidate is loaded (lazy hash
+ * table): the lookup has to be retried later
+ */
+struct shfs_bentry *shfs_lookup_bentry_byname(const char *name);
+#endif
+
+#ifdef SHFS_HTABLE_LAZY
+/*
+ * Hash table chunks are loaded on demand: the hentry of a bucket entry
+ * is only resident while its chunk is
+ * shfs_bentry_hentry() loads the chunk if required (busy-waits for the
+ * I/O) and returns NULL on errors. It is meant for mount time and tools.
+ * shfs_bentry_hentry_nowait() and shfs_bentry_pin() only issue the load
+ * and fail with EAGAIN until it completed. The reference stays valid until
+ * the next call, unless the entry is pinned. Opened objects are pinned.
+ */
+struct shfs_hentry *shfs_bentry_hentry(struct shfs_bentry *bentry);
+struct shfs_hentry *shfs_bentry_hentry_nowait(struct shfs_bentry *bentry);
+int shfs_bentry_pin(struct shfs_bentry *bentry);
+void shfs_bentry_unpin(struct shfs_bentry *bentry);
+#else
+#define shfs_bentry_hentry(bentry) ((bentry)->hentry)
+#define shfs_bentry_hentry_nowait(bentry) ((bentry)->hentry)
+#define shfs_bentry_pin(bentry) (0)
+#define shfs_bentry_unpin(bentry) do {} while (0)
+#endif
+
 #define shfs_blkdevs_count() \
 	((shfs_mounted) ? shfs_vol.nb_members : 0)
 
+/*
+ * Locates a byte of a volume chunk on the volume members (same striping as
+ * shfs_aio_chunk()): *m returns the member and *off the byte offset on it.
+ * The number of bytes that follow contiguously on this member (until the
+ * end of the stripe) is returned.
+ */
+static inline uint32_t shfs_volchk_locate(chk_t chk, uint32_t chk_off, unsigned int *m, uint64_t *off)
+{
+	strp_t strp;
+
+	switch (shfs_vol.stripemode) {
+	case SHFS_SM_COMBINED:
+		strp = (strp_t) chk * (strp_t) shfs_vol.nb_members;
+		break;
+	case SHFS_SM_INDEPENDENT:
+	default:
+		strp = (strp_t) chk + (strp_t) (shfs_vol.nb_members - 1);
+		break;
+	}
+	strp += chk_off / shfs_vol.stripesize;
+
+	*m   = strp % shfs_vol.nb_members;
+	*off = (uint64_t) (strp / shfs_vol.nb_members)
+		* (uint64_t) shfs_vol.member[*m].sfactor
+		* (uint64_t) blkdev_ssize(shfs_vol.member[*m].bd)
+		+ (chk_off % shfs_vol.stripesize);
+	return shfs_vol.stripesize - (chk_off % shfs_vol.stripesize);
+}
+
 static inline void shfs_poll_blkdevs(void) {
 	register unsigned int i;
 	register uint8_t m = shfs_blkdevs_count();
@@ -140,6 +256,29 @@ static inline void shfs_poll_blkdevs(void) {
 		blkdev_poll_req(shfs_vol.member[i].bd);
 }
 
+#ifdef BLKDEV_CAN_REGISTER_BUFFERS
+/*
+ * Registers a memory area that is used as I/O target (e.g., cache buffers)
+ * at the volume members. Failures are not critical: I/O to the area
+ * is then done like to any other buffer.
+ */
+static inline void shfs_register_iobufs(void *base, size_t len) {
+	register unsigned int i;
+	register uint8_t m = shfs_blkdevs_count();
+
+	for(i = 0; i < m; ++i)
+		blkdev_register_buffers(shfs_vol.member[i].bd, base, len);
+}
+
+static inline void shfs_unregister_iobufs(void) {
+	register unsigned int i;
+	register uint8_t m = shfs_blkdevs_count();
+
+	for(i = 0; i < m; ++i)
+		blkdev_unregister_buffers(shfs_vol.member[i].bd);
+}
+#endif /* BLKDEV_CAN_REGISTER_BUFFERS */
+
 #ifdef CAN_POLL_BLKDEV
 #include <sys/select.h>
 
@@ -203,6 +342,20 @@ SHFS_AIO_TOKEN *shfs_aio_chunk(chk_t start, chk_t len, int write, void *buffer,
 #define shfs_awrite_chunk(start, len, buffer, cb, cb_cookie, cb_argp) \
 	shfs_aio_chunk((start), (len), 1, (buffer), (cb), (cb_cookie), (cb_argp))
 
+/*
+ * Vectored version of shfs_aio_chunk(): Chunk start + i is transferred
+ * from/to buffers[i] (len buffers have to be passed). The whole operation
+ * is covered by a single token/callback.
+ * If the block device layer supports vectored I/O (BLKDEV_CAN_IOV), stripes
+ * that are contiguous on a member are merged into a single device request.
+ */
+SHFS_AIO_TOKEN *shfs_aio_chunkv(chk_t start, chk_t len, int write, void **buffers,
+                                shfs_aiocb_t *cb, void *cb_cookie, void *cb_argp);
+#define shfs_aread_chunkv(start, len, buffers, cb, cb_cookie, cb_argp)	\
+	shfs_aio_chunkv((start), (len), 0, (buffers), (cb), (cb_cookie), (cb_argp))
+#define shfs_awrite_chunkv(start, len, buffers, cb, cb_cookie, cb_argp) \
+	shfs_aio_chunkv((start), (len), 1, (buffers), (cb), (cb_cookie), (cb_argp))
+
 static inline void shfs_aio_submit(void) {
 #ifndef __KERNEL__
 	register unsigned int i;
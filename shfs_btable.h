@@ -64,20 +64,45 @@
  * the depending hentry (SHFS Hash Table Entry)
  */
 struct shfs_bentry {
+#ifndef SHFS_BENTRY_COMPACT
 	chk_t hentry_htchunk;       /* relative chunk:offfset addres to entry in SHFS htable */
 	off_t hentry_htoffset;
+#else
+	uint32_t hentry_htchunk;    /* relative chunk of the entry in SHFS htable */
+	uint32_t refcount;
+#endif
 
 #ifndef __SHFS_TOOLS__
 	struct shfs_hentry *hentry; /* reference to buffered entry in cache */
+#ifndef SHFS_BENTRY_COMPACT
 	uint32_t refcount;
 	sem_t updatelock; /* lock is helt as long the file is opened */
 	int update; /* is set when a entry update is ongoing */
+#endif
 
 #ifdef SHFS_STATS
 	struct shfs_el_stats hstats;
+#ifdef SHFS_PREFETCH
+	uint32_t pf_h; /* hits seen by the prefetcher */
+	uint32_t pf_score; /* decaying popularity */
+#endif
 #endif /* SHFS_STATS */
 
 	void *cookie; /* shfs_fio: upper layer software can attach cookies to open files */
+	void *pcookie; /* shfs_fio: persistent cookie, released on object update */
+#ifdef SHFS_VARIANTS
+	struct shfs_bentry *vnext; /* next pre-encoded variant of this object */
+#endif
+#ifdef SHFS_BENTRY_COMPACT
+	uint8_t update; /* is set when a entry update is ongoing
+	                 * (updater waits on the volume's updatewait) */
+#endif
+#if defined SHFS_VARIANTS && defined SHFS_HTABLE_LAZY
+	uint8_t isvariant; /* known without loading the hentry */
+#endif
+#if defined SHFS_OPENBYNAME && !defined __KERNEL__
+	uint32_t nhash; /* name hash (name index) */
+#endif
 #ifdef __KERNEL__
 	/* Inode number allocated for this file */
 	int ino;
@@ -86,8 +111,14 @@ struct shfs_bentry {
 #endif
 };
 
-#define shfs_alloc_btable(nb_bkts, ent_per_bkt, hlen) \
-	alloc_htable((nb_bkts), (ent_per_bkt), (hlen), sizeof(struct shfs_bentry), CACHELINE_SIZE);
+#ifdef SHFS_BENTRY_COMPACT
+#define SHFS_BTABLE_ALIGN 0 /* no padding of elements */
+#else
+#define SHFS_BTABLE_ALIGN CACHELINE_SIZE
+#endif
+
+#define shfs_alloc_btable(nb_bkts, ent_per_bkt, hlen, bkt_mode) \
+	alloc_htable((nb_bkts), (ent_per_bkt), (hlen), sizeof(struct shfs_bentry), SHFS_BTABLE_ALIGN, (bkt_mode));
 #define shfs_free_btable(bt) \
 	free_htable((bt))
 
@@ -103,10 +134,14 @@ static inline struct shfs_bentry *shfs_btable_lookup(struct htable *bt, hash512_
 	return NULL;
 }
 
-#ifdef SHFS_OPENBYNAME
+#if defined SHFS_OPENBYNAME && !defined SHFS_BENTRY_COMPACT
 /*
  * Unfortunately, opening by name ends up in an
  * expensive search algorithm: O(n^2)
+ * Note: Pre-encoded variants share the name of their
+ *  object and are skipped
+ * Note: MiniCache resolves names with the name index of the volume
+ *  instead (see: shfs_lookup_bentry_byname())
  */
 static inline struct shfs_bentry *shfs_btable_lookup_byname(struct htable *bt,
 							    void **htchunks,
@@ -126,6 +161,8 @@ static inline struct shfs_bentry *shfs_btable_lookup_byname(struct htable *bt,
 
 		if (name_len > sizeof(hentry->name))
 			continue;
+		if (SHFS_HENTRY_ISVARIANT(hentry))
+			continue;
 
 		if (strncmp(name, hentry->name, sizeof(hentry->name)) == 0) {
 			/* we found it - hooray! */
@@ -161,6 +198,20 @@ static void shfs_btable_rmentry(struct htable *bt, hash512_t h) {
 }
 #endif
 
+/**
+ * Returns the element of a total index of the hash table
+ * (also if the entry is empty)
+ */
+static inline struct htable_el *shfs_btable_pick_el(struct htable *bt, uint64_t ent_idx) {
+	struct htable_bkt *b;
+
+	b = bt->b[(uint32_t) (ent_idx / (uint64_t) bt->el_per_bkt)];
+	return _htable_bkt_el(b, (uint32_t) (ent_idx % (uint64_t) bt->el_per_bkt));
+}
+
+#define shfs_btable_pick(bt, ent_idx) \
+	((struct shfs_bentry *) shfs_btable_pick_el((bt), (ent_idx))->private)
+
 /**
  * This function is intended to be used during (re-)mount time.
  * It is intended to load a hash table from a device:
@@ -185,7 +236,7 @@ static inline struct shfs_bentry *shfs_btable_feed(struct htable *bt, uint64_t e
 	el = _htable_bkt_el(b, el_idx_bkt);
 
 	/* check if a previous entry was there -> if yes, unlink it */
-	if (!hash_is_zero(b->h[el_idx_bkt], bt->hlen)) {
+	if (!hash_is_zero(_htable_bkt_h(b, el_idx_bkt), bt->hlen)) {
 		if (el->prev)
 			el->prev->next = el->next;
 		else
@@ -198,7 +249,7 @@ static inline struct shfs_bentry *shfs_btable_feed(struct htable *bt, uint64_t e
 	}
 
 	/* replace hash value */
-	hash_copy(b->h[el_idx_bkt], h, bt->hlen);
+	_htable_bkt_sethash(b, el_idx_bkt, h, bt->hlen);
 
 	/* link the new element to the list, (if it is not empty) */
 	if (!hash_is_zero(h, bt->hlen)) {
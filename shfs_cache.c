@@ -44,6 +44,9 @@
 #include "debug.h"
 
 #define MIN_ALIGN 8
+#ifndef CACHELINE_SIZE
+#define CACHELINE_SIZE 64
+#endif
 
 #ifdef __MINIOS__
 #if defined HAVE_LIBC && !defined CONFIG_ARM
@@ -67,10 +70,14 @@ static void _cce_pobj_init(struct mempool_obj *pobj, void *unused)
 
     cce->pobj = pobj;
     cce->refcount = 0;
+    cce->pq = SHFS_CACHE_Q_NONE;
+    cce->freq = 0;
     cce->buffer = pobj->data;
     cce->invalid = 1; /* buffer is not ready yet */
+    cce->stale = 0;
 
     cce->t = NULL;
+    cce->batch_next = NULL;
     cce->aio_chain.first = NULL;
     cce->aio_chain.last = NULL;
 }
@@ -86,34 +93,39 @@ static inline uint32_t log2(uint32_t v)
   return (i - 1);
 }
 
-static inline uint32_t shfs_htcollison_order(void)
+static inline uint32_t shfs_cache_htorder(uint32_t nb_pool_bffrs)
 {
-    uint32_t htlen;
+    uint64_t nb_slots;
 
-    /* quickly calculate an "optimal" collision table size (heuristical):
-     * n per entry: nb_entries = max_nb_bffrs / n
-     * Note: the resulting number will be shrinked down the
+    /* calculate the index size from the maximum number of buffers:
+     * SHFS_CACHE_HTABLE_SLOTS_PER_ENTRY slots per buffer
+     * Note: the resulting number will be rounded up to the
      * closest power-of-2 value */
+    nb_slots = nb_pool_bffrs;
 #ifdef SHFS_CACHE_GROW
 #ifdef SHFS_CACHE_GROW_THRESHOLD
-    htlen   = (((mm_total_pages() << PAGE_SHIFT) - SHFS_CACHE_GROW_THRESHOLD) /
-              shfs_vol.chunksize) / SHFS_CACHE_HTABLE_AVG_LIST_LENGTH_PER_ENTRY;
+    nb_slots += ((mm_total_pages() << PAGE_SHIFT) - SHFS_CACHE_GROW_THRESHOLD) /
+                shfs_vol.chunksize;
 #else
-    htlen   = ((mm_total_pages() << PAGE_SHIFT) / shfs_vol.chunksize) /
-              SHFS_CACHE_HTABLE_AVG_LIST_LENGTH_PER_ENTRY;
+    nb_slots += (mm_total_pages() << PAGE_SHIFT) / shfs_vol.chunksize;
 #endif
-#else /* SHFS_CACHE_GROW */
-    htlen   = SHFS_CACHE_POOL_NB_BUFFERS /
-              SHFS_CACHE_HTABLE_AVG_LIST_LENGTH_PER_ENTRY;
 #endif /* SHFS_CACHE_GROW */
-    return log2(htlen);
+    nb_slots *= SHFS_CACHE_HTABLE_SLOTS_PER_ENTRY;
+    if (nb_slots < 2)
+	nb_slots = 2;
+    if (nb_slots > (1U << 31))
+	nb_slots = (1U << 31);
+    return log2((uint32_t) (nb_slots - 1)) + 1;
 }
 
 int shfs_alloc_cache(void)
 {
     struct shfs_cache *cc;
-    uint32_t htlen, i;
-    size_t cc_size;
+    uint32_t htorder, htlen, i;
+    uint32_t nb_pool_bffrs = 0;
+#ifndef SHFS_CACHE_POLICY_LRU
+    uint32_t ghostlen;
+#endif
 #ifdef SHFS_CACHE_POOL_MAXALLOC
     size_t pool_size;
 #endif
@@ -121,10 +133,7 @@ int shfs_alloc_cache(void)
 
     ASSERT(shfs_vol.chunkcache == NULL);
 
-    htlen   = 1 << shfs_htcollison_order();
-
-    cc_size = sizeof(*cc) + (htlen * sizeof(struct shfs_cache_htel));
-    cc = target_malloc(MIN_ALIGN, cc_size);
+    cc = target_malloc(MIN_ALIGN, sizeof(*cc));
     if (!cc) {
 	    ret = -ENOMEM;
 	    goto err_out;
@@ -167,16 +176,55 @@ int shfs_alloc_cache(void)
 	    ret = -ENOMEM;
 	    goto err_free_cc;
     }
+    nb_pool_bffrs = mempool_nb_objs(cc->pool);
+#ifdef BLKDEV_CAN_REGISTER_BUFFERS
+    /* pool buffers are the target of almost all I/O */
+    shfs_register_iobufs(mempool_obj_data_area(cc->pool),
+                         mempool_obj_data_area_len(cc->pool));
+#endif
 #if defined SHFS_CACHE_GROW && !defined SHFS_CACHE_POOL_MAXALLOC
     } else {
 	    cc->pool = NULL;
     }
 #endif
-    dlist_init_head(cc->alist);
+
+    /* the index has to be able to address all buffers */
+    htorder = shfs_cache_htorder(nb_pool_bffrs);
+    htlen   = 1 << htorder;
+    cc->htable = target_malloc(CACHELINE_SIZE, htlen * sizeof(struct shfs_cache_htel));
+    if (!cc->htable) {
+	    ret = -ENOMEM;
+	    goto err_free_pool;
+    }
     for (i = 0; i < htlen; ++i)
-	    dlist_init_head(cc->htable[i].clist);
+	    cc->htable[i].addr = 0;
     cc->htlen = htlen;
     cc->htmask = htlen - 1;
+    cc->htshift = 64 - htorder;
+
+#ifndef SHFS_CACHE_POLICY_LRU
+    /* ghost table covers roughly the number of cache buffers */
+    ghostlen = htlen / SHFS_CACHE_HTABLE_SLOTS_PER_ENTRY;
+    ghostlen = 1 << log2(ghostlen ? ghostlen : 1);
+    cc->ghost = target_malloc(MIN_ALIGN, ghostlen * sizeof(struct shfs_cache_ghost));
+    if (!cc->ghost) {
+	    ret = -ENOMEM;
+	    goto err_free_htable;
+    }
+    for (i = 0; i < ghostlen; ++i)
+	    cc->ghost[i].addr = 0;
+    cc->ghostmask = ghostlen - 1;
+#endif
+    for (i = 0; i < SHFS_CACHE_NB_QUEUES; ++i) {
+	    dlist_init_head(cc->queue[i].alist);
+	    cc->queue[i].len = 0;
+#ifndef SHFS_CACHE_POLICY_LRU
+	    cc->nb_ghosts[i] = 0;
+#endif
+    }
+#ifdef SHFS_CACHE_POLICY_ARC
+    cc->arc_p = 0;
+#endif
     cc->nb_entries = 0;
     cc->nb_ref_entries = 0;
 
@@ -184,14 +232,27 @@ int shfs_alloc_cache(void)
     shfs_cache_stats_reset();
     return 0;
 
+#ifndef SHFS_CACHE_POLICY_LRU
+ err_free_htable:
+    target_free(cc->htable);
+#endif
+ err_free_pool:
+    if (cc->pool) {
+#ifdef BLKDEV_CAN_REGISTER_BUFFERS
+	    shfs_unregister_iobufs();
+#endif
+	    free_mempool(cc->pool);
+    }
  err_free_cc:
     target_free(cc);
  err_out:
     return ret;
 }
 
+/* multiplicative hashing (golden ratio): spreads sequential chunk addresses
+ * over the index to avoid long clusters */
 #define shfs_cache_htindex(addr) \
-	(((uint32_t) (addr)) & (shfs_vol.chunkcache->htmask))
+	((uint32_t) (((uint64_t) (addr) * 0x9E3779B97F4A7C15ULL) >> (shfs_vol.chunkcache->htshift)))
 
 static inline struct shfs_cache_entry *shfs_cache_pick_cce(void) {
     struct mempool_obj *cce_obj;
@@ -210,6 +271,10 @@ static inline struct shfs_cache_entry *shfs_cache_pick_cce(void) {
 #ifdef SHFS_CACHE_GROW
     }
 
+    /* keep the load factor of the index */
+    if (shfs_vol.chunkcache->nb_entries >=
+        (shfs_vol.chunkcache->htlen / SHFS_CACHE_HTABLE_SLOTS_PER_ENTRY))
+	return NULL;
 #if (defined SHFS_CACHE_GROW) && (defined SHFS_CACHE_GROW_THRESHOLD)
     if (shfs_cache_free_mem() < SHFS_CACHE_GROW_THRESHOLD)
 	return NULL;
@@ -226,9 +291,13 @@ static inline struct shfs_cache_entry *shfs_cache_pick_cce(void) {
     }
     cce->pobj = NULL;
     cce->refcount = 0;
+    cce->pq = SHFS_CACHE_Q_NONE;
+    cce->freq = 0;
     cce->buffer = buf;
     cce->invalid = 1; /* buffer is not ready yet */
+    cce->stale = 0;
     cce->t = NULL;
+    cce->batch_next = NULL;
     cce->aio_chain.first = NULL;
     cce->aio_chain.last = NULL;
     ++shfs_vol.chunkcache->nb_entries;
@@ -258,48 +327,282 @@ static inline void shfs_cache_put_cce(struct shfs_cache_entry *cce) {
 
 static inline struct shfs_cache_entry *shfs_cache_find(chk_t addr)
 {
-    struct shfs_cache_entry *cce;
+    register struct shfs_cache_htel *htable = shfs_vol.chunkcache->htable;
+    register uint32_t htmask = shfs_vol.chunkcache->htmask;
+    register uint32_t i;
+
+    for (i = shfs_cache_htindex(addr); htable[i].addr; i = (i + 1) & htmask) {
+        if (htable[i].addr == addr)
+            return htable[i].cce;
+    }
+    return NULL; /* not found */
+}
+
+/* adds an entry to the index
+ * Note: the entry must not be part of the index already */
+static inline void shfs_cache_htlink(struct shfs_cache_entry *cce)
+{
+    register struct shfs_cache_htel *htable = shfs_vol.chunkcache->htable;
+    register uint32_t htmask = shfs_vol.chunkcache->htmask;
     register uint32_t i;
 
-    i = shfs_cache_htindex(addr);
-    dlist_foreach(cce, shfs_vol.chunkcache->htable[i].clist, clist) {
-        if (cce->addr == addr) {
-	    /* re-link element to the head of the list for faster successive lookups */
-	    dlist_relink_head(cce, shfs_vol.chunkcache->htable[i].clist, clist);
+    for (i = shfs_cache_htindex(cce->addr); htable[i].addr; i = (i + 1) & htmask)
+        BUG_ON(htable[i].addr == cce->addr);
+    htable[i].addr = cce->addr;
+    htable[i].cce = cce;
+}
+
+/* removes an entry from the index
+ * Following slots of the probe sequence are shifted backwards,
+ * so no tombstones are needed */
+static inline void shfs_cache_htunlink(struct shfs_cache_entry *cce)
+{
+    register struct shfs_cache_htel *htable = shfs_vol.chunkcache->htable;
+    register uint32_t htmask = shfs_vol.chunkcache->htmask;
+    register uint32_t i, j, k;
+
+    for (i = shfs_cache_htindex(cce->addr); htable[i].addr != cce->addr; i = (i + 1) & htmask)
+        BUG_ON(htable[i].addr == 0); /* entry is not part of the index */
+
+    for (j = (i + 1) & htmask; htable[j].addr; j = (j + 1) & htmask) {
+        k = shfs_cache_htindex(htable[j].addr);
+        /* move slot j to the hole at i if its home slot k
+         * is not cyclically between i (exclusive) and j (inclusive) */
+        if (((j - k) & htmask) >= ((j - i) & htmask)) {
+            htable[i] = htable[j];
+            i = j;
+        }
+    }
+    htable[i].addr = 0;
+}
+
+/*
+ * Replacement policy
+ *
+ * Every cached entry is assigned to a queue (cce->pq). Only unreferenced
+ * entries are linked to the available list of their queue and can be
+ * evicted; referenced entries keep their assignment and are linked back
+ * on release.
+ */
+#define shfs_cache_pol_link(cce) \
+	dlist_append((cce), shfs_vol.chunkcache->queue[(cce)->pq].alist, alist)
+#define shfs_cache_pol_unlink(cce) \
+	dlist_unlink((cce), shfs_vol.chunkcache->queue[(cce)->pq].alist, alist)
+#define shfs_cache_pol_drop(cce) /* entry leaves the cache */ \
+	do { \
+		--shfs_vol.chunkcache->queue[(cce)->pq].len; \
+		(cce)->pq = SHFS_CACHE_Q_NONE; \
+	} while (0)
+
+#ifndef SHFS_CACHE_POLICY_LRU
+#define shfs_cache_ghost_slot(addr) \
+	(&shfs_vol.chunkcache->ghost[((uint32_t) (addr)) & shfs_vol.chunkcache->ghostmask])
+
+static inline void shfs_cache_ghost_add(chk_t addr, uint8_t q)
+{
+    struct shfs_cache_ghost *g = shfs_cache_ghost_slot(addr);
+
+    if (g->addr)
+	--shfs_vol.chunkcache->nb_ghosts[g->q]; /* overwrite older record */
+    g->addr = addr;
+    g->q = q;
+    ++shfs_vol.chunkcache->nb_ghosts[q];
+}
+
+#ifdef SHFS_CACHE_POLICY_ARC
+/* adapts the target length of T1 on a hit in B1 (q = recent) or B2 (q = freq) */
+static inline void shfs_cache_arc_adapt(uint8_t q)
+{
+    struct shfs_cache *cc = shfs_vol.chunkcache;
+    uint64_t delta;
+
+    if (q == SHFS_CACHE_Q_RECENT) {
+	delta = cc->nb_ghosts[SHFS_CACHE_Q_FREQ] / cc->nb_ghosts[SHFS_CACHE_Q_RECENT];
+	delta = delta ? delta : 1;
+	cc->arc_p = min(cc->arc_p + delta, cc->nb_entries);
+    } else {
+	delta = cc->nb_ghosts[SHFS_CACHE_Q_RECENT] / cc->nb_ghosts[SHFS_CACHE_Q_FREQ];
+	delta = delta ? delta : 1;
+	cc->arc_p = (cc->arc_p > delta) ? (cc->arc_p - delta) : 0;
+    }
+}
+#endif /* SHFS_CACHE_POLICY_ARC */
+#endif /* !SHFS_CACHE_POLICY_LRU */
+
+/* assigns a new entry (addr has to be set) to a queue and
+ * links it to the queue's available list */
+static inline void shfs_cache_pol_insert(struct shfs_cache_entry *cce)
+{
+    uint8_t q = SHFS_CACHE_Q_RECENT;
+#ifndef SHFS_CACHE_POLICY_LRU
+    struct shfs_cache_ghost *g = shfs_cache_ghost_slot(cce->addr);
+
+    if (g->addr == cce->addr) {
+	/* chunk was evicted recently: admit it to the frequency queue */
+	printd("Ghost hit on chunk %"PRIchk"\n", cce->addr);
+#ifdef SHFS_CACHE_POLICY_ARC
+	shfs_cache_arc_adapt(g->q);
+#endif
+	--shfs_vol.chunkcache->nb_ghosts[g->q];
+	g->addr = 0;
+	q = SHFS_CACHE_Q_FREQ;
+	shfs_cache_stat_inc(ghosthit);
+    }
+#endif
+
+    cce->pq = q;
+    cce->freq = 0;
+    cce->rdahead = 0;
+    cce->ramark = 0;
+    cce->stale = 0;
+    ++shfs_vol.chunkcache->queue[q].len;
+    shfs_cache_pol_link(cce);
+}
+
+#ifndef SHFS_CACHE_POLICY_LRU
+/* moves an entry to the tail of the frequency queue */
+static inline void shfs_cache_pol_promote(struct shfs_cache_entry *cce)
+{
+    if (cce->refcount == 0)
+	shfs_cache_pol_unlink(cce);
+    if (cce->pq != SHFS_CACHE_Q_FREQ) {
+	--shfs_vol.chunkcache->queue[cce->pq].len;
+	++shfs_vol.chunkcache->queue[SHFS_CACHE_Q_FREQ].len;
+	cce->pq = SHFS_CACHE_Q_FREQ;
+	shfs_cache_stat_inc(promote);
+    }
+    cce->freq = 0;
+    if (cce->refcount == 0)
+	shfs_cache_pol_link(cce);
+}
+#endif
+
+/* called on every cache hit of a caller (read-aheads are not considered as access) */
+static inline void shfs_cache_pol_hit(struct shfs_cache_entry *cce)
+{
+    shfs_cache_stat_inc(qhit[cce->pq]);
+    if (cce->rdahead) {
+	/* first access of a read-ahead chunk is not a re-reference */
+	cce->rdahead = 0;
+	return;
+    }
+#if defined SHFS_CACHE_POLICY_S3FIFO
+    /* lazy promotion: entries are only moved when they reach the queue head */
+    if (cce->freq < SHFS_CACHE_S3FIFO_MAXFREQ)
+	++cce->freq;
+#elif defined SHFS_CACHE_POLICY_2Q
+    /* hits on A1in are considered as correlated and do not promote */
+    if (cce->pq == SHFS_CACHE_Q_FREQ)
+	shfs_cache_pol_promote(cce);
+#elif defined SHFS_CACHE_POLICY_ARC
+    shfs_cache_pol_promote(cce);
+#endif
+}
+
+/* returns the first unreferenced entry of a queue that has completed I/O */
+static inline struct shfs_cache_entry *shfs_cache_pol_first_idle(uint8_t q)
+{
+    struct shfs_cache_entry *cce;
+
+    dlist_foreach(cce, shfs_vol.chunkcache->queue[q].alist, alist) {
+	if (cce->t == NULL)
+	    return cce;
+    }
+    return NULL;
+}
 
-            return cce;
+/*
+ * Selects and removes a victim from the queues
+ * The returned entry is still linked to the index
+ * NULL is returned when no entry can be evicted currently
+ */
+static inline struct shfs_cache_entry *shfs_cache_pol_victim(void)
+{
+    struct shfs_cache_entry *cce;
+    uint8_t q;
+
+    for (;;) {
+#if defined SHFS_CACHE_POLICY_2Q
+	q = (shfs_vol.chunkcache->queue[SHFS_CACHE_Q_RECENT].len * 100 >
+	     shfs_vol.chunkcache->nb_entries * SHFS_CACHE_2Q_KIN) ?
+		SHFS_CACHE_Q_RECENT : SHFS_CACHE_Q_FREQ;
+#elif defined SHFS_CACHE_POLICY_S3FIFO
+	q = (shfs_vol.chunkcache->queue[SHFS_CACHE_Q_RECENT].len * 100 >=
+	     shfs_vol.chunkcache->nb_entries * SHFS_CACHE_S3FIFO_SMALL) ?
+		SHFS_CACHE_Q_RECENT : SHFS_CACHE_Q_FREQ;
+#elif defined SHFS_CACHE_POLICY_ARC
+	q = (shfs_vol.chunkcache->queue[SHFS_CACHE_Q_RECENT].len >
+	     shfs_vol.chunkcache->arc_p) ?
+		SHFS_CACHE_Q_RECENT : SHFS_CACHE_Q_FREQ;
+#else
+	q = SHFS_CACHE_Q_RECENT;
+#endif
+	cce = shfs_cache_pol_first_idle(q);
+#ifndef SHFS_CACHE_POLICY_LRU
+	if (!cce) {
+	    /* fallback to the other queue */
+	    q ^= 1;
+	    cce = shfs_cache_pol_first_idle(q);
+	}
+#endif
+	if (!cce)
+	    return NULL; /* we are out of buffers */
+
+#ifdef SHFS_CACHE_POLICY_S3FIFO
+	if (cce->freq) {
+	    /* entry was accessed while being queued: give it another round */
+	    if (q == SHFS_CACHE_Q_RECENT) {
+		shfs_cache_pol_promote(cce);
+	    } else {
+		--cce->freq;
+		dlist_relink_tail(cce, shfs_vol.chunkcache->queue[q].alist, alist);
+	    }
+	    continue;
 	}
+#endif
+	break;
     }
-    return NULL; /* not found */
+
+    printd("Evict chunk %"PRIchk" from queue %"PRIu8"\n", cce->addr, q);
+    shfs_cache_pol_unlink(cce);
+    shfs_cache_pol_drop(cce);
+#if defined SHFS_CACHE_POLICY_ARC
+    shfs_cache_ghost_add(cce->addr, q);
+#elif !defined SHFS_CACHE_POLICY_LRU
+    if (q == SHFS_CACHE_Q_RECENT)
+	shfs_cache_ghost_add(cce->addr, q);
+#endif
+    shfs_cache_stat_inc(evict);
+    shfs_cache_stat_inc(qevict[q]);
+    return cce;
 }
 
 /* removes a cache entry from the cache
  * Note: never call this function on custom buffers that do not appear in any lists */
 static inline void shfs_cache_unlink(struct shfs_cache_entry *cce)
 {
-#ifndef SHFS_CACHE_DISABLE
-    register uint32_t i;
-#endif /* SHFS_CACHE_DISABLE */
 
     ASSERT(cce->refcount == 0);
 
 #ifndef SHFS_CACHE_DISABLE
-    /* unlink element from hash table collision list */
-    i = shfs_cache_htindex(cce->addr);
-    dlist_unlink(cce, shfs_vol.chunkcache->htable[i].clist, clist);
+    /* unlink element from index */
+    shfs_cache_htunlink(cce);
 #endif /* SHFS_CACHE_DISABLE */
 
     /* unlink element from available list */
-    dlist_unlink(cce, shfs_vol.chunkcache->alist, alist);
+    shfs_cache_pol_unlink(cce);
+    shfs_cache_pol_drop(cce);
 }
 
 /* put unreferenced buffers back to the pool */
 static inline void shfs_cache_flush_alist(void)
 {
     struct shfs_cache_entry *cce;
+    uint8_t q;
 
     printd("Flushing cache...\n");
-    while ((cce = dlist_first_el(shfs_vol.chunkcache->alist, struct shfs_cache_entry)) != NULL) {
+    for (q = 0; q < SHFS_CACHE_NB_QUEUES; ++q) {
+    while ((cce = dlist_first_el(shfs_vol.chunkcache->queue[q].alist, struct shfs_cache_entry)) != NULL) {
 	    if (cce->t) {
 		    printd("I/O of chunk buffer %llu is not done yet, "
 		            "waiting for completion...\n", cce->addr);
@@ -316,9 +619,10 @@ static inline void shfs_cache_flush_alist(void)
 	    }
 
 	    printd("Releasing chunk buffer %llu...\n", cce->addr);
-	    shfs_cache_unlink(cce); /* unlinks element from alist and clist */
+	    shfs_cache_unlink(cce); /* unlinks element from alist and index */
 	    shfs_cache_put_cce(cce);
     }
+    }
 }
 
 void shfs_flush_cache(void)
@@ -326,26 +630,141 @@ void shfs_flush_cache(void)
     shfs_cache_flush_alist();
 }
 
+#ifndef SHFS_CACHE_DISABLE
+/* removes an entry from the index so that its chunk is re-read on the next access
+ * Idle entries are put back to the pool, referenced ones are destroyed on release */
+static inline void shfs_cache_drop(struct shfs_cache_entry *cce)
+{
+    uint32_t refcount = cce->refcount;
+
+    if (cce->t) {
+	printd("I/O of chunk buffer %llu is not done yet, "
+	       "waiting for completion...\n", cce->addr);
+	/* hold a reference so that the completion neither
+	 * destroys nor relinks the buffer */
+	++cce->refcount;
+	while (cce->t)
+	    shfs_poll_blkdevs(); /* requires shfs_mounted = 1 */
+	--cce->refcount;
+    }
+
+    printd("Invalidating chunk buffer %llu...\n", cce->addr);
+    shfs_cache_htunlink(cce);
+    if (cce->refcount == 0) {
+	if (refcount == 0)
+	    shfs_cache_pol_unlink(cce); /* was part of an available list */
+	else
+	    --shfs_vol.chunkcache->nb_ref_entries; /* last reference was released meanwhile */
+	shfs_cache_pol_drop(cce);
+	shfs_cache_put_cce(cce);
+    } else {
+	cce->stale = 1;
+    }
+}
+#endif /* SHFS_CACHE_DISABLE */
+
+void shfs_cache_invalidate(chk_t start, chk_t end)
+{
+#ifndef SHFS_CACHE_DISABLE
+    struct shfs_cache *cc = shfs_vol.chunkcache;
+    struct shfs_cache_entry *cce;
+    chk_t addr;
+    uint32_t i;
+
+    if (start == 0)
+	start = 1; /* chunk 0 is never cached */
+    if (start >= end)
+	return;
+
+    if ((uint64_t) (end - start) > cc->htlen) {
+	/* large range: walking the index is cheaper than probing each address
+	 * Note: removing an entry shifts following ones back into slot i,
+	 *       that is why i is only advanced when nothing was dropped.
+	 *       Dropping an entry with I/O in flight polls the devices: the
+	 *       completion callbacks may evict (and thereby move) any other
+	 *       entry, so the walk is restarted afterwards */
+	for (i = 0; i < cc->htlen; ) {
+	    addr = cc->htable[i].addr;
+	    if (addr < start || addr >= end) {
+		++i;
+		continue;
+	    }
+	    cce = cc->htable[i].cce;
+	    if (cce->t) {
+		shfs_cache_drop(cce);
+		i = 0;
+		continue;
+	    }
+	    shfs_cache_drop(cce);
+	}
+	return;
+    }
+    for (addr = start; addr < end; ++addr) {
+	cce = shfs_cache_find(addr);
+	if (cce)
+	    shfs_cache_drop(cce);
+    }
+#endif /* SHFS_CACHE_DISABLE */
+}
+
 void shfs_free_cache(void)
 {
     shfs_cache_flush_alist();
+#ifdef BLKDEV_CAN_REGISTER_BUFFERS
+    if (shfs_vol.chunkcache->pool)
+	shfs_unregister_iobufs();
+#endif
     free_mempool(shfs_vol.chunkcache->pool); /* will fail with an assertion
                                               * if objects were not put back to the pool already */
+#ifndef SHFS_CACHE_POLICY_LRU
+    target_free(shfs_vol.chunkcache->ghost);
+#endif
+    target_free(shfs_vol.chunkcache->htable);
     target_free(shfs_vol.chunkcache);
     shfs_vol.chunkcache = NULL;
 }
 
-static void _cce_aiocb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
+#ifndef SHFS_CACHE_DISABLE
+static inline int shfs_cache_rankable(struct shfs_cache_entry *cce)
 {
-    struct shfs_cache_entry *cce = (struct shfs_cache_entry *) cookie;
-    SHFS_AIO_TOKEN *t_cur, *t_next;
-    int ret;
+    return (cce->addr && !cce->invalid && !cce->rdahead && !cce->t);
+}
+#endif
 
-    BUG_ON(cce->refcount == 0 && cce->aio_chain.first);
-    BUG_ON(t != cce->t);
+uint64_t shfs_cache_rank(chk_t *out, uint64_t max)
+{
+    uint64_t nb = 0;
+#ifndef SHFS_CACHE_DISABLE
+    struct shfs_cache *cc = shfs_vol.chunkcache;
+    struct shfs_cache_entry *cce;
+    uint32_t i;
+    int q;
+
+    /* referenced entries are in use right now: rank them first */
+    for (i = 0; i < cc->htlen && nb < max; ++i) {
+	if (!cc->htable[i].addr)
+	    continue;
+	cce = cc->htable[i].cce;
+	if (cce->refcount && shfs_cache_rankable(cce))
+	    out[nb++] = cce->addr;
+    }
 
-    ret = shfs_aio_finalize(t);
-    cce->t = NULL;
+    /* idle entries: frequency queue before recency queue,
+     * most recently released entries first */
+    for (q = SHFS_CACHE_NB_QUEUES - 1; q >= 0 && nb < max; --q) {
+	dlist_foreach_reverse(cce, cc->queue[q].alist, alist) {
+	    if (nb == max)
+		break;
+	    if (shfs_cache_rankable(cce))
+		out[nb++] = cce->addr;
+	}
+    }
+#endif
+    return nb;
+}
+
+static inline void _cce_setresult(struct shfs_cache_entry *cce, int ret)
+{
     cce->invalid = (ret < 0) ? 1 : 0;
     printd("Cache I/O at chunk %"PRIchk" returned: %d\n", cce->addr, ret);
 
@@ -353,6 +772,12 @@ static void _cce_aiocb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
 	shfs_cache_stat_inc(ioerr);
     else
 	shfs_cache_stat_inc(iosuc);
+}
+
+/* called after I/O completion (cce->t has to be cleared already) */
+static inline void _cce_complete(struct shfs_cache_entry *cce, int ret)
+{
+    SHFS_AIO_TOKEN *t_cur, *t_next;
 
     /* I/O failed and no references? (in case of read-ahead) */
     if (unlikely(cce->refcount == 0
@@ -387,33 +812,66 @@ static void _cce_aiocb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
     }
 }
 
-static inline struct shfs_cache_entry *shfs_cache_add(chk_t addr)
+static void _cce_aiocb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
+{
+    struct shfs_cache_entry *cce = (struct shfs_cache_entry *) cookie;
+    int ret;
+
+    BUG_ON(cce->refcount == 0 && cce->aio_chain.first);
+    BUG_ON(t != cce->t);
+
+    ret = shfs_aio_finalize(t);
+    cce->t = NULL;
+    _cce_setresult(cce, ret);
+    _cce_complete(cce, ret);
+}
+
+#if (SHFS_CACHE_READAHEAD_MAX > 1) && !defined SHFS_CACHE_DISABLE
+/* completion of a batched read-ahead request:
+ * cookie is the first entry of the batch, the others are chained via batch_next */
+static void _cce_batch_aiocb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
+{
+    struct shfs_cache_entry *cce = (struct shfs_cache_entry *) cookie;
+    struct shfs_cache_entry *cce_next;
+    int ret = t->ret;
+
+    for (cce_next = cce; cce_next; cce_next = cce_next->batch_next) {
+	BUG_ON(t != cce_next->t);
+	_cce_setresult(cce_next, ret);
+    }
+
+    /* entries keep referencing t until they are completed:
+     * this prevents an eviction of not yet completed entries by callbacks */
+    while (cce) {
+	cce_next = cce->batch_next;
+	cce->batch_next = NULL;
+	cce->t = NULL;
+	_cce_complete(cce, ret);
+	cce = cce_next;
+    }
+    shfs_aio_finalize(t);
+}
+#endif
+
+/* picks a blank buffer or evicts one and assigns it to addr
+ * Note: the entry is neither part of a queue nor of the index */
+static inline struct shfs_cache_entry *shfs_cache_alloc(chk_t addr)
 {
     struct shfs_cache_entry *cce;
-    register uint32_t i;
 
     cce = shfs_cache_pick_cce();
-    if (cce) {
-	/* got a new buffer: append it to alist */
-	dlist_append(cce, shfs_vol.chunkcache->alist, alist);
-    } else {
+    if (!cce) {
 #ifndef SHFS_CACHE_DISABLE
-	/* try to pick a buffer (that has completed I/O) from the available list */
-	dlist_foreach(cce, shfs_vol.chunkcache->alist, alist) {
-		if (cce->t == NULL)
-			goto found;
+	/* try to evict a buffer (that has completed I/O) from the available queues */
+	cce = shfs_cache_pol_victim();
+	if (!cce) {
+		/* we are out of buffers */
+		errno = EAGAIN;
+		return NULL;
 	}
-	/* we are out of buffers */
-	errno = EAGAIN;
-	return NULL;
 
-    found:
-	shfs_cache_stat_inc(evict);
-	/* unlink from hash table */
-	i = shfs_cache_htindex(cce->addr);
-	dlist_unlink(cce, shfs_vol.chunkcache->htable[i].clist, clist);
-	/* move entry to the tail of alist */
-	dlist_relink_tail(cce, shfs_vol.chunkcache->alist, alist);
+	/* unlink from index */
+	shfs_cache_htunlink(cce);
 #else /* SHFS_CACHE_DISABLE */
 	errno = EAGAIN;
 	return NULL;
@@ -421,61 +879,205 @@ static inline struct shfs_cache_entry *shfs_cache_add(chk_t addr)
     }
 
     cce->addr = addr;
+    return cce;
+}
+
+static inline struct shfs_cache_entry *shfs_cache_add(chk_t addr)
+{
+    struct shfs_cache_entry *cce;
+
+    cce = shfs_cache_alloc(addr);
+    if (!cce)
+	return NULL;
+
+    /* assign entry to a queue and append it to its available list */
+    shfs_cache_pol_insert(cce);
     cce->t = shfs_aread_chunk(addr, 1, cce->buffer,
                               _cce_aiocb, cce, NULL);
     if (unlikely(!cce->t)) {
-	    dlist_unlink(cce, shfs_vol.chunkcache->alist, alist);
+	    shfs_cache_pol_unlink(cce);
+	    shfs_cache_pol_drop(cce);
 	    shfs_cache_put_cce(cce);
 	    printd("Could not initiate I/O request for chunk %"PRIchk": %d\n", addr, errno);
 	    return NULL;
     }
 
 #ifndef SHFS_CACHE_DISABLE
-    /* link element to hash table */
-    i = shfs_cache_htindex(addr);
-    dlist_append(cce, shfs_vol.chunkcache->htable[i].clist, clist);
+    /* link element to index */
+    shfs_cache_htlink(cce);
 #endif /* SHFS_CACHE_DISABLE */
 
     return cce;
 }
 
-#if (SHFS_CACHE_READAHEAD > 0)
-static inline void shfs_cache_readahead(chk_t addr)
+#if (SHFS_CACHE_READAHEAD_MAX > 0) && !defined SHFS_CACHE_DISABLE
+/* requests a run of nb contiguous chunks (batch[0]->addr, batch[0]->addr + 1, ...)
+ * with a single I/O operation */
+static inline void shfs_cache_readahead_issue(struct shfs_cache_entry **batch, unsigned int nb)
+{
+	SHFS_AIO_TOKEN *t;
+	unsigned int i;
+#if (SHFS_CACHE_READAHEAD_MAX > 1)
+	void *buffers[SHFS_CACHE_READAHEAD_MAX];
+#endif
+
+	if (nb == 0)
+		return;
+
+	for (i = 0; i < nb; ++i)
+		shfs_cache_pol_insert(batch[i]);
+
+#if (SHFS_CACHE_READAHEAD_MAX > 1)
+	if (nb > 1) {
+		for (i = 0; i < nb; ++i) {
+			buffers[i] = batch[i]->buffer;
+			batch[i]->batch_next = (i + 1 < nb) ? batch[i + 1] : NULL;
+		}
+		t = shfs_aread_chunkv(batch[0]->addr, nb, buffers,
+		                      _cce_batch_aiocb, batch[0], NULL);
+	} else
+#endif
+	t = shfs_aread_chunk(batch[0]->addr, 1, batch[0]->buffer,
+	                     _cce_aiocb, batch[0], NULL);
+	if (unlikely(!t)) {
+		printd("Read-ahead chunk %"PRIchk"-%"PRIchk": Could not initiate I/O request: %d\n",
+		       batch[0]->addr, batch[0]->addr + nb - 1, errno);
+		for (i = 0; i < nb; ++i) {
+			batch[i]->batch_next = NULL;
+			shfs_cache_pol_unlink(batch[i]);
+			shfs_cache_pol_drop(batch[i]);
+			shfs_cache_put_cce(batch[i]);
+		}
+		shfs_cache_stat_inc(memerr);
+		return;
+	}
+
+	for (i = 0; i < nb; ++i) {
+		batch[i]->t = t;
+		batch[i]->rdahead = 1;
+		shfs_cache_htlink(batch[i]);
+		shfs_cache_stat_inc(rdahead);
+	}
+	batch[0]->ramark = 1;
+	if (nb > 1)
+		shfs_cache_stat_inc(rdbatch);
+	printd("Read-ahead chunk %"PRIchk"-%"PRIchk": Requested\n",
+	       batch[0]->addr, batch[0]->addr + nb - 1);
+}
+
+/*
+ * Missing chunks are collected to runs that are requested with a single I/O operation.
+ * On sequential access, the read-ahead is only triggered by a miss or when the
+ * first chunk of the previous run is accessed (marker), so that the window is
+ * refilled with larger runs instead of a single chunk on each access
+ */
+static inline void shfs_cache_readahead(chk_t addr, uint32_t window)
 {
 	struct shfs_cache_entry *cce;
+	struct shfs_cache_entry *batch[SHFS_CACHE_READAHEAD_MAX];
+	unsigned int nb = 0;
 	register chk_t i;
 
-	for (i = 1; i <= SHFS_CACHE_READAHEAD; ++i) {
+	for (i = 1; i <= window; ++i) {
 		register chk_t addri = addr + i;
 
 		if (unlikely((addri) >= shfs_vol.volsize))
-			return; /* end of volume */
+			break; /* end of volume */
 		cce = shfs_cache_find(addri);
 		if (!cce) {
-			cce = shfs_cache_add(addri);
+			cce = shfs_cache_alloc(addri);
 			if (!cce) {
-				printd("Read-ahead chunk %"PRIchk" (%u/%u): Failed: Out of buffers\n", (addri), i, SHFS_CACHE_READAHEAD);
+				printd("Read-ahead chunk %"PRIchk" (%u/%u): Failed: Out of buffers\n", (addri), i, window);
 				shfs_cache_stat_inc(memerr);
-				return; /* out of buffers */
-			} else {
-				printd("Read-ahead chunk %"PRIchk" (%u/%u): Requested\n", (addri), i, SHFS_CACHE_READAHEAD);
-				shfs_cache_stat_inc(rdahead);
+				break; /* out of buffers */
 			}
+			batch[nb++] = cce;
 		} else {
-			printd("Read-ahead chunk %"PRIchk" (%u/%u): Already in cache\n", (addri), i, SHFS_CACHE_READAHEAD);
+			/* end of run */
+			shfs_cache_readahead_issue(batch, nb);
+			nb = 0;
+
+			printd("Read-ahead chunk %"PRIchk" (%u/%u): Already in cache\n", (addri), i, window);
 			if (shfs_aio_is_done(cce->t))
 				shfs_cache_stat_inc(hit);
 			else
 				shfs_cache_stat_inc(hitwait);
 		}
 	}
+	shfs_cache_readahead_issue(batch, nb);
+}
+
+/* number of buffers that could be used for new entries without
+ * touching referenced ones */
+static inline uint64_t shfs_cache_nb_avail(void)
+{
+	uint64_t nb_avail;
+
+	nb_avail = shfs_vol.chunkcache->nb_entries - shfs_vol.chunkcache->nb_ref_entries;
+	if (shfs_vol.chunkcache->pool)
+		nb_avail += mempool_free_count(shfs_vol.chunkcache->pool);
+#ifdef SHFS_CACHE_GROW
+	if (shfs_vol.chunkcache->nb_entries <
+	    (shfs_vol.chunkcache->htlen / SHFS_CACHE_HTABLE_SLOTS_PER_ENTRY))
+		nb_avail += (shfs_vol.chunkcache->htlen / SHFS_CACHE_HTABLE_SLOTS_PER_ENTRY)
+		            - shfs_vol.chunkcache->nb_entries;
+#endif
+	return nb_avail;
+}
+
+/*
+ * Updates the read-ahead state of a stream with an access to addr and returns
+ * the number of chunks that shall be read ahead (trigger != 0). The window
+ * is capped by the number of reusable buffers so that a single fast stream
+ * cannot flush the cache, and it is cut at the end of the stream
+ */
+static inline uint32_t shfs_cache_readahead_window(struct shfs_cache_rastate *ra, chk_t addr, int trigger)
+{
+	uint64_t cap;
+	uint32_t window;
+
+	if (!ra)
+		return trigger ? SHFS_CACHE_READAHEAD : 0;
+
+	if (addr == ra->next) {
+		/* sequential access: grow window */
+		if (trigger && ra->window < SHFS_CACHE_READAHEAD_MAX) {
+			if (ra->window < SHFS_CACHE_READAHEAD)
+				ra->window = SHFS_CACHE_READAHEAD;
+			else
+				ra->window = min(ra->window << 1, SHFS_CACHE_READAHEAD_MAX);
+			shfs_cache_stat_inc(rdgrow);
+		}
+	} else if (ra->next && addr + 1 != ra->next) {
+		/* random access: shrink window */
+		if (ra->window) {
+			ra->window >>= 1;
+			shfs_cache_stat_inc(rdshrink);
+		}
+	}
+	ra->next = addr + 1;
+
+	if (!trigger || !ra->window)
+		return 0;
+	window = ra->window;
+	cap = shfs_cache_nb_avail() / SHFS_CACHE_READAHEAD_CAPDIV;
+	if (window > cap) {
+		window = (uint32_t) cap;
+		shfs_cache_stat_inc(rdcap);
+	}
+	if (ra->end && addr + window >= ra->end)
+		window = (ra->end > addr) ? (uint32_t) (ra->end - addr - 1) : 0;
+	return window;
 }
 #endif
 
-int shfs_cache_aread(chk_t addr, shfs_aiocb_t *cb, void *cb_cookie, void *cb_argp, struct shfs_cache_entry **cce_out, SHFS_AIO_TOKEN **t_out)
+int shfs_cache_aread_ra(chk_t addr, struct shfs_cache_rastate *ra, shfs_aiocb_t *cb, void *cb_cookie, void *cb_argp, struct shfs_cache_entry **cce_out, SHFS_AIO_TOKEN **t_out)
 {
     struct shfs_cache_entry *cce;
     SHFS_AIO_TOKEN *t;
+#if (SHFS_CACHE_READAHEAD_MAX > 0) && !defined SHFS_CACHE_DISABLE
+    uint32_t ra_window;
+#endif
     int ret;
 
     ASSERT(cce_out != NULL);
@@ -494,7 +1096,9 @@ int shfs_cache_aread(chk_t addr, shfs_aiocb_t *cb, void *cb_cookie, void *cb_arg
     /* check if we cached already this request */
 #ifndef SHFS_CACHE_DISABLE
     cce = shfs_cache_find(addr);
-    if (!cce) {
+    if (cce) {
+        shfs_cache_pol_hit(cce);
+    } else {
         shfs_cache_stat_inc(miss);
 #endif /* SHFS_CACHE_DISABLE */
         /* no -> initiate a new I/O request */
@@ -505,20 +1109,26 @@ int shfs_cache_aread(chk_t addr, shfs_aiocb_t *cb, void *cb_cookie, void *cb_arg
 	    goto err_out;
 	}
 #ifndef SHFS_CACHE_DISABLE
+	cce->ramark = 1; /* misses trigger a read-ahead */
     }
 #endif /* SHFS_CACHE_DISABLE */
 
     /* increase refcount */
     if (cce->refcount == 0) {
-	dlist_unlink(cce, shfs_vol.chunkcache->alist, alist);
+	shfs_cache_pol_unlink(cce);
 	++shfs_vol.chunkcache->nb_ref_entries;
     }
     ++cce->refcount;
 
 #ifndef SHFS_CACHE_DISABLE
-#if (SHFS_CACHE_READAHEAD > 0)
+#if (SHFS_CACHE_READAHEAD_MAX > 0)
     /* try to read ahead next addresses */
-    shfs_cache_readahead(addr);
+    ra_window = shfs_cache_readahead_window(ra, addr, cce->ramark);
+    if (cce->ramark) {
+	cce->ramark = 0;
+	if (ra_window)
+		shfs_cache_readahead(addr, ra_window);
+    }
 #endif
 #endif /* SHFS_CACHE_DISABLE */
     shfs_aio_submit();
@@ -568,9 +1178,10 @@ int shfs_cache_aread(chk_t addr, shfs_aiocb_t *cb, void *cb_cookie, void *cb_arg
     --cce->refcount;
     if (cce->refcount == 0) {
 	--shfs_vol.chunkcache->nb_ref_entries;
-	dlist_append(cce, shfs_vol.chunkcache->alist, alist);
+	shfs_cache_pol_link(cce);
     }
 #else /* SHFS_CACHE_DISABLE */
+    shfs_cache_pol_drop(cce);
     shfs_cache_put_cce(cce);
 #endif /* SHFS_CACHE_DISABLE */
  err_out:
@@ -595,21 +1206,19 @@ int shfs_cache_eblank(struct shfs_cache_entry **cce_out)
 
     cce = shfs_cache_pick_cce();
     if (!cce) {
-	/* try to pick a buffer (that has completed I/O) from the available list */
-	dlist_foreach(cce, shfs_vol.chunkcache->alist, alist) {
-		if (cce->t == NULL)
-			goto found;
+	/* try to evict a buffer (that has completed I/O) from the available queues */
+	cce = shfs_cache_pol_victim();
+	if (!cce) {
+		/* we are out of buffers */
+		ret = -EAGAIN;
+		shfs_cache_stat_inc(memerr);
+		goto err_out;
 	}
-	/* we are out of buffers */
-	ret = -EAGAIN;
-	shfs_cache_stat_inc(memerr);
-	goto err_out;
 
-    found:
-	shfs_cache_stat_inc(evict);
-
-	/* unlink from hash collision table and available list */
-	shfs_cache_unlink(cce);
+#ifndef SHFS_CACHE_DISABLE
+	/* unlink from index */
+	shfs_cache_htunlink(cce);
+#endif /* SHFS_CACHE_DISABLE */
     }
 
     /* set refcount */
@@ -618,7 +1227,7 @@ int shfs_cache_eblank(struct shfs_cache_entry **cce_out)
 
     /* initialize fields */
     /* TODO: These fields let a blank cce buffer to be released (put_cce()),
-     *       because they are not part of any collision lists.
+     *       because they are not part of the index.
      *       As optimization, such buffers could be prepended to the alist instead...,
      *       thus, such a released buffer would be prefered for new I/O requests */
     cce->t = NULL;
@@ -634,15 +1243,25 @@ int shfs_cache_eblank(struct shfs_cache_entry **cce_out)
     return ret;
 }
 
+/*
+ * Adds a reference to an already referenced cache buffer
+ * (I/O has to be finalized on the buffer)
+ */
+void shfs_cache_ref(struct shfs_cache_entry *cce)
+{
+    printd("Reference cache of chunk %llu (refcount=%u, caller=%p)\n", cce->addr, cce->refcount, get_caller());
+    BUG_ON(cce->refcount == 0);
+    BUG_ON(!shfs_aio_is_done(cce->t));
+
+    ++cce->refcount;
+}
+
 /*
  * Fast version to release a cache buffer,
  * however, be sure that the I/O is finalized on the buffer
  */
 void shfs_cache_release(struct shfs_cache_entry *cce)
 {
-#ifndef SHFS_CACHE_DISABLE
-    register uint32_t i;
-#endif /* SHFS_CACHE_DISABLE */
 
     printd("Release cache of chunk %llu (refcount=%u, caller=%p)\n", cce->addr, cce->refcount, get_caller());
     BUG_ON(cce->refcount == 0);
@@ -652,21 +1271,22 @@ void shfs_cache_release(struct shfs_cache_entry *cce)
     if (cce->refcount == 0) {
 	--shfs_vol.chunkcache->nb_ref_entries;
 #if !defined SHFS_CACHE_DISABLE && !defined SHFS_CACHE_IMMEDIATEDROP
-	if (likely(!cce->invalid)) {
-	    dlist_append(cce, shfs_vol.chunkcache->alist, alist);
+	if (likely(!cce->invalid && !cce->stale)) {
+	    shfs_cache_pol_link(cce);
 	} else {
             printd("Destroy invalid cache of chunk %llu\n", cce->addr);
 #else
             printd("Release unreferenced chunk %llu\n", cce->addr);
 #endif /* SHFS_CACHE_DISABLE */
-#ifndef SHFS_CACHE_DISABLE
 	    if (!cce->addr == 0) { /* note: blank buffers are not linked to any lists */
-		/* unlink element from hash table collision list
+#ifndef SHFS_CACHE_DISABLE
+		/* unlink element from index
 		 * it is already unlinked from the available list (refcount was > 0 before) */
-		i = shfs_cache_htindex(cce->addr);
-		dlist_unlink(cce, shfs_vol.chunkcache->htable[i].clist, clist);
-	    }
+		if (!cce->stale)
+			shfs_cache_htunlink(cce);
 #endif /* SHFS_CACHE_DISABLE */
+		shfs_cache_pol_drop(cce);
+	    }
 	    shfs_cache_put_cce(cce);
 #ifdef SHFS_CACHE_IMMEDIATEDROP
 	    shfs_cache_stat_inc(evict);
@@ -684,9 +1304,6 @@ void shfs_cache_release(struct shfs_cache_entry *cce)
  */
 void shfs_cache_release_ioabort(struct shfs_cache_entry *cce, SHFS_AIO_TOKEN *t)
 {
-#ifndef SHFS_CACHE_DISABLE
-    register uint32_t i;
-#endif /* SHFS_CACHE_DISABLE */
 
     printd("Release cache of chunk %llu (refcount=%u, caller=%p)\n", cce->addr, cce->refcount, get_caller());
     BUG_ON(cce->refcount == 0);
@@ -716,39 +1333,56 @@ void shfs_cache_release_ioabort(struct shfs_cache_entry *cce, SHFS_AIO_TOKEN *t)
 	--shfs_vol.chunkcache->nb_ref_entries;
 	if (shfs_aio_is_done(cce->t)
 #if !defined SHFS_CACHE_DISABLE && !defined SHFS_CACHE_IMMEDIATEDROP
-	    && cce->invalid) {
+	    && (cce->invalid || cce->stale)) {
 	    printd("Destroy invalid cache of chunk %llu\n", cce->addr);
 #else /* SHFS_CACHE_DISABLE */
 	    ) {
             printd("Release unreferenced chunk %llu\n", cce->addr);
 #endif /* SHFS_CACHE_DISABLE */
-#ifndef SHFS_CACHE_DISABLE
 	    if (!cce->addr == 0) { /* note: blank buffers are not linked to any lists */
-		/* unlink element from hash table collision list
+#ifndef SHFS_CACHE_DISABLE
+		/* unlink element from index
 		 * it is already unlinked from the available list (refcount was > 0 before) */
-		i = shfs_cache_htindex(cce->addr);
-		dlist_unlink(cce, shfs_vol.chunkcache->htable[i].clist, clist);
-	    }
+		if (!cce->stale)
+			shfs_cache_htunlink(cce);
 #endif /* SHFS_CACHE_DISABLE */
+		shfs_cache_pol_drop(cce);
+	    }
 	    shfs_cache_put_cce(cce);
 #ifdef SHFS_CACHE_IMMEDIATEDROP
 	    shfs_cache_stat_inc(evict);
 #endif /* SHFS_CACHE_IMMEDIATEDROP */
 	} else {
-	    dlist_append(cce, shfs_vol.chunkcache->alist, alist);
+	    shfs_cache_pol_link(cce);
 	}
     }
 }
 
 #ifdef SHFS_CACHE_INFO
+#if defined SHFS_CACHE_POLICY_2Q
+#define SHFS_CACHE_POLICY_NAME "2Q"
+static const char *shfs_cache_qname[SHFS_CACHE_NB_QUEUES] = { "A1in", "Am" };
+#elif defined SHFS_CACHE_POLICY_ARC
+#define SHFS_CACHE_POLICY_NAME "ARC"
+static const char *shfs_cache_qname[SHFS_CACHE_NB_QUEUES] = { "T1", "T2" };
+#elif defined SHFS_CACHE_POLICY_S3FIFO
+#define SHFS_CACHE_POLICY_NAME "S3-FIFO"
+static const char *shfs_cache_qname[SHFS_CACHE_NB_QUEUES] = { "S", "M" };
+#else
+#define SHFS_CACHE_POLICY_NAME "LRU"
+static const char *shfs_cache_qname[SHFS_CACHE_NB_QUEUES] = { "LRU" };
+#endif
+
 int shcmd_shfs_cache_info(FILE *cio, int argc, char *argv[])
 {
 	struct shfs_cache_entry *cce;
 	uint32_t i;
+	uint8_t q;
 	uint32_t chunksize;
 	uint64_t nb_entries;
 	uint64_t nb_ref_entries;
 	uint32_t htlen;
+	uint64_t nb_slots;
 	uint64_t depth, max_depth;
 	uint32_t nb_objs = 0;
 	uint64_t pool_size = 0;
@@ -759,24 +1393,26 @@ int shcmd_shfs_cache_info(FILE *cio, int argc, char *argv[])
 	}
 
 	max_depth = 0;
+	nb_slots = 0;
 #ifdef SHFS_CACHE_DEBUG
 	printk("\nBuffer states:\n");
 #endif
 	for (i = 0; i < shfs_vol.chunkcache->htlen; ++i) {
+		if (!shfs_vol.chunkcache->htable[i].addr)
+			continue;
+		cce = shfs_vol.chunkcache->htable[i].cce;
+		/* distance of the entry to its home slot */
+		depth = (i - shfs_cache_htindex(cce->addr)) & shfs_vol.chunkcache->htmask;
 #ifdef SHFS_CACHE_DEBUG
-		printk(" ht[%3"PRIu32"]:\n", i);
+		printk(" ht[%3"PRIu32"]: %12"PRIchk" chk: %s, refcount: %3"PRIu32", probe: %"PRIu64"\n",
+		       i,
+		       cce->addr,
+		       cce->invalid ? "INVALID" : "valid",
+		       cce->refcount,
+		       depth);
 #endif
-		depth = 0;
-		dlist_foreach(cce, shfs_vol.chunkcache->htable[i].clist, clist) {
-#ifdef SHFS_CACHE_DEBUG
-			printk(" %12"PRIchk" chk: %s, refcount: %3"PRIu32"\n",
-			       cce->addr,
-			       cce->invalid ? "INVALID" : "valid",
-			       cce->refcount);
-#endif
-			++depth;
-		}
 		max_depth = depth > max_depth ? depth : max_depth;
+		++nb_slots;
 	}
 
 	chunksize      = shfs_vol.chunksize;
@@ -793,14 +1429,32 @@ int shcmd_shfs_cache_info(FILE *cio, int argc, char *argv[])
 	        (nb_entries * chunksize) /1024);
 	fprintf(cio, " Number of used buffers in cache:    %12"PRIu32"\n",
 	        nb_ref_entries);
-	fprintf(cio, " Hash table size:                    %12"PRIu32"\n",
-	        htlen);
-	fprintf(cio, " Current max list depth:             %12"PRIu32"\n",
+	fprintf(cio, " Index size:                         %12"PRIu32" (used: %"PRIu64")\n",
+	        htlen, nb_slots);
+	fprintf(cio, " Current max probe distance:         %12"PRIu64"\n",
 	        max_depth);
+	fprintf(cio, " Replacement policy:                 %12s\n",
+	        SHFS_CACHE_POLICY_NAME);
+	for (q = 0; q < SHFS_CACHE_NB_QUEUES; ++q)
+		fprintf(cio, "  Queue %-4s length:                 %12"PRIu64"\n",
+		        shfs_cache_qname[q], shfs_vol.chunkcache->queue[q].len);
+#ifndef SHFS_CACHE_POLICY_LRU
+	for (q = 0; q < SHFS_CACHE_NB_QUEUES; ++q)
+		fprintf(cio, "  Queue %-4s ghosts:                 %12"PRIu64"\n",
+		        shfs_cache_qname[q], shfs_vol.chunkcache->nb_ghosts[q]);
+#ifdef SHFS_CACHE_POLICY_ARC
+	fprintf(cio, "  Target length of T1:               %12"PRIu64"\n",
+	        shfs_vol.chunkcache->arc_p);
+#endif
+#endif
 #if SHFS_CACHE_READAHEAD
 	fprintf(cio, " Buffer read-ahead:                  %12"PRIu32"\n",
 	        SHFS_CACHE_READAHEAD);
 #endif
+#if SHFS_CACHE_READAHEAD_MAX
+	fprintf(cio, " Max. stream read-ahead:             %12"PRIu32" (limited to 1/%u of free buffers)\n",
+	        SHFS_CACHE_READAHEAD_MAX, SHFS_CACHE_READAHEAD_CAPDIV);
+#endif
 #if SHFS_CACHE_POOL_NB_BUFFERS
 	fprintf(cio, " Number pre-allocated buffers:       %12"PRIu32" (pool size: %7"PRIu64" KiB)\n",
 	        nb_objs, pool_size / 1024);
@@ -821,12 +1475,24 @@ int shcmd_shfs_cache_info(FILE *cio, int argc, char *argv[])
 	fprintf(cio, "  Hits:                              %12"PRIu32"\n", shfs_cache_stat_get(hit));
 	fprintf(cio, "  Hits+Wait for I/O:                 %12"PRIu32"\n", shfs_cache_stat_get(hitwait));
 	fprintf(cio, "  Read-aheads:                       %12"PRIu32"\n", shfs_cache_stat_get(rdahead));
+	fprintf(cio, "  Batched read-ahead requests:       %12"PRIu32"\n", shfs_cache_stat_get(rdbatch));
+	fprintf(cio, "  Read-ahead window grows:           %12"PRIu32"\n", shfs_cache_stat_get(rdgrow));
+	fprintf(cio, "  Read-ahead window shrinks:         %12"PRIu32"\n", shfs_cache_stat_get(rdshrink));
+	fprintf(cio, "  Read-ahead window caps:            %12"PRIu32"\n", shfs_cache_stat_get(rdcap));
 	fprintf(cio, "  Misses:                            %12"PRIu32"\n", shfs_cache_stat_get(miss));
 	fprintf(cio, "  Blanks:                            %12"PRIu32"\n", shfs_cache_stat_get(blank));
 	fprintf(cio, "  Evicts:                            %12"PRIu32"\n", shfs_cache_stat_get(evict));
 	fprintf(cio, "  Out of memory:                     %12"PRIu32"\n", shfs_cache_stat_get(memerr));
 	fprintf(cio, "  Successful I/O:                    %12"PRIu32"\n", shfs_cache_stat_get(iosuc));
 	fprintf(cio, "  Failed I/O:                        %12"PRIu32"\n", shfs_cache_stat_get(ioerr));
+	for (q = 0; q < SHFS_CACHE_NB_QUEUES; ++q) {
+		fprintf(cio, "  Queue %-4s hits:                   %12"PRIu32"\n", shfs_cache_qname[q], shfs_cache_stat_get(qhit[q]));
+		fprintf(cio, "  Queue %-4s evicts:                 %12"PRIu32"\n", shfs_cache_qname[q], shfs_cache_stat_get(qevict[q]));
+	}
+#ifndef SHFS_CACHE_POLICY_LRU
+	fprintf(cio, "  Promotions:                        %12"PRIu32"\n", shfs_cache_stat_get(promote));
+	fprintf(cio, "  Ghost hits:                        %12"PRIu32"\n", shfs_cache_stat_get(ghosthit));
+#endif
 #endif
 
 #ifdef SHFS_CACHE_DEBUG
@@ -43,14 +43,25 @@
 #include "dlist.h"
 #include "mempool.h"
 
-#ifndef SHFS_CACHE_HTABLE_AVG_LIST_LENGTH_PER_ENTRY
-#define SHFS_CACHE_HTABLE_AVG_LIST_LENGTH_PER_ENTRY 2 /* defines in the end roughly the average maximum number of comparisons
-						       * per table entry (Note: the real lenght might be higher) */
+#ifndef SHFS_CACHE_HTABLE_SLOTS_PER_ENTRY
+#define SHFS_CACHE_HTABLE_SLOTS_PER_ENTRY 2 /* number of index slots per cache buffer: limits the
+					     * load factor of the open addressing table (has to be > 1) */
 #endif
 
 #ifndef SHFS_CACHE_READAHEAD
 #define SHFS_CACHE_READAHEAD 2 /* how many chunks shall be read ahead (0 = disabled) */
 #endif
+#ifndef SHFS_CACHE_READAHEAD_MAX
+#define SHFS_CACHE_READAHEAD_MAX (8 * SHFS_CACHE_READAHEAD) /* upper bound of the adaptive per-stream
+							     * read-ahead window */
+#endif
+#if (SHFS_CACHE_READAHEAD_MAX < SHFS_CACHE_READAHEAD)
+#error "SHFS_CACHE_READAHEAD_MAX has to be greater or equal than SHFS_CACHE_READAHEAD"
+#endif
+#ifndef SHFS_CACHE_READAHEAD_CAPDIV
+#define SHFS_CACHE_READAHEAD_CAPDIV 4 /* a read-ahead window never exceeds 1/CAPDIV of
+				       * the currently reusable cache buffers */
+#endif
 
 #ifndef SHFS_CACHE_POOL_NB_BUFFERS
 #ifdef  __MINIOS__
@@ -85,20 +96,56 @@
 #endif
 #endif /* __MINIOS__ &6 HAVE_LIBC */
 
+/*
+ * Replacement policy
+ *  Unreferenced entries are kept on eviction candidate queues. Without any
+ *  policy selected, a single queue is used and buffers are recycled in
+ *  order of their release (LRU). The scan-resistant policies split the
+ *  cache into a recency and a frequency queue and remember recently evicted
+ *  addresses in a ghost table:
+ *   SHFS_CACHE_POLICY_2Q:     recency = A1in (FIFO), frequency = Am (LRU)
+ *   SHFS_CACHE_POLICY_ARC:    recency = T1,          frequency = T2
+ *   SHFS_CACHE_POLICY_S3FIFO: recency = S (FIFO),    frequency = M (FIFO)
+ */
+#if defined SHFS_CACHE_POLICY_2Q || defined SHFS_CACHE_POLICY_ARC || defined SHFS_CACHE_POLICY_S3FIFO
+#define SHFS_CACHE_NB_QUEUES 2
+#else
+#define SHFS_CACHE_POLICY_LRU
+#define SHFS_CACHE_NB_QUEUES 1
+#endif
+#define SHFS_CACHE_Q_RECENT 0
+#define SHFS_CACHE_Q_FREQ   1
+#define SHFS_CACHE_Q_NONE   0xFF /* entry is not assigned to any queue (e.g., blank buffers) */
+
+#ifndef SHFS_CACHE_2Q_KIN
+#define SHFS_CACHE_2Q_KIN 25 /* target size of A1in in percent of the cache */
+#endif
+#ifndef SHFS_CACHE_S3FIFO_SMALL
+#define SHFS_CACHE_S3FIFO_SMALL 10 /* target size of S in percent of the cache */
+#endif
+#ifndef SHFS_CACHE_S3FIFO_MAXFREQ
+#define SHFS_CACHE_S3FIFO_MAXFREQ 3
+#endif
+
 struct shfs_cache_entry {
 	struct mempool_obj *pobj;
 
 	chk_t addr;
 	uint32_t refcount;
+	uint8_t pq; /* assigned policy queue */
+	uint8_t freq; /* access counter (S3-FIFO) */
+	uint8_t rdahead; /* loaded by read-ahead, not accessed yet */
+	uint8_t ramark; /* first entry of a read-ahead run: accessing it triggers the next read-ahead */
+	uint8_t stale; /* invalidated while referenced: not indexed anymore, destroyed on release */
 
-	dlist_el(alist); /* when part of the avaliable list */
-	dlist_el(clist); /* when part of a collision list */
+	dlist_el(alist); /* when part of an available queue */
 
 	void *buffer;
 	int invalid; /* I/O didn't succeed on this buffer
 		      * or buffer is a blank buffer when addr == 0 */
 
 	SHFS_AIO_TOKEN *t; /* private I/O token */
+	struct shfs_cache_entry *batch_next; /* next entry sharing t (batched read-ahead) */
 	struct {
 		/* tokens for callers */
 		SHFS_AIO_TOKEN *first;
@@ -106,14 +153,26 @@ struct shfs_cache_entry {
 	} aio_chain;
 };
 
+/* slot of the open addressing index (linear probing)
+ * Note: chunk address 0 is never cached, it marks an empty slot */
 struct shfs_cache_htel {
-	struct dlist_head clist; /* collision list */
+	chk_t addr;
+	struct shfs_cache_entry *cce;
+};
+
+#ifndef SHFS_CACHE_POLICY_LRU
+struct shfs_cache_ghost {
+	chk_t addr; /* 0 = empty slot */
+	uint8_t q; /* queue the entry was evicted from */
 };
+#endif
 
 struct shfs_cache {
 	struct mempool *pool;
+	struct shfs_cache_htel *htable; /* index (all loaded entries (incl. referenced)) */
 	uint32_t htlen;
 	uint32_t htmask;
+	uint32_t htshift;
 	uint64_t nb_ref_entries;
 	uint64_t nb_entries;
 
@@ -122,17 +181,35 @@ struct shfs_cache {
 		uint32_t hit;
 		uint32_t hitwait;
 		uint32_t rdahead;
+		uint32_t rdbatch;
+		uint32_t rdgrow;
+		uint32_t rdshrink;
+		uint32_t rdcap;
 		uint32_t miss;
 		uint32_t blank;
 		uint32_t evict;
 		uint32_t memerr;
 		uint32_t iosuc;
 		uint32_t ioerr;
+		uint32_t qhit[SHFS_CACHE_NB_QUEUES];
+		uint32_t qevict[SHFS_CACHE_NB_QUEUES];
+		uint32_t promote;
+		uint32_t ghosthit;
 	} stats;
 #endif /* SHFS_CACHE_STATS */
 
-	struct dlist_head alist; /* list of available (loaded) but unreferenced entries */
-	struct shfs_cache_htel htable[]; /* hash table (all loaded entries (incl. referenced)) */
+	struct {
+		struct dlist_head alist; /* available (loaded) but unreferenced entries of this queue */
+		uint64_t len; /* number of entries assigned to this queue (incl. referenced) */
+	} queue[SHFS_CACHE_NB_QUEUES];
+#ifndef SHFS_CACHE_POLICY_LRU
+	struct shfs_cache_ghost *ghost; /* direct-mapped table of recently evicted addresses */
+	uint32_t ghostmask;
+	uint64_t nb_ghosts[SHFS_CACHE_NB_QUEUES];
+#ifdef SHFS_CACHE_POLICY_ARC
+	uint64_t arc_p; /* adaptive target length of T1 */
+#endif
+#endif
 };
 
 #ifdef SHFS_CACHE_STATS
@@ -157,9 +234,43 @@ struct shfs_cache {
 
 int shfs_alloc_cache(void);
 void shfs_flush_cache(void); /* releases unreferenced buffers */
+void shfs_cache_invalidate(chk_t start, chk_t end); /* drops buffers of chunks [start, end) */
 void shfs_free_cache(void);
 #define shfs_cache_ref_count() \
 	(shfs_vol.chunkcache->nb_ref_entries)
+#define shfs_cache_nb_buffers() \
+	(shfs_vol.chunkcache->pool ? \
+	 mempool_nb_objs(shfs_vol.chunkcache->pool) : \
+	 shfs_vol.chunkcache->nb_entries)
+
+/*
+ * Writes the addresses of up to max loaded chunks to out, ordered from
+ * the hottest to the coldest one: chunks that are currently referenced,
+ * then the idle entries of the frequency queue and the recency queue,
+ * each in reverse order of their release. Chunks that were only read ahead
+ * are skipped. Returns the number of addresses written.
+ */
+uint64_t shfs_cache_rank(chk_t *out, uint64_t max);
+
+/*
+ * Read-ahead state of a stream (e.g., a HTTP session)
+ * The read-ahead window of a stream is doubled (up to SHFS_CACHE_READAHEAD_MAX)
+ * whenever a read-ahead is triggered by a sequential access and it is halved
+ * on each random access. Accesses without a stream state (ra = NULL) use the
+ * static window of SHFS_CACHE_READAHEAD chunks.
+ */
+struct shfs_cache_rastate {
+	chk_t next;      /* expected address of the next sequential access (0 = unknown) */
+	chk_t end;       /* read-ahead stops before this address (0 = end of volume) */
+	uint32_t window; /* current read-ahead window (number of chunks) */
+};
+
+static inline void shfs_cache_rastate_init(struct shfs_cache_rastate *ra)
+{
+	ra->next = 0;
+	ra->end = 0;
+	ra->window = SHFS_CACHE_READAHEAD;
+}
 
 /*
  * Function to read one chunk from the SHFS volume through the cache
@@ -189,10 +300,15 @@ void shfs_free_cache(void);
  * why shfs_cache_release() needs to be called after the buffer is not required
  * anymore.
  *
+ * shfs_cache_aread_ra() additionally adapts the read-ahead window to the
+ * access pattern of the stream described by ra.
+ *
  * Note: This cache implementation can only be used for read-only operation
  *       because buffers can be shared.
  */
-int shfs_cache_aread(chk_t addr, shfs_aiocb_t *cb, void *cb_cookie, void *cb_argp, struct shfs_cache_entry **cce_out, SHFS_AIO_TOKEN **t_out);
+int shfs_cache_aread_ra(chk_t addr, struct shfs_cache_rastate *ra, shfs_aiocb_t *cb, void *cb_cookie, void *cb_argp, struct shfs_cache_entry **cce_out, SHFS_AIO_TOKEN **t_out);
+#define shfs_cache_aread(addr, cb, cb_cookie, cb_argp, cce_out, t_out) \
+	shfs_cache_aread_ra((addr), NULL, (cb), (cb_cookie), (cb_argp), (cce_out), (t_out))
 
 /*
  * Function to retrieve a blank SHFS buffer from the cache for custom I/O
@@ -207,6 +323,11 @@ int shfs_cache_aread(chk_t addr, shfs_aiocb_t *cb, void *cb_cookie, void *cb_arg
  */
 int shfs_cache_eblank(struct shfs_cache_entry **cce_out);
 
+/* Takes an additional reference on a cache buffer that is already referenced
+ * by the caller (e.g., to keep its data alive while it is in flight).
+ * The reference is dropped again with shfs_cache_release() */
+void shfs_cache_ref(struct shfs_cache_entry *cce); /* Note: I/O needs to be done! */
+
 /* Release a shfs cache buffer */
 void shfs_cache_release(struct shfs_cache_entry *cce); /* Note: I/O needs to be done! */
 void shfs_cache_release_ioabort(struct shfs_cache_entry *cce, SHFS_AIO_TOKEN *t); /* I/O can be still in progress */
@@ -63,7 +63,8 @@ int shfs_detect_hdr0(void *chk0) {
 	/* Check for compatible version */
 	if (hdr_common->version[0] != SHFS_MAJOR)
 		return -2;
-	if (hdr_common->version[1] != SHFS_MINOR)
+	if (hdr_common->version[1] < SHFS_MINOR_COMPAT ||
+	    hdr_common->version[1] > SHFS_MINOR)
 		return -2;
 
 	/* Check Endianess */
@@ -72,6 +72,11 @@ typedef uint64_t strp_t;
 #define SALLOC_FIRSTFIT  0
 #define SALLOC_BESTFIT   1
 
+/* htable bucket mode (values are equal to HTABLE_BKT_*) */
+#define SBKT_MODULO      0
+#define SBKT_POW2        1
+#define SBKT_FASTRANGE   2
+
 /* hash function */
 #define SHFUNC_MANUAL    1
 #define SHFUNC_SHA       2
@@ -128,7 +133,8 @@ struct shfs_host {
 #define SHFS_MAGIC2 'F'
 #define SHFS_MAGIC3 'S'
 #define SHFS_MAJOR 0x02
-#define SHFS_MINOR 0x01
+#define SHFS_MINOR 0x02
+#define SHFS_MINOR_COMPAT 0x01 /* oldest supported minor version (modulo bucket mode only) */
 
 /* member_stripemode */
 #define SHFS_SM_INDEPENDENT 0x0
@@ -165,6 +171,7 @@ struct shfs_hdr_config {
 	uint32_t           htable_bucket_count;
 	uint32_t           htable_entries_per_bucket;
 	uint8_t            allocator;
+	uint8_t            htable_bucket_mode; /* since v2.02, 0 (modulo) on older volumes */
 } __attribute__((packed));
 
 /**
@@ -224,6 +231,16 @@ struct shfs_hentry {
 	((hdr_config)->htable_entries_per_bucket * (hdr_config)->htable_bucket_count)
 #define SHFS_HTABLE_SIZE_CHUNKS(hdr_config, chunksize) \
 	DIV_ROUND_UP(SHFS_HTABLE_NB_ENTRIES((hdr_config)), SHFS_HENTRIES_PER_CHUNK((chunksize)))
+/* the bucket mode field was introduced with v2.02: it is ignored on older
+ * volumes because their mkfs did not necessarily set it to zero */
+#define SHFS_HTABLE_BUCKET_MODE(vol_minor, hdr_config) \
+	((vol_minor) < SHFS_MINOR ? SBKT_MODULO : (hdr_config)->htable_bucket_mode)
+#define SHFS_HTABLE_BUCKET_MODE_VALID(bkt_mode, hdr_config) \
+	((bkt_mode) == SBKT_MODULO || \
+	 (bkt_mode) == SBKT_FASTRANGE || \
+	 ((bkt_mode) == SBKT_POW2 && \
+	  (hdr_config)->htable_bucket_count && \
+	  !((hdr_config)->htable_bucket_count & ((hdr_config)->htable_bucket_count - 1))))
 
 #define SHFS_HTABLE_CHUNK_NO(hentry_no, hentries_per_chunk) \
 	((hentry_no) / (hentries_per_chunk))
@@ -236,6 +253,8 @@ struct shfs_hentry {
 	((hentry)->flags & (SHFS_EFLAG_DEFAULT))
 #define SHFS_HENTRY_ISLINK(hentry) \
 	((hentry)->flags & (SHFS_EFLAG_LINK))
+#define SHFS_HENTRY_ISVARIANT(hentry) \
+	(!SHFS_HENTRY_ISLINK((hentry)) && (hentry)->f_attr.encoding[0] != '\0')
 
 #define SHFS_HENTRY_LINKATTR(hentry) \
 	((hentry)->l_attr)
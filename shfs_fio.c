@@ -53,6 +53,7 @@ static inline SHFS_FD _shfs_fio_open_bentry(struct shfs_bentry *bentry)
 #ifdef SHFS_STATS
 	struct shfs_el_stats *estats;
 #endif
+	int ret;
 
 	if (bentry->update) {
 		/* entry update in progress */
@@ -63,9 +64,20 @@ static inline SHFS_FD _shfs_fio_open_bentry(struct shfs_bentry *bentry)
 		return NULL;
 	}
 
+	if (bentry->refcount == 0) {
+		/* keep hash table entry in memory while the file is open */
+		ret = shfs_bentry_pin(bentry);
+		if (unlikely(ret < 0)) {
+			errno = -ret;
+			return NULL;
+		}
+	}
+
 	++shfs_nb_open;
 	if (bentry->refcount == 0) {
+#ifndef SHFS_BENTRY_COMPACT
 		trydown(&bentry->updatelock); /* lock file for updates */
+#endif
 		shfs_fio_clear_cookie(bentry);
 	}
 	++bentry->refcount;
@@ -137,7 +149,9 @@ SHFS_FD shfs_fio_open(const char *path)
 #endif
 		} else {
 #ifdef SHFS_OPENBYNAME
-			bentry = shfs_btable_lookup_byname(shfs_vol.bt, shfs_vol.htable_chunk_cache, path);
+			bentry = shfs_lookup_bentry_byname(path);
+			if (unlikely(!bentry && errno == EAGAIN))
+				return NULL; /* hash table chunk is being loaded */
 #else
 			bentry = NULL;
 #ifdef SHFS_STATS
@@ -168,6 +182,22 @@ SHFS_FD shfs_fio_openh(hash512_t h)
 	return _shfs_fio_open_bentry(bentry);
 }
 
+#ifdef SHFS_VARIANTS
+SHFS_FD shfs_fio_openv(SHFS_FD v)
+{
+	if (!v) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (!shfs_mounted) {
+		errno = ENODEV;
+		return NULL;
+	}
+
+	return _shfs_fio_open_bentry((struct shfs_bentry *) v);
+}
+#endif
+
 /*
  * Opens a clone of an already opened file descriptor
  * This clone has to be closed by shfs_fio_close(), too.
@@ -196,8 +226,15 @@ void shfs_fio_close(SHFS_FD f)
 	struct shfs_bentry *bentry = (struct shfs_bentry *) f;
 
 	--bentry->refcount;
-	if (bentry->refcount == 0) /* unlock file for updates */
+	if (bentry->refcount == 0) { /* unlock file for updates */
+#ifdef SHFS_BENTRY_COMPACT
+		if (bentry->update)
+			up(&shfs_vol.updatewait);
+#else
 		up(&bentry->updatelock);
+#endif
+		shfs_bentry_unpin(bentry);
+	}
 	--shfs_nb_open;
 }
 
@@ -221,6 +258,23 @@ void shfs_fio_mime(SHFS_FD f, char *out, size_t outlen)
 	out[outlen - 1] = '\0';
 }
 
+#ifdef SHFS_VARIANTS
+int shfs_fio_encoding(SHFS_FD f, char *out, size_t outlen)
+{
+	struct shfs_bentry *bentry = (struct shfs_bentry *) f;
+	struct shfs_hentry *hentry = shfs_bentry_hentry_nowait(bentry); /* f might not be opened */
+
+	if (unlikely(!hentry) || SHFS_HENTRY_ISLINK(hentry)) {
+		out[0] = '\0';
+		return (!hentry && errno == EAGAIN) ? -EAGAIN : 0;
+	}
+	outlen = min(outlen, sizeof(hentry->f_attr.encoding) + 1);
+	strncpy(out, hentry->f_attr.encoding, outlen - 1);
+	out[outlen - 1] = '\0';
+	return 0;
+}
+#endif
+
 void shfs_fio_size(SHFS_FD f, uint64_t *out)
 {
 	struct shfs_bentry *bentry = (struct shfs_bentry *) f;
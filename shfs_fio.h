@@ -54,6 +54,10 @@ typedef struct shfs_bentry *SHFS_FD;
  *
  * Hash: "?024a5bec"
  * Name: "index.html"
+ *
+ * With a lazily loaded hash table (SHFS_HTABLE_LAZY), the open functions
+ * fail with errno set to EAGAIN while the hash table chunk of the object
+ * is read from the device. The open has to be retried later.
  */
 SHFS_FD shfs_fio_open(const char *path);
 /**
@@ -74,6 +78,8 @@ void shfs_fio_hash(SHFS_FD f, hash512_t out);
 #define shfs_fio_islink(f) \
 	(SHFS_HENTRY_ISLINK((f)->hentry))
 void shfs_fio_size(SHFS_FD f, uint64_t *out); /* returns 0 on links */
+#define shfs_fio_ts_creation(f) \
+	((f)->hentry->ts_creation)
 
 /**
  * Link object attributes
@@ -93,6 +99,30 @@ void shfs_fio_link_rpath(SHFS_FD f, char *out, size_t outlen); /* null-terminati
  */
 void shfs_fio_mime(SHFS_FD f, char *out, size_t outlen); /* null-termination is ensured */
 
+#ifdef SHFS_VARIANTS
+/**
+ * Pre-encoded variants
+ * A variant is an object with the same name as its (identity) object but with
+ * a content encoding set. Variants are not opened by name but by walking
+ * the variant list of the object that was opened by name or hash.
+ */
+#define shfs_fio_isvariant(f) \
+	(SHFS_HENTRY_ISVARIANT((f)->hentry))
+/* next variant of an object (NULL if there are no more) */
+#define shfs_fio_vnext(f) \
+	((f)->vnext)
+/* object is one of multiple representations */
+#define shfs_fio_hasvariants(f) \
+	(shfs_fio_isvariant((f)) || shfs_fio_vnext((f)) != NULL)
+/* null-termination is ensured, -EAGAIN is returned while the hash table
+ * chunk of a (not opened) variant is loaded (see: shfs_fio_open()) */
+int shfs_fio_encoding(SHFS_FD f, char *out, size_t outlen);
+/**
+ * Opens a variant returned by shfs_fio_vnext()
+ */
+SHFS_FD shfs_fio_openv(SHFS_FD v);
+#endif
+
 /* file container size in chunks */
 #define shfs_fio_size_chks(f) \
 	(DIV_ROUND_UP(((f)->hentry->f_attr.offset + (f)->hentry->f_attr.len), shfs_vol.chunksize))
@@ -128,6 +158,23 @@ static inline int shfs_fio_set_cookie(SHFS_FD f, void *cookie) {
 #define shfs_fio_clear_cookie(f) \
   do { (f)->cookie = NULL; } while (0)
 
+/**
+ * Persistent file cookies
+ * In contrast to file cookies, they are kept when the last file descriptor
+ * is closed. The memory has to be allocated with target_malloc(), SHFS
+ * releases it when the object is updated by a remount or on unmount.
+ * Upper layers that attach further resources to their cookies can
+ * replace the release function (see: shfs_pcookie_release).
+ */
+#define shfs_fio_get_pcookie(f) \
+	((f)->pcookie)
+static inline int shfs_fio_set_pcookie(SHFS_FD f, void *pcookie) {
+  if (f->pcookie)
+    return -EBUSY;
+  f->pcookie = pcookie;
+  return 0;
+}
+
 /*
  * Simple but synchronous file read
  * Note: Busy-waiting is used
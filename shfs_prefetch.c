@@ -0,0 +1,252 @@
+/*
+ * Simple hash filesystem (SHFS)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#include <target/sys.h>
+
+#include "shfs_prefetch.h"
+#include "shfs_cache.h"
+#include "shfs_btable.h"
+#include "shfs_fio.h"
+#include "shfs_stats.h"
+#include "shfs.h"
+#include "shell.h"
+
+#ifdef SHFS_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include "debug.h"
+
+#define SHFS_PREFETCH_MAXLEN (SHFS_PREFETCH_NB_OBJS * SHFS_PREFETCH_NB_CHUNKS)
+
+static struct {
+	/* ranking pass */
+	struct htable_el *cursor; /* next element to rank (NULL: no pass running) */
+	struct shfs_bentry *top[SHFS_PREFETCH_NB_OBJS]; /* ordered by score, descending */
+	unsigned int nb_top;
+	uint64_t ts_pass; /* start of the last pass */
+
+	/* prefetch list */
+	chk_t list[SHFS_PREFETCH_MAXLEN];
+	unsigned int pos;
+	unsigned int len;
+	struct {
+		struct shfs_cache_entry *cce;
+		SHFS_AIO_TOKEN *t;
+	} infly[SHFS_PREFETCH_MAXINFLY];
+	unsigned int nb_infly;
+	int suspended; /* no new reads and passes (e.g., remount in progress) */
+
+	uint64_t nb_pass;
+	uint64_t nb_read;
+	uint64_t nb_hit;
+	uint64_t nb_busy;
+} _pf;
+
+static inline void _pf_rank(struct shfs_bentry *bentry)
+{
+	uint32_t h = shfs_stats_from_bentry(bentry)->h;
+	unsigned int i;
+
+	if (unlikely(h < bentry->pf_h)) {
+		/* stats of this entry were reset (e.g., object was replaced) */
+		bentry->pf_h = 0;
+		bentry->pf_score = 0;
+	}
+	bentry->pf_score = (bentry->pf_score >> 1) + (h - bentry->pf_h);
+	bentry->pf_h = h;
+
+	if (!bentry->pf_score || bentry->update ||
+	    !bentry->hentry || /* hash table chunk not resident */
+	    SHFS_HENTRY_ISLINK(bentry->hentry) || !bentry->hentry->f_attr.len)
+		return;
+	if (_pf.nb_top == SHFS_PREFETCH_NB_OBJS &&
+	    bentry->pf_score <= _pf.top[SHFS_PREFETCH_NB_OBJS - 1]->pf_score)
+		return;
+
+	/* insertion into the ordered top list */
+	i = (_pf.nb_top < SHFS_PREFETCH_NB_OBJS) ? _pf.nb_top++ : SHFS_PREFETCH_NB_OBJS - 1;
+	while (i > 0 && _pf.top[i - 1]->pf_score < bentry->pf_score) {
+		_pf.top[i] = _pf.top[i - 1];
+		--i;
+	}
+	_pf.top[i] = bentry;
+}
+
+static inline void _pf_build_list(void)
+{
+	struct shfs_bentry *bentry;
+	uint64_t max, nb_chks;
+	unsigned int i;
+	chk_t c;
+
+	max = shfs_cache_nb_buffers() / SHFS_PREFETCH_CAPDIV;
+	if (max > SHFS_PREFETCH_MAXLEN)
+		max = SHFS_PREFETCH_MAXLEN;
+
+	_pf.len = 0;
+	for (i = 0; i < _pf.nb_top; ++i) {
+		bentry = _pf.top[i];
+		if (!bentry->hentry)
+			continue; /* hash table chunk was evicted meanwhile */
+		nb_chks = shfs_fio_size_chks(bentry);
+		if (nb_chks > SHFS_PREFETCH_NB_CHUNKS)
+			nb_chks = SHFS_PREFETCH_NB_CHUNKS;
+		for (c = 0; c < nb_chks && _pf.len < max; ++c)
+			_pf.list[_pf.len++] = shfs_volchk_fchk(bentry, c);
+	}
+	_pf.pos = 0;
+	_pf.nb_top = 0;
+}
+
+void shfs_prefetch_stop(void)
+{
+	while (_pf.nb_infly) {
+		--_pf.nb_infly;
+		shfs_cache_release_ioabort(_pf.infly[_pf.nb_infly].cce,
+		                           _pf.infly[_pf.nb_infly].t);
+	}
+	_pf.cursor = NULL;
+	_pf.nb_top = 0;
+	_pf.pos = 0;
+	_pf.len = 0;
+}
+
+void shfs_prefetch_suspend(void)
+{
+	_pf.suspended = 1;
+	shfs_prefetch_stop();
+}
+
+void shfs_prefetch_resume(void)
+{
+	_pf.suspended = 0;
+}
+
+void shfs_prefetch_poll(void)
+{
+	struct shfs_cache_rastate ra;
+	struct shfs_cache_entry *cce;
+	SHFS_AIO_TOKEN *t;
+	unsigned int i;
+	uint64_t now;
+	int ret;
+
+	if (unlikely(!shfs_mounted || _pf.suspended))
+		return;
+
+	/* reap completed reads */
+	for (i = 0; i < _pf.nb_infly; ) {
+		if (!shfs_aio_is_done(_pf.infly[i].t)) {
+			++i;
+			continue;
+		}
+		shfs_aio_finalize(_pf.infly[i].t);
+		shfs_cache_release(_pf.infly[i].cce);
+		_pf.infly[i] = _pf.infly[--_pf.nb_infly];
+	}
+
+	if (_pf.pos < _pf.len) {
+		if (_pf.nb_infly)
+			return; /* wait for the current batch */
+		if (mempool_free_count(shfs_vol.aiotoken_pool)
+		    != mempool_nb_objs(shfs_vol.aiotoken_pool)) {
+			++_pf.nb_busy;
+			return; /* volume is busy */
+		}
+
+		while (_pf.nb_infly < SHFS_PREFETCH_MAXINFLY && _pf.pos < _pf.len) {
+			/* objects are not read ahead beyond their first chunks */
+			ra.next = 0;
+			ra.end = 0;
+			ra.window = 0;
+			ret = shfs_cache_aread_ra(_pf.list[_pf.pos], &ra, NULL, NULL, NULL, &cce, &t);
+			if (ret == -EAGAIN)
+				break; /* retry on next call */
+			++_pf.pos;
+			if (ret < 0)
+				continue;
+			if (ret == 0) {
+				++_pf.nb_hit;
+				shfs_cache_release(cce);
+				continue;
+			}
+			++_pf.nb_read;
+			_pf.infly[_pf.nb_infly].cce = cce;
+			_pf.infly[_pf.nb_infly].t = t;
+			++_pf.nb_infly;
+		}
+		return;
+	}
+
+	if (!_pf.cursor) {
+		/* start a new ranking pass */
+		now = target_now_ns();
+		if (now < _pf.ts_pass + ((uint64_t) SHFS_PREFETCH_INTERVAL * 1000000))
+			return;
+		_pf.ts_pass = now;
+		_pf.cursor = shfs_vol.bt->head;
+		_pf.nb_top = 0;
+		if (!_pf.cursor)
+			return;
+	}
+	for (i = 0; i < SHFS_PREFETCH_SCAN && _pf.cursor; ++i) {
+		_pf_rank((struct shfs_bentry *) _pf.cursor->private);
+		_pf.cursor = _pf.cursor->next;
+	}
+	if (!_pf.cursor) {
+		/* pass completed */
+		_pf_build_list();
+		++_pf.nb_pass;
+		printd("Prefetching %u chunks of popular objects\n", _pf.len);
+	}
+}
+
+static int shcmd_shfs_prefetch_info(FILE *cio, int argc, char *argv[])
+{
+	fprintf(cio, " Ranking passes:               %16"PRIu64"%s\n", _pf.nb_pass,
+	        _pf.suspended ? " (suspended)" : (_pf.cursor ? " (running)" : ""));
+	fprintf(cio, " Prefetch progress:            %16u / %u\n", _pf.pos, _pf.len);
+	fprintf(cio, " Prefetch reads in flight:     %16u\n", _pf.nb_infly);
+	fprintf(cio, " Prefetch reads:               %16"PRIu64"\n", _pf.nb_read);
+	fprintf(cio, " Prefetch hits:                %16"PRIu64"\n", _pf.nb_hit);
+	fprintf(cio, " Deferred (volume busy):       %16"PRIu64"\n", _pf.nb_busy);
+	return 0;
+}
+
+int register_shfs_prefetch_tools(void)
+{
+	shell_register_cmd("prefetch-info", shcmd_shfs_prefetch_info);
+	return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Simple hash filesystem (SHFS)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _SHFS_PREFETCH_H_
+#define _SHFS_PREFETCH_H_
+
+#include "shfs_defs.h"
+
+#ifndef SHFS_STATS
+#error "SHFS_PREFETCH requires SHFS_STATS"
+#endif
+
+/*
+ * Popularity-driven prefetcher
+ *  Objects are ranked by a decaying popularity score that is derived from
+ *  the hit counters of the SHFS statistics: on every ranking pass, the score
+ *  is halved and the hits since the previous pass are added. A pass ranks
+ *  SHFS_PREFETCH_SCAN entries per call of shfs_prefetch_poll() and starts
+ *  at most every SHFS_PREFETCH_INTERVAL milliseconds. After a pass, the
+ *  first SHFS_PREFETCH_NB_CHUNKS chunks of the SHFS_PREFETCH_NB_OBJS most
+ *  popular objects are pulled into the chunk cache (at most
+ *  1/SHFS_PREFETCH_CAPDIV of the cache buffers).
+ *  Reads are only issued while the volume is idle (no other async I/O is in
+ *  flight) and at most SHFS_PREFETCH_MAXINFLY at a time, so that foreground
+ *  misses never queue behind more than a few prefetch reads.
+ */
+#ifndef SHFS_PREFETCH_NB_OBJS
+#define SHFS_PREFETCH_NB_OBJS 32
+#endif
+#ifndef SHFS_PREFETCH_NB_CHUNKS
+#define SHFS_PREFETCH_NB_CHUNKS 2
+#endif
+#ifndef SHFS_PREFETCH_INTERVAL
+#define SHFS_PREFETCH_INTERVAL 1000 /* ms */
+#endif
+#ifndef SHFS_PREFETCH_SCAN
+#define SHFS_PREFETCH_SCAN 512
+#endif
+#ifndef SHFS_PREFETCH_MAXINFLY
+#define SHFS_PREFETCH_MAXINFLY 2
+#endif
+#ifndef SHFS_PREFETCH_CAPDIV
+#define SHFS_PREFETCH_CAPDIV 4
+#endif
+
+/* drives ranking and prefetching, has to be called from the main loop */
+void shfs_prefetch_poll(void);
+/* aborts the current pass and releases in-flight reads
+ * Note: has to be called before the btable or the cache is modified */
+void shfs_prefetch_stop(void);
+/* like shfs_prefetch_stop() but shfs_prefetch_poll() stays idle until
+ * shfs_prefetch_resume() is called (e.g., while the hash table is re-read) */
+void shfs_prefetch_suspend(void);
+void shfs_prefetch_resume(void);
+
+int register_shfs_prefetch_tools(void);
+
+#endif /* _SHFS_PREFETCH_H_ */
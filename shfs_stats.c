@@ -52,7 +52,8 @@
 int shfs_init_mstats(uint32_t nb_bkts, uint32_t ent_per_bkt, uint8_t hlen)
 {
 	shfs_vol.mstats.el_ht = alloc_htable(nb_bkts, ent_per_bkt, hlen,
-	                                     sizeof(struct shfs_el_stats), 0);
+	                                     sizeof(struct shfs_el_stats), 0,
+	                                     HTABLE_BKT_FASTRANGE); /* in-memory only */
 	if (!shfs_vol.mstats.el_ht)
 		return -errno;
 	shfs_vol.mstats.i = 0;
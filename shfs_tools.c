@@ -67,9 +67,9 @@ static int shcmd_shfs_ls(FILE *cio, int argc, char *argv[])
 
 	foreach_htable_el(shfs_vol.bt, el) {
 		bentry = el->private;
-		hentry = (struct shfs_hentry *)
-			((uint8_t *) shfs_vol.htable_chunk_cache[bentry->hentry_htchunk]
-			 + bentry->hentry_htoffset);
+		hentry = shfs_bentry_hentry(bentry);
+		if (!hentry)
+			continue; /* hash table chunk could not be loaded */
 		hash_unparse(*el->h, shfs_vol.hlen, str_hash);
 		strncpy(str_name, hentry->name, sizeof(hentry->name));
 		strftimestamp_s(str_date, sizeof(str_date),
@@ -495,8 +495,31 @@ static int shcmd_shfs_prefetch_cache(FILE *cio, int argc, char *argv[])
 	return ret;
 }
 
+/*
+ * Memory that is occupied by the object metadata of the mounted volume
+ * (btable, resident hash table chunks and indexes)
+ */
+static uint64_t shfs_metadata_size(void)
+{
+	uint64_t size;
+
+	size  = shfs_vol.bt->mem_size;
+	size += sizeof(void *) * shfs_vol.htable_len; /* chunk references */
+#ifdef SHFS_HTABLE_LAZY
+	size += sizeof(struct shfs_htchunk) * shfs_vol.htable_len;
+	size += (uint64_t) shfs_vol.chunksize * shfs_vol.htable_nb_resident;
+#else
+	size += (uint64_t) shfs_vol.chunksize * shfs_vol.htable_len;
+#endif
+#ifdef SHFS_NAMEINDEX
+	size += sizeof(struct shfs_bentry *) * ((uint64_t) shfs_vol.nindex_mask + 1);
+#endif
+	return size;
+}
+
 static int shcmd_shfs_info(FILE *cio, int argc, char *argv[])
 {
+	uint64_t mdsize;
 	unsigned int m;
 	char str_uuid[37];
 	char str_date[20];
@@ -529,8 +552,17 @@ static int shcmd_shfs_info(FILE *cio, int argc, char *argv[])
 	        shfs_vol.htable_nb_entries, shfs_vol.htable_nb_buckets,
 	        shfs_vol.htable_len, (shfs_vol.htable_len * shfs_vol.chunksize) / 1024,
 	        shfs_vol.htable_bak_ref ? "2nd copy enabled" : "No copy");
+#ifdef SHFS_HTABLE_LAZY
+	fprintf(cio, "                    %"PRIchk" of max. %u chunks resident\n",
+	        shfs_vol.htable_nb_resident, SHFS_HTABLE_LAZY_NB_CHUNKS);
+#endif
 	fprintf(cio, "Entry size:         %u Bytes (raw: %zu Bytes)\n",
 	        SHFS_HENTRY_SIZE, sizeof(struct shfs_hentry));
+	mdsize = shfs_metadata_size();
+	fprintf(cio, "Metadata in memory: %"PRIu64" KiB (%"PRIu64" Bytes per entry)\n" \
+	        "                    bucket entry: %zu Bytes\n",
+	        mdsize / 1024, mdsize / shfs_vol.htable_nb_entries,
+	        sizeof(struct shfs_bentry));
 
 	fprintf(cio, "\n");
 	fprintf(cio, "Member stripe size: %"PRIu32" KiB\n", shfs_vol.stripesize / 1024);
@@ -0,0 +1,449 @@
+/*
+ * Simple hash filesystem (SHFS)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#include <target/sys.h>
+#include <target/blkdev.h>
+
+#include "shfs_warm.h"
+#include "shfs_cache.h"
+#include "shfs_tools.h"
+#include "shfs.h"
+#include "shell.h"
+
+#ifdef SHFS_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include "debug.h"
+
+static struct {
+	struct blkdev *bd; /* snapshot device (NULL: in-memory only) */
+	void *hdrbuf;
+	uint64_t dev_max; /* max number of addresses that fit on the device */
+
+	chk_t *list; /* ranked chunk addresses, hottest first */
+	uint64_t list_size;
+	uint64_t len; /* number of addresses of the snapshot */
+	uuid_t vol_uuid; /* volume the snapshot belongs to */
+	uint32_t chunksize;
+
+	/* replay */
+	uint64_t pos;
+	uint64_t end;
+	uint64_t ts_next;
+	struct {
+		struct shfs_cache_entry *cce;
+		SHFS_AIO_TOKEN *t;
+	} infly[SHFS_CACHE_WARM_MAXINFLY];
+	unsigned int nb_infly;
+	uint64_t nb_read;
+	uint64_t nb_hit;
+	uint64_t nb_err;
+} _warm;
+
+/* list is allocated in multiples of SHFS_WARM_IOLEN so that it
+ * can be transferred from/to the device directly */
+#define _warm_iolen(nb) \
+	(((((nb) * sizeof(chk_t)) + SHFS_WARM_IOLEN - 1) / SHFS_WARM_IOLEN) * SHFS_WARM_IOLEN)
+
+static int _warm_reserve(uint64_t nb)
+{
+	chk_t *list;
+	size_t len;
+
+	if (nb <= _warm.list_size && _warm.list)
+		return 0;
+
+	len = _warm_iolen(nb ? nb : 1);
+	list = target_malloc(_warm.bd ? blkdev_ioalign(_warm.bd) : sizeof(chk_t), len);
+	if (!list)
+		return -ENOMEM;
+	if (_warm.list)
+		target_free(_warm.list);
+	_warm.list = list;
+	_warm.list_size = len / sizeof(chk_t);
+	_warm.len = 0;
+	return 0;
+}
+
+static int _warm_dev_io(uint64_t off, size_t len, int write, void *buf)
+{
+	sector_t ssize = blkdev_ssize(_warm.bd);
+	size_t pos;
+	int ret;
+
+	/* one SHFS_WARM_IOLEN unit per request */
+	for (pos = 0; pos < len; pos += SHFS_WARM_IOLEN) {
+		ret = blkdev_sync_io(_warm.bd, (off + pos) / ssize, SHFS_WARM_IOLEN / ssize,
+		                     write, (uint8_t *) buf + pos); /* yields CPU */
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+int shfs_warm_save(void)
+{
+	struct shfs_warm_hdr *hdr = _warm.hdrbuf;
+	uint64_t max;
+	int ret;
+
+	if (!shfs_mounted)
+		return -ENODEV;
+
+	/* a new snapshot replaces the one that is replayed */
+	shfs_warm_stop();
+	ret = _warm_reserve(shfs_cache_nb_buffers());
+	if (ret < 0)
+		return ret;
+	max = _warm.list_size;
+	if (_warm.bd && max > _warm.dev_max)
+		max = _warm.dev_max;
+	_warm.len = shfs_cache_rank(_warm.list, max);
+	_warm.pos = 0;
+	_warm.end = 0;
+	uuid_copy(_warm.vol_uuid, shfs_vol.uuid);
+	_warm.chunksize = shfs_vol.chunksize;
+	printd("Snapshot of %"PRIu64" cached chunks taken\n", _warm.len);
+
+	if (!_warm.bd)
+		return 0;
+	/* the address list is overwritten in place: invalidate the header
+	 * first and write the valid one last, so that an interrupted save
+	 * leaves no header that describes a mix of old and new addresses */
+	memset(hdr, 0, SHFS_WARM_IOLEN);
+	ret = _warm_dev_io(0, SHFS_WARM_IOLEN, 1, hdr);
+	if (ret < 0)
+		return ret;
+	if (_warm.len) {
+		ret = _warm_dev_io(SHFS_WARM_IOLEN, _warm_iolen(_warm.len), 1, _warm.list);
+		if (ret < 0)
+			return ret;
+	}
+	hdr->magic[0] = SHFS_WARM_MAGIC0;
+	hdr->magic[1] = SHFS_WARM_MAGIC1;
+	hdr->magic[2] = SHFS_WARM_MAGIC2;
+	hdr->magic[3] = SHFS_WARM_MAGIC3;
+	hdr->version = SHFS_WARM_VERSION;
+	uuid_copy(hdr->vol_uuid, _warm.vol_uuid);
+	hdr->chunksize = _warm.chunksize;
+	hdr->nb_chunks = _warm.len;
+	return _warm_dev_io(0, SHFS_WARM_IOLEN, 1, hdr);
+}
+
+int shfs_warm_load(void)
+{
+	struct shfs_warm_hdr *hdr = _warm.hdrbuf;
+	uint64_t nb, i, j;
+	int ret;
+
+	if (!_warm.bd)
+		return -ENODEV;
+	if (!shfs_mounted)
+		return -ENODEV;
+
+	shfs_warm_stop();
+	ret = _warm_dev_io(0, SHFS_WARM_IOLEN, 0, hdr);
+	if (ret < 0)
+		return ret;
+	if (hdr->magic[0] != SHFS_WARM_MAGIC0 ||
+	    hdr->magic[1] != SHFS_WARM_MAGIC1 ||
+	    hdr->magic[2] != SHFS_WARM_MAGIC2 ||
+	    hdr->magic[3] != SHFS_WARM_MAGIC3 ||
+	    hdr->version != SHFS_WARM_VERSION) {
+		printd("No cache snapshot found\n");
+		return -ENOENT;
+	}
+	if (uuid_compare(hdr->vol_uuid, shfs_vol.uuid) != 0 ||
+	    hdr->chunksize != shfs_vol.chunksize) {
+		printd("Cache snapshot belongs to a different volume\n");
+		return -ESTALE;
+	}
+
+	/* the replay cannot load more chunks than the cache holds */
+	nb = min(hdr->nb_chunks, shfs_cache_nb_buffers());
+	nb = min(nb, _warm.dev_max);
+	ret = _warm_reserve(nb);
+	if (ret < 0)
+		return ret;
+	_warm.len = 0;
+	if (nb) {
+		ret = _warm_dev_io(SHFS_WARM_IOLEN, _warm_iolen(nb), 0, _warm.list);
+		if (ret < 0)
+			return ret;
+	}
+	/* drop addresses that are not part of the volume (corrupted snapshot) */
+	for (i = 0, j = 0; i < nb; ++i) {
+		if (unlikely(_warm.list[i] == 0 || _warm.list[i] > shfs_vol.volsize))
+			continue;
+		_warm.list[j++] = _warm.list[i];
+	}
+	if (j != nb)
+		printd("Dropped %"PRIu64" invalid chunk addresses of the cache snapshot\n",
+		       nb - j);
+	nb = j;
+	_warm.len = nb;
+	_warm.pos = 0;
+	_warm.end = 0;
+	uuid_copy(_warm.vol_uuid, hdr->vol_uuid);
+	_warm.chunksize = hdr->chunksize;
+	printd("Cache snapshot of %"PRIu64" chunks loaded\n", nb);
+	return 0;
+}
+
+void shfs_warm_start(void)
+{
+	uint64_t max;
+
+	shfs_warm_stop();
+	if (!shfs_mounted || !_warm.len ||
+	    uuid_compare(_warm.vol_uuid, shfs_vol.uuid) != 0 ||
+	    _warm.chunksize != shfs_vol.chunksize)
+		return;
+
+	max = (shfs_cache_nb_buffers() * SHFS_CACHE_WARM_FILL) / 100;
+	_warm.pos = 0;
+	_warm.end = min(_warm.len, max);
+	_warm.ts_next = 0;
+	_warm.nb_read = 0;
+	_warm.nb_hit = 0;
+	_warm.nb_err = 0;
+	printd("Replaying %"PRIu64" chunks of the cache snapshot...\n", _warm.end);
+}
+
+void shfs_warm_stop(void)
+{
+	while (_warm.nb_infly) {
+		--_warm.nb_infly;
+		shfs_cache_release_ioabort(_warm.infly[_warm.nb_infly].cce,
+		                           _warm.infly[_warm.nb_infly].t);
+	}
+	_warm.end = _warm.pos;
+}
+
+void shfs_warm_poll(void)
+{
+	struct shfs_cache_rastate ra;
+	struct shfs_cache_entry *cce;
+	SHFS_AIO_TOKEN *t;
+	unsigned int i, n;
+	uint64_t now;
+	int ret;
+
+	if (likely(_warm.pos == _warm.end && !_warm.nb_infly))
+		return;
+	if (unlikely(!shfs_mounted))
+		return;
+
+	/* reap completed reads */
+	for (i = 0; i < _warm.nb_infly; ) {
+		if (!shfs_aio_is_done(_warm.infly[i].t)) {
+			++i;
+			continue;
+		}
+		ret = shfs_aio_finalize(_warm.infly[i].t);
+		if (ret < 0)
+			++_warm.nb_err;
+		shfs_cache_release(_warm.infly[i].cce);
+		_warm.infly[i] = _warm.infly[--_warm.nb_infly];
+	}
+	if (_warm.pos == _warm.end)
+		return;
+
+	now = target_now_ns();
+	if (now < _warm.ts_next)
+		return;
+	_warm.ts_next = now + ((uint64_t) SHFS_CACHE_WARM_INTERVAL * 1000000);
+
+	for (n = 0; n < SHFS_CACHE_WARM_BATCH &&
+		    _warm.nb_infly < SHFS_CACHE_WARM_MAXINFLY &&
+		    _warm.pos < _warm.end; ++n) {
+		/* the snapshot contains the neighbours already: no read-ahead */
+		ra.next = 0;
+		ra.end = 0;
+		ra.window = 0;
+		ret = shfs_cache_aread_ra(_warm.list[_warm.pos], &ra, NULL, NULL, NULL, &cce, &t);
+		if (ret == -EAGAIN)
+			break; /* retry on next interval */
+		++_warm.pos;
+		if (ret < 0) {
+			++_warm.nb_err;
+			continue;
+		}
+		if (ret == 0) {
+			++_warm.nb_hit;
+			shfs_cache_release(cce);
+			continue;
+		}
+		++_warm.nb_read;
+		_warm.infly[_warm.nb_infly].cce = cce;
+		_warm.infly[_warm.nb_infly].t = t;
+		++_warm.nb_infly;
+	}
+	if (_warm.pos == _warm.end)
+		printd("Cache snapshot replayed (read: %"PRIu64", hit: %"PRIu64", err: %"PRIu64")\n",
+		       _warm.nb_read, _warm.nb_hit, _warm.nb_err);
+}
+
+static int shcmd_shfs_warm_save(FILE *cio, int argc, char *argv[])
+{
+	int ret;
+
+	down(&shfs_mount_lock);
+	if (!shfs_mounted) {
+		fprintf(cio, "No SHFS filesystem is mounted\n");
+		ret = -1;
+		goto out;
+	}
+	ret = shfs_warm_save();
+	if (ret < 0) {
+		fprintf(cio, "Could not save cache snapshot: %s\n", strerror(-ret));
+		ret = -1;
+		goto out;
+	}
+	fprintf(cio, "Saved %"PRIu64" chunk addresses\n", _warm.len);
+ out:
+	up(&shfs_mount_lock);
+	return ret;
+}
+
+static int shcmd_shfs_warm_load(FILE *cio, int argc, char *argv[])
+{
+	int ret;
+
+	down(&shfs_mount_lock);
+	if (!shfs_mounted) {
+		fprintf(cio, "No SHFS filesystem is mounted\n");
+		ret = -1;
+		goto out;
+	}
+	ret = shfs_warm_load();
+	if (ret < 0) {
+		fprintf(cio, "Could not load cache snapshot: %s\n", strerror(-ret));
+		ret = -1;
+		goto out;
+	}
+	shfs_warm_start();
+ out:
+	up(&shfs_mount_lock);
+	return ret;
+}
+
+static int shcmd_shfs_warm_info(FILE *cio, int argc, char *argv[])
+{
+	char str_bdid[64];
+
+	if (_warm.bd) {
+		blkdev_id_unparse(blkdev_id(_warm.bd), str_bdid, sizeof(str_bdid));
+		fprintf(cio, " Snapshot device:              %16s (max %"PRIu64" chunks)\n",
+		        str_bdid, _warm.dev_max);
+	} else {
+		fprintf(cio, " Snapshot device:              %16s\n", "none");
+	}
+	fprintf(cio, " Chunks in snapshot:           %16"PRIu64"\n", _warm.len);
+	fprintf(cio, " Replay progress:              %16"PRIu64" / %"PRIu64"%s\n",
+	        _warm.pos, _warm.end,
+	        (_warm.pos == _warm.end && !_warm.nb_infly) ? "" : " (running)");
+	fprintf(cio, " Replay reads in flight:       %16u\n", _warm.nb_infly);
+	fprintf(cio, " Replay reads:                 %16"PRIu64"\n", _warm.nb_read);
+	fprintf(cio, " Replay hits:                  %16"PRIu64"\n", _warm.nb_hit);
+	fprintf(cio, " Replay errors:                %16"PRIu64"\n", _warm.nb_err);
+	return 0;
+}
+
+#ifdef HAVE_CTLDIR
+int register_shfs_warm_tools(struct ctldir *cd)
+#else
+int register_shfs_warm_tools(void)
+#endif
+{
+#ifdef HAVE_CTLDIR
+	if (cd) {
+		ctldir_register_shcmd(cd, "warm-save", shcmd_shfs_warm_save);
+		ctldir_register_shcmd(cd, "warm-load", shcmd_shfs_warm_load);
+	}
+#endif
+	shell_register_cmd("warm-save", shcmd_shfs_warm_save);
+	shell_register_cmd("warm-load", shcmd_shfs_warm_load);
+	shell_register_cmd("warm-info", shcmd_shfs_warm_info);
+
+	return 0;
+}
+
+int init_shfs_warm(blkdev_id_t bd_id)
+{
+	int ret;
+
+	/* exclusively open snapshot device for read and write */
+	_warm.bd = open_blkdev(bd_id, (O_RDWR | O_EXCL));
+	if (!_warm.bd) {
+		ret = -errno;
+		goto err_out;
+	}
+	if (SHFS_WARM_IOLEN % blkdev_ssize(_warm.bd) ||
+	    blkdev_size(_warm.bd) < 2 * SHFS_WARM_IOLEN) {
+		ret = -EINVAL;
+		goto err_close_bd;
+	}
+	_warm.hdrbuf = target_malloc(blkdev_ioalign(_warm.bd), SHFS_WARM_IOLEN);
+	if (!_warm.hdrbuf) {
+		ret = -ENOMEM;
+		goto err_close_bd;
+	}
+	_warm.dev_max = (blkdev_size(_warm.bd) - SHFS_WARM_IOLEN) / sizeof(chk_t);
+	_warm.dev_max -= _warm.dev_max % (SHFS_WARM_IOLEN / sizeof(chk_t));
+	return 0;
+
+ err_close_bd:
+	close_blkdev(_warm.bd);
+	_warm.bd = NULL;
+ err_out:
+	return ret;
+}
+
+void exit_shfs_warm(void)
+{
+	BUG_ON(_warm.nb_infly);
+
+	if (_warm.list)
+		target_free(_warm.list);
+	_warm.list = NULL;
+	_warm.list_size = 0;
+	_warm.len = 0;
+	if (_warm.bd) {
+		target_free(_warm.hdrbuf);
+		close_blkdev(_warm.bd);
+		_warm.bd = NULL;
+	}
+}
@@ -0,0 +1,111 @@
+/*
+ * Simple hash filesystem (SHFS)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _SHFS_WARM_H_
+#define _SHFS_WARM_H_
+
+#include <target/blkdev.h>
+#include "shfs_defs.h"
+#ifdef HAVE_CTLDIR
+#include <target/ctldir.h>
+#endif
+
+/*
+ * Warm cache
+ *  The addresses of the chunks that are loaded in the chunk cache are
+ *  ranked by shfs_cache_rank() and saved as a snapshot before the cache is
+ *  discarded (umount, remount). The snapshot is written to a block device
+ *  (or file) so that it survives reboots. After a mount, the snapshot is
+ *  replayed as a background prefetch from the main loop: at most
+ *  SHFS_CACHE_WARM_BATCH chunks are requested every SHFS_CACHE_WARM_INTERVAL
+ *  milliseconds with up to SHFS_CACHE_WARM_MAXINFLY reads in flight, and
+ *  the replay never fills more than SHFS_CACHE_WARM_FILL percent of the
+ *  cache buffers.
+ */
+#ifndef SHFS_CACHE_WARM_BATCH
+#define SHFS_CACHE_WARM_BATCH 8
+#endif
+#ifndef SHFS_CACHE_WARM_INTERVAL
+#define SHFS_CACHE_WARM_INTERVAL 10 /* ms */
+#endif
+#ifndef SHFS_CACHE_WARM_MAXINFLY
+#define SHFS_CACHE_WARM_MAXINFLY 16
+#endif
+#ifndef SHFS_CACHE_WARM_FILL
+#define SHFS_CACHE_WARM_FILL 90 /* percent */
+#endif
+
+#define SHFS_WARM_MAGIC0 'S'
+#define SHFS_WARM_MAGIC1 'H'
+#define SHFS_WARM_MAGIC2 'W'
+#define SHFS_WARM_MAGIC3 'C'
+#define SHFS_WARM_VERSION 1
+#define SHFS_WARM_IOLEN 4096 /* unit of snapshot device I/O (at least one sector) */
+
+/* snapshot header (at the beginning of the snapshot device),
+ * the chunk addresses follow at offset SHFS_WARM_IOLEN */
+struct shfs_warm_hdr {
+	uint8_t            magic[4];
+	uint8_t            version;
+	uuid_t             vol_uuid;
+	uint32_t           chunksize;
+	chk_t              nb_chunks;
+} __attribute__((packed));
+
+/*
+ * Opens the snapshot device. Without a device, snapshots are only kept in
+ * memory (e.g., across a remount).
+ */
+int init_shfs_warm(blkdev_id_t bd_id);
+void exit_shfs_warm(void);
+
+/*
+ * Note: The following functions have to be called with shfs_mount_lock held
+ */
+int  shfs_warm_save(void);  /* snapshot the cache (and write it to the device) */
+int  shfs_warm_load(void);  /* read the snapshot from the device */
+void shfs_warm_start(void); /* start replaying the current snapshot */
+void shfs_warm_stop(void);  /* stop replaying and release in-flight reads */
+
+/* drives the replay, has to be called from the main loop */
+void shfs_warm_poll(void);
+
+#ifdef HAVE_CTLDIR
+int register_shfs_warm_tools(struct ctldir *cd);
+#else
+int register_shfs_warm_tools(void);
+#endif
+
+#endif /* _SHFS_WARM_H_ */
@@ -0,0 +1,541 @@
+/*
+ * Linux block I/O glue (io_uring)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ *
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* O_DIRECT */
+#endif
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <target/blkdev.h>
+
+#ifdef BLKDEV_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include <debug.h>
+
+/* ring synchronization with the kernel */
+#define _ring_load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define _ring_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+struct blkdev *_open_bd_list = NULL;
+
+static inline int _io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+  return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int _io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+  return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static inline int _io_uring_register(int fd, unsigned int opcode, const void *arg, unsigned int nr_args)
+{
+  return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int blkdev_id_parse(const char *id, blkdev_id_t *out)
+{
+  /* get absolute path of file */
+  if (realpath(id, *out) == NULL) {
+    printd("Could not resolve path %s\n", id);
+    return -errno;
+  }
+  return 0;
+}
+
+static int _blkdev_ring_init(struct blkdev *bd)
+{
+  struct io_uring_params p;
+  uint8_t *sq_ring, *cq_ring;
+
+  memset(&p, 0, sizeof(p));
+  bd->ring_fd = _io_uring_setup(MAX_REQUESTS, &p);
+  if (bd->ring_fd < 0) {
+    printd("Could not setup io_uring for %s\n", bd->dev);
+    goto err_out;
+  }
+
+  bd->sq.ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  bd->cq.ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    /* completion ring shares the mapping with the submission ring */
+    if (bd->cq.ring_len > bd->sq.ring_len)
+      bd->sq.ring_len = bd->cq.ring_len;
+    bd->cq.ring_len = 0;
+  }
+  sq_ring = mmap(NULL, bd->sq.ring_len, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, bd->ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ring == MAP_FAILED)
+    goto err_close_ring;
+  if (bd->cq.ring_len) {
+    cq_ring = mmap(NULL, bd->cq.ring_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, bd->ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED)
+      goto err_unmap_sq;
+  } else {
+    cq_ring = sq_ring;
+  }
+  bd->sq.sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  bd->sq.sqes = mmap(NULL, bd->sq.sqes_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, bd->ring_fd, IORING_OFF_SQES);
+  if (bd->sq.sqes == MAP_FAILED)
+    goto err_unmap_cq;
+
+  bd->sq.ring  = sq_ring;
+  bd->sq.head  = (unsigned *) (sq_ring + p.sq_off.head);
+  bd->sq.tail  = (unsigned *) (sq_ring + p.sq_off.tail);
+  bd->sq.array = (unsigned *) (sq_ring + p.sq_off.array);
+  bd->sq.mask  = *((unsigned *) (sq_ring + p.sq_off.ring_mask));
+  bd->cq.ring  = cq_ring;
+  bd->cq.head  = (unsigned *) (cq_ring + p.cq_off.head);
+  bd->cq.tail  = (unsigned *) (cq_ring + p.cq_off.tail);
+  bd->cq.cqes  = (struct io_uring_cqe *) (cq_ring + p.cq_off.cqes);
+  bd->cq.mask  = *((unsigned *) (cq_ring + p.cq_off.ring_mask));
+  bd->sq_pending = 0;
+  bd->fixbuf_base = NULL;
+  bd->fixbuf_len = 0;
+  printd("%s: io_uring with %u SQ and %u CQ entries\n", bd->dev, p.sq_entries, p.cq_entries);
+  return 0;
+
+ err_unmap_cq:
+  if (cq_ring != sq_ring)
+    munmap(cq_ring, bd->cq.ring_len);
+ err_unmap_sq:
+  munmap(sq_ring, bd->sq.ring_len);
+ err_close_ring:
+  close(bd->ring_fd);
+ err_out:
+  return -1;
+}
+
+static void _blkdev_ring_exit(struct blkdev *bd)
+{
+  munmap(bd->sq.sqes, bd->sq.sqes_len);
+  if (bd->cq.ring != bd->sq.ring)
+    munmap(bd->cq.ring, bd->cq.ring_len);
+  munmap(bd->sq.ring, bd->sq.ring_len);
+  close(bd->ring_fd);
+}
+
+struct blkdev *open_blkdev(blkdev_id_t id, int mode)
+{
+  struct blkdev *bd;
+  int err;
+
+  /* search in blkdev list if device is already open */
+  for (bd = _open_bd_list; bd != NULL; bd = bd->_next) {
+    if (blkdev_id_cmp(blkdev_id(bd), id) == 0) {
+      /* found: device is already open,
+       *  now we check if it was/shall be opened
+       *  exclusively and requested permissions
+       *  are available */
+      if (mode & O_EXCL ||
+	  bd->exclusive) {
+	errno = EBUSY;
+	goto err;
+      }
+      if (((mode & O_WRONLY) && !(bd->mode & (O_WRONLY | O_RDWR))) ||
+	  ((mode & O_RDWR) && !(bd->mode & O_RDWR))) {
+	errno = EACCES;
+	goto err;
+      }
+
+      ++bd->refcount;
+      return bd;
+    }
+  }
+
+  /* device is not opened yet */
+  bd = malloc(sizeof(struct blkdev));
+  if (!bd) {
+    errno = ENOMEM;
+    goto err;
+  }
+
+  blkdev_id_cpy(bd->dev, id);
+#ifdef IOURINGBLK_DIRECT
+  bd->fd = open(bd->dev, (mode & (O_RDWR | O_WRONLY)) | O_DIRECT);
+  if (bd->fd < 0 && errno == EINVAL) {
+    /* e.g., tmpfs does not support direct I/O */
+    printd("%s does not support O_DIRECT, using buffered I/O\n", bd->dev);
+    bd->fd = open(bd->dev, mode & (O_RDWR | O_WRONLY));
+  }
+#else
+  bd->fd = open(bd->dev, mode & (O_RDWR | O_WRONLY));
+#endif
+  if (bd->fd < 0) {
+    printd("Could not open %s\n", bd->dev);
+    goto err_free_bd;
+  }
+
+  if (fstat(bd->fd, &bd->fd_stat) == -1) {
+    printd("Could not retrieve stats from %s\n", bd->dev);
+    goto err_close_fd;
+  }
+  if (!S_ISBLK(bd->fd_stat.st_mode) && !S_ISREG(bd->fd_stat.st_mode)) {
+    printd("%s is not a block device or a regular file\n", bd->dev);
+    errno = ENOTBLK;
+    goto err_close_fd;
+  }
+
+  /* get device sector size in bytes */
+  bd->ssize = bd->fd_stat.st_blksize;
+  printd("%s has a block size of %"PRIu32" bytes\n", bd->dev, bd->ssize);
+
+  /* get device size in bytes */
+  if (S_ISBLK(bd->fd_stat.st_mode)) {
+    err = ioctl(bd->fd, BLKGETSIZE64, &bd->size);
+    if (err) {
+      unsigned long size32;
+
+      printd("BLKGETSIZE64 failed. Trying BLKGETSIZE\n");
+      err = ioctl(bd->fd, BLKGETSIZE, &size32);
+      if (err) {
+	printd("Could not query device size from %s\n", bd->dev);
+	goto err_close_fd;
+      }
+      bd->size = ((uint64_t) size32 * 512) / bd->ssize; /* BLKGETSIZE returns 512 byte sectors */
+    } else {
+      bd->size /= bd->ssize; /* BLKGETSIZE64 returns bytes */
+    }
+  } else {
+    bd->size = ((uint64_t) bd->fd_stat.st_size) / bd->ssize;
+  }
+  printd("%s has a size of %"PRIu64" bytes\n", bd->dev, (uint64_t) (bd->size * bd->ssize));
+
+  bd->reqpool = alloc_simple_mempool(MAX_REQUESTS, sizeof(struct _blkdev_req));
+  if (!bd->reqpool) {
+    errno = ENOMEM;
+    goto err_close_fd;
+  }
+  if (_blkdev_ring_init(bd) < 0)
+    goto err_free_reqpool;
+  bd->mode = mode;
+  bd->refcount = 1;
+  bd->exclusive = !!(mode & O_EXCL);
+
+  /* link new element to the head of _open_bd_list */
+  bd->_prev = NULL;
+  bd->_next = _open_bd_list;
+  _open_bd_list = bd;
+  if (bd->_next)
+    bd->_next->_prev = bd;
+  return bd;
+
+ err_free_reqpool:
+  free_mempool(bd->reqpool);
+ err_close_fd:
+  close(bd->fd);
+ err_free_bd:
+  free(bd);
+ err:
+  return NULL;
+}
+
+void close_blkdev(struct blkdev *bd)
+{
+  --bd->refcount;
+  if (bd->refcount == 0) {
+    /* unlink element from _open_bd_list */
+    if (bd->_next)
+      bd->_next->_prev = bd->_prev;
+    if (bd->_prev)
+      bd->_prev->_next = bd->_next;
+    else
+      _open_bd_list = bd->_next;
+
+    /* wait for in-flight I/O: the kernel may still access request buffers */
+    while (blkdev_avail_req(bd) < MAX_REQUESTS) {
+      _blkdev_wait_slot(bd);
+      blkdev_poll_req(bd);
+    }
+
+    _blkdev_ring_exit(bd); /* drops buffer registration as well */
+    free_mempool(bd->reqpool);
+    close(bd->fd);
+    free(bd);
+  }
+}
+
+int blkdev_register_buffers(struct blkdev *bd, void *base, size_t len)
+{
+  struct iovec iov[BLKDEV_FIXBUF_MAX];
+  unsigned int i, nb;
+  size_t left;
+  int ret;
+
+  nb = (unsigned int) ((len + (1ul << BLKDEV_FIXBUF_SHIFT) - 1) >> BLKDEV_FIXBUF_SHIFT);
+  if (nb == 0 || nb > BLKDEV_FIXBUF_MAX)
+    return -EINVAL;
+
+  blkdev_unregister_buffers(bd);
+  left = len;
+  for (i = 0; i < nb; ++i) {
+    iov[i].iov_base = (uint8_t *) base + ((size_t) i << BLKDEV_FIXBUF_SHIFT);
+    iov[i].iov_len  = (left > (1ul << BLKDEV_FIXBUF_SHIFT)) ? (1ul << BLKDEV_FIXBUF_SHIFT) : left;
+    left -= iov[i].iov_len;
+  }
+  ret = _io_uring_register(bd->ring_fd, IORING_REGISTER_BUFFERS, iov, nb);
+  if (ret < 0) {
+    printd("%s: Could not register buffer area @%p (len: %zu): %d\n", bd->dev, base, len, errno);
+    return -errno; /* e.g., RLIMIT_MEMLOCK exceeded */
+  }
+  bd->fixbuf_base = base;
+  bd->fixbuf_len = len;
+  printd("%s: Registered buffer area @%p (len: %zu)\n", bd->dev, base, len);
+  return 0;
+}
+
+void blkdev_unregister_buffers(struct blkdev *bd)
+{
+  if (!bd->fixbuf_base)
+    return;
+
+  /* completes in-flight fixed buffer I/O before */
+  _io_uring_register(bd->ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+  bd->fixbuf_base = NULL;
+  bd->fixbuf_len = 0;
+}
+
+/* takes back SQEs that were not consumed by the kernel and fails their requests */
+static void _blkdev_fail_pending(struct blkdev *bd, int ret)
+{
+  struct _blkdev_req *req, *failed = NULL;
+  unsigned int tail;
+
+  tail = *bd->sq.tail;
+  while (bd->sq_pending) {
+    --tail;
+    --bd->sq_pending;
+    req = (struct _blkdev_req *) (uintptr_t) bd->sq.sqes[bd->sq.array[tail & bd->sq.mask]].user_data;
+    req->_next = failed;
+    failed = req;
+  }
+  _ring_store_release(bd->sq.tail, tail);
+
+  /* callbacks are called after the ring is consistent again
+   * because they might queue new requests */
+  while (failed) {
+    req = failed;
+    failed = req->_next;
+    printd("Failing request %p: %d\n", req, ret);
+    if (req->cb)
+      req->cb(ret, req->cb_argp); /* user callback */
+    mempool_put(req->p_obj);
+  }
+}
+
+void _blkdev_submit(struct blkdev *bd)
+{
+  int ret;
+
+  while (bd->sq_pending) {
+    ret = _io_uring_enter(bd->ring_fd, bd->sq_pending, 0, 0);
+    if (unlikely(ret < 0)) {
+      ret = -errno;
+      if (ret == -EINTR)
+	continue;
+      if (ret == -EAGAIN || ret == -EBUSY) {
+	/* kernel is out of resources or the completion queue is full:
+	 * remaining requests are submitted with the next poll, after
+	 * completions were reaped */
+	return;
+      }
+      printd("%s: Could not submit %u requests: %d\n", bd->dev, bd->sq_pending, ret);
+      _blkdev_fail_pending(bd, ret);
+      return;
+    }
+    bd->sq_pending -= (unsigned int) ret;
+  }
+}
+
+void _blkdev_wait_slot(struct blkdev *bd)
+{
+  _blkdev_submit(bd);
+  /* wait only when at least one request is in-flight in the kernel */
+  if (blkdev_avail_req(bd) == 0 && bd->sq_pending < MAX_REQUESTS)
+    _io_uring_enter(bd->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+}
+
+/* picks a request object and a submission queue entry */
+static inline struct io_uring_sqe *_blkdev_prep_req(struct blkdev *bd, struct _blkdev_req **req_out)
+{
+  struct mempool_obj *robj;
+  struct _blkdev_req *req;
+  struct io_uring_sqe *sqe;
+  unsigned int tail;
+
+  robj = mempool_pick(bd->reqpool);
+  if (unlikely(!robj))
+    return NULL; /* too many requests on queue */
+
+  req = robj->data;
+  req->p_obj = robj;
+  req->bd = bd;
+
+  /* there are never more outstanding requests than SQ entries,
+   * so the submission queue cannot overflow */
+  tail = *bd->sq.tail;
+  sqe = &bd->sq.sqes[tail & bd->sq.mask];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->fd = bd->fd;
+  sqe->user_data = (uint64_t) (uintptr_t) req;
+  bd->sq.array[tail & bd->sq.mask] = tail & bd->sq.mask;
+
+  *req_out = req;
+  return sqe;
+}
+
+static inline void _blkdev_queue_req(struct blkdev *bd)
+{
+  _ring_store_release(bd->sq.tail, *bd->sq.tail + 1);
+  ++bd->sq_pending;
+}
+
+int blkdev_async_io_nocheck(struct blkdev *bd, sector_t start, sector_t len,
+                            int write, void *buffer, blkdev_aiocb_t *cb, void *cb_argp)
+{
+  struct _blkdev_req *req;
+  struct io_uring_sqe *sqe;
+  size_t nbytes = len * blkdev_ssize(bd);
+  size_t off;
+
+  sqe = _blkdev_prep_req(bd, &req);
+  if (unlikely(!sqe))
+    return -EAGAIN;
+
+  sqe->off = (uint64_t) start * blkdev_ssize(bd);
+  sqe->addr = (uint64_t) (uintptr_t) buffer;
+  sqe->len = (uint32_t) nbytes;
+  sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+  if (bd->fixbuf_base && (uint8_t *) buffer >= bd->fixbuf_base) {
+    off = (size_t) ((uint8_t *) buffer - bd->fixbuf_base);
+    if (off + nbytes <= bd->fixbuf_len &&
+        (off >> BLKDEV_FIXBUF_SHIFT) == ((off + nbytes - 1) >> BLKDEV_FIXBUF_SHIFT)) {
+      /* target is part of the registered buffer area */
+      sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+      sqe->buf_index = (uint16_t) (off >> BLKDEV_FIXBUF_SHIFT);
+    }
+  }
+
+  req->sector = start;
+  req->nb_sectors = len;
+  req->nbytes = nbytes;
+  req->write = write;
+  req->cb = cb;
+  req->cb_argp = cb_argp;
+
+  _blkdev_queue_req(bd);
+  return 0;
+}
+
+int blkdev_async_iov_nocheck(struct blkdev *bd, sector_t start, const struct iovec *iov,
+                             unsigned int iovcnt, int write, blkdev_aiocb_t *cb, void *cb_argp)
+{
+  struct _blkdev_req *req;
+  struct io_uring_sqe *sqe;
+  unsigned int i;
+
+  sqe = _blkdev_prep_req(bd, &req);
+  if (unlikely(!sqe))
+    return -EAGAIN;
+
+  /* iovec has to remain valid until the request is completed */
+  req->nbytes = 0;
+  for (i = 0; i < iovcnt; ++i) {
+    req->iov[i] = iov[i];
+    req->nbytes += iov[i].iov_len;
+  }
+  sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+  sqe->off = (uint64_t) start * blkdev_ssize(bd);
+  sqe->addr = (uint64_t) (uintptr_t) req->iov;
+  sqe->len = iovcnt;
+
+  req->sector = start;
+  req->nb_sectors = req->nbytes / blkdev_ssize(bd);
+  req->write = write;
+  req->cb = cb;
+  req->cb_argp = cb_argp;
+
+  _blkdev_queue_req(bd);
+  return 0;
+}
+
+void blkdev_poll_req(struct blkdev *bd)
+{
+  struct _blkdev_req *req;
+  struct io_uring_cqe *cqe;
+  unsigned int head, tail;
+  int ret;
+
+  /* requests that were not submitted yet */
+  if (bd->sq_pending)
+    _blkdev_submit(bd);
+
+  head = *bd->cq.head;
+  tail = _ring_load_acquire(bd->cq.tail);
+  while (head != tail) {
+    cqe = &bd->cq.cqes[head & bd->cq.mask];
+    req = (struct _blkdev_req *) (uintptr_t) cqe->user_data;
+    if (likely(cqe->res == (int) req->nbytes))
+      ret = 0;
+    else
+      ret = (cqe->res < 0) ? cqe->res : -EIO; /* short read/write */
+    ++head;
+    _ring_store_release(bd->cq.head, head); /* release CQE before calling back */
+
+    printd("Finalizing request %p: %d\n", req, ret);
+    if (req->cb)
+      req->cb(ret, req->cb_argp); /* user callback */
+    mempool_put(req->p_obj);
+
+    tail = _ring_load_acquire(bd->cq.tail);
+  }
+}
+
+void _blkdev_sync_io_cb(int ret, void *argp)
+{
+	struct _blkdev_sync_io_sync *iosync = argp;
+
+	iosync->ret = ret;
+	iosync->done = 1;
+}
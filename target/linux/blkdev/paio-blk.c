@@ -159,6 +159,11 @@ struct blkdev *open_blkdev(blkdev_id_t id, int mode)
     errno = ENOMEM;
     goto err_close_fd;
   }
+  bd->iovpool = alloc_simple_mempool(MAX_IOV_REQUESTS, sizeof(struct aiocb) * BLKDEV_MAX_IOV);
+  if (!bd->iovpool) {
+    errno = ENOMEM;
+    goto err_free_reqpool;
+  }
   bd->mode = mode;
   bd->refcount = 1;
   bd->exclusive = !!(mode & O_EXCL);
@@ -197,21 +202,156 @@ void close_blkdev(struct blkdev *bd)
 
     /* TODO: check for enqueued IO */
 
+    free_mempool(bd->iovpool);
     free_mempool(bd->reqpool);
     close(bd->fd);
     free(bd);
   }
 }
 
+static inline void _blkdev_enqueue_req(struct blkdev *bd, struct _blkdev_req *req)
+{
+  /* enqueue request to the tail of reqq */
+  req->_next = NULL;
+  req->_prev = bd->reqq_tail;
+  if (req->_prev)
+    req->_prev->_next = req;
+  else
+    bd->reqq_head = req;
+  bd->reqq_tail = req;
+}
+
+static inline void _blkdev_dequeue_req(struct blkdev *bd, struct _blkdev_req *req)
+{
+  if (req->_next)
+    req->_next->_prev = req->_prev;
+  else
+    bd->reqq_tail = req->_prev;
+  if (req->_prev)
+    req->_prev->_next = req->_next;
+  else
+    bd->reqq_head = req->_next;
+}
+
+/* waits for the segments of a partially enqueued vectored request */
+static inline int _blkdev_reap_iov_req(struct _blkdev_req *req)
+{
+  const struct aiocb *list[BLKDEV_MAX_IOV];
+  unsigned int i, nb;
+  int ret = -EIO;
+
+  for (i = 0; i < req->nb_aiocb; ++i) {
+    if (aio_error(&req->aiocbv[i]) == EAGAIN)
+      ret = -EAGAIN; /* segment was not enqueued */
+    else if (aio_cancel(req->aiocbv[i].aio_fildes, &req->aiocbv[i]) == AIO_NOTCANCELED)
+      printd("Segment %u of request %p is in progress\n", i, req);
+  }
+
+  /* buffers cannot be handed back before all segments are done */
+  do {
+    nb = 0;
+    for (i = 0; i < req->nb_aiocb; ++i)
+      if (aio_error(&req->aiocbv[i]) == EINPROGRESS)
+	list[nb++] = &req->aiocbv[i];
+    if (nb)
+      aio_suspend(list, (int) nb, NULL);
+  } while (nb);
+  for (i = 0; i < req->nb_aiocb; ++i)
+    aio_return(&req->aiocbv[i]);
+  return ret;
+}
+
+int blkdev_async_iov_nocheck(struct blkdev *bd, sector_t start, const struct iovec *iov,
+                             unsigned int iovcnt, int write, blkdev_aiocb_t *cb, void *cb_argp)
+{
+  struct aiocb *list[BLKDEV_MAX_IOV];
+  struct mempool_obj *robj;
+  struct mempool_obj *iobj;
+  struct _blkdev_req *req;
+  off_t offset;
+  unsigned int i;
+  int ret;
+
+  robj = mempool_pick(bd->reqpool);
+  if (unlikely(!robj))
+    return -EAGAIN; /* too many requests on queue */
+  iobj = mempool_pick(bd->iovpool);
+  if (unlikely(!iobj)) {
+    mempool_put(robj);
+    return -EAGAIN; /* too many vectored requests on queue */
+  }
+
+  req = robj->data;
+  req->p_obj = robj;
+  req->iov_obj = iobj;
+  req->aiocbv = iobj->data;
+
+  offset = (off_t) (start * blkdev_ssize(bd));
+  for (i = 0; i < iovcnt; ++i) {
+    memset(&req->aiocbv[i], 0, sizeof(req->aiocbv[i]));
+    req->aiocbv[i].aio_fildes = bd->fd;
+    req->aiocbv[i].aio_buf = iov[i].iov_base;
+    req->aiocbv[i].aio_offset = offset;
+    req->aiocbv[i].aio_nbytes = iov[i].iov_len;
+    req->aiocbv[i].aio_reqprio = 0;
+    req->aiocbv[i].aio_sigevent.sigev_notify = SIGEV_NONE;
+    req->aiocbv[i].aio_lio_opcode = write ? LIO_WRITE : LIO_READ;
+    list[i] = &req->aiocbv[i];
+    offset += (off_t) iov[i].iov_len;
+  }
+  req->nb_aiocb = iovcnt;
+  req->bd = bd;
+  req->sector = start;
+  req->nb_sectors = ((sector_t) offset / blkdev_ssize(bd)) - start;
+  req->write = write;
+  req->cb = cb;
+  req->cb_argp = cb_argp;
+
+  /* send all segments with a single call */
+  if (lio_listio(LIO_NOWAIT, list, (int) iovcnt, NULL) < 0) {
+    ret = -errno;
+    if (ret == -EIO) {
+      /* some segments could not be enqueued (e.g., AIO queue is full):
+       * the ones that were are cancelled or waited for, so that the
+       * request can be retried as a whole */
+      ret = _blkdev_reap_iov_req(req);
+      printd("Request %p was partially enqueued: %d\n", req, ret);
+    } else {
+      printd("Could not enqueue request %p: %d\n", req, ret);
+    }
+    mempool_put(iobj);
+    mempool_put(robj);
+    return ret;
+  }
+
+  _blkdev_enqueue_req(bd, req);
+  return 0;
+}
+
+static inline int _blkdev_req_inprogress(struct _blkdev_req *req)
+{
+  unsigned int i;
+
+  for (i = 0; i < req->nb_aiocb; ++i)
+    if (aio_error(&req->aiocbv[i]) == EINPROGRESS)
+      return 1;
+  return 0;
+}
+
 static inline void _blkdev_finalize_req(struct _blkdev_req *req)
 {
   struct mempool_obj *robj;
+  unsigned int i;
   int ret = 0;
 
   robj = req->p_obj;
 
   printd("Finalizing request %p\n", req);
-  ret = (aio_return(&req->aiocb) == req->aiocb.aio_nbytes) ? 0 : -1;
+  for (i = 0; i < req->nb_aiocb; ++i)
+    if (aio_return(&req->aiocbv[i]) != req->aiocbv[i].aio_nbytes)
+      ret = -1;
+  if (req->iov_obj)
+    mempool_put(req->iov_obj);
   if (req->cb)
     req->cb(ret, req->cb_argp); /* user callback */
 
@@ -228,18 +368,10 @@ void blkdev_poll_req(struct blkdev *bd)
     req_next = req->_next;
     
     printd("Checking request %p for completion\n", req);
-    if (aio_error(&req->aiocb) != EINPROGRESS) {
+    if (!_blkdev_req_inprogress(req)) {
       /* aio has completed
        * dequeue it from list and finalize it */
-      if (req->_next)
-	req->_next->_prev = req->_prev;
-      else
-	bd->reqq_tail = req->_prev;
-      if (req->_prev)
-	req->_prev->_next = req->_next;
-      else
-	bd->reqq_head = req->_next;
-      
+      _blkdev_dequeue_req(bd, req);
       _blkdev_finalize_req(req);
     }
 
@@ -0,0 +1,295 @@
+/*
+ * Linux block I/O glue (io_uring)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ *
+ */
+#ifndef _IOURING_BLK_H_
+#define _IOURING_BLK_H_
+
+#include <semaphore.h>
+#include <mempool.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <linux/fs.h>
+#include <linux/io_uring.h>
+
+#define MAX_REQUESTS 1024 /* has to be a power of 2 (ring size) */
+#define DEFAULT_SSIZE 512 /* lower bound for opened files */
+
+#define BLKDEV_CAN_IOV
+#define BLKDEV_MAX_IOV 8 /* max. number of segments of a vectored request */
+
+#define BLKDEV_CAN_REGISTER_BUFFERS
+#define BLKDEV_FIXBUF_SHIFT 30 /* registered areas are split into 1 GiB buffers (kernel limit) */
+#define BLKDEV_FIXBUF_MAX 64
+
+typedef char blkdev_id_t[PATH_MAX]; /* device id is a path */
+typedef uint64_t sector_t;
+#define PRIsctr PRIu64
+
+typedef void (blkdev_aiocb_t)(int ret, void *argp);
+
+struct blkdev {
+  blkdev_id_t dev;
+  int fd;
+  int mode;
+  struct stat fd_stat;
+  sector_t size;
+  uint32_t ssize;
+  struct mempool *reqpool;
+
+  /* io_uring */
+  int ring_fd;
+  unsigned int sq_pending; /* prepared SQEs that are not submitted yet */
+  struct {
+    unsigned *head;
+    unsigned *tail;
+    unsigned *array;
+    unsigned mask;
+    struct io_uring_sqe *sqes;
+    void *ring;
+    size_t ring_len;
+    size_t sqes_len;
+  } sq;
+  struct {
+    unsigned *head;
+    unsigned *tail;
+    unsigned mask;
+    struct io_uring_cqe *cqes;
+    void *ring;
+    size_t ring_len;
+  } cq;
+  uint8_t *fixbuf_base; /* registered buffer area (NULL if none) */
+  size_t fixbuf_len;
+
+  int exclusive;
+  unsigned int refcount;
+
+  struct blkdev *_next;
+  struct blkdev *_prev;
+};
+
+struct _blkdev_req {
+  struct mempool_obj *p_obj; /* reference to dependent memory pool object */
+  struct blkdev *bd;
+  sector_t sector;
+  sector_t nb_sectors;
+  size_t nbytes;
+  int write;
+  blkdev_aiocb_t *cb;
+  void *cb_argp;
+  struct iovec iov[BLKDEV_MAX_IOV]; /* segments of vectored requests */
+  struct _blkdev_req *_next; /* used when pending requests are failed */
+};
+
+struct blkdev *open_blkdev(blkdev_id_t id, int mode);
+void close_blkdev(struct blkdev *bd);
+#define blkdev_refcount(bd) ((bd)->refcount)
+
+int blkdev_id_parse(const char *id, blkdev_id_t *out);
+#define blkdev_id_unparse(id, out, maxlen) \
+     (snprintf((out), (maxlen), "%s", (id)))
+#define blkdev_id_cmp(id0, id1) \
+     (strncmp((id0), (id1), PATH_MAX))
+#define blkdev_id_cpy(dst, src) \
+     (strncpy((dst), (src), PATH_MAX))
+#define blkdev_id(bd) ((bd)->dev)
+#define blkdev_ioalign(bd) blkdev_ssize((bd))
+
+/**
+ * Retrieve device information
+ */
+#define blkdev_ssize(bd) ((uint32_t) (bd)->ssize)
+#define blkdev_size(bd) ((bd)->size * (sector_t) blkdev_ssize((bd)))
+#define blkdev_avail_req(bd) mempool_free_count((bd)->reqpool)
+
+/**
+ * Registered (fixed) buffers
+ *
+ * Requests with a target buffer that lies within the registered area
+ * are done without mapping the buffer on each request.
+ * Only one area can be registered per device, a registration replaces
+ * a previous one.
+ */
+int blkdev_register_buffers(struct blkdev *bd, void *base, size_t len);
+void blkdev_unregister_buffers(struct blkdev *bd);
+
+/**
+ * Async I/O
+ *
+ * Note: target buffer has to be aligned to device sector size
+ * Note: Requests are only queued to the submission ring,
+ *       blkdev_async_io_submit() (or blkdev_poll_req()) passes them to the kernel
+ */
+void _blkdev_submit(struct blkdev *bd);
+void _blkdev_wait_slot(struct blkdev *bd);
+
+#define blkdev_async_io_submit(bd) _blkdev_submit((bd))
+#define blkdev_async_io_wait_slot(bd) _blkdev_wait_slot((bd))
+
+int blkdev_async_io_nocheck(struct blkdev *bd, sector_t start, sector_t len,
+                            int write, void *buffer, blkdev_aiocb_t *cb, void *cb_argp);
+#define blkdev_async_write_nocheck(bd, start, len, buffer, cb, cb_argp) \
+	blkdev_async_io_nocheck((bd), (start), (len), 1, (buffer), (cb), (cb_argp))
+#define blkdev_async_read_nocheck(bd, start, len, buffer, cb, cb_argp) \
+	blkdev_async_io_nocheck((bd), (start), (len), 0, (buffer), (cb), (cb_argp))
+
+static inline int blkdev_async_io(struct blkdev *bd, sector_t start, sector_t len,
+                                  int write, void *buffer, blkdev_aiocb_t *cb, void *cb_argp)
+{
+	if (unlikely(write && !(bd->mode & (O_WRONLY | O_RDWR)))) {
+		/* write access on non-writable device or read access on non-readable device */
+		return -EACCES;
+	}
+
+	if (unlikely(((uintptr_t) buffer) & ((uintptr_t) blkdev_ssize(bd) - 1))) {
+		/* buffer is not aligned to device sector size */
+		return -EINVAL;
+	}
+
+	return blkdev_async_io_nocheck(bd, start, len, write, buffer, cb, cb_argp);
+}
+#define blkdev_async_write(bd, start, len, buffer, cb, cb_argp)	  \
+	blkdev_async_io((bd), (start), (len), 1, (buffer), (cb), (cb_argp))
+#define blkdev_async_read(bd, start, len, buffer, cb, cb_argp)	  \
+	blkdev_async_io((bd), (start), (len), 0, (buffer), (cb), (cb_argp))
+
+/**
+ * Vectored async I/O
+ *
+ * Scatters/gathers a contiguous device area (starting at sector start)
+ * from/to iovcnt buffers with a single request (one callback).
+ * Segment lengths have to be multiples of the device sector size.
+ */
+int blkdev_async_iov_nocheck(struct blkdev *bd, sector_t start, const struct iovec *iov,
+                             unsigned int iovcnt, int write, blkdev_aiocb_t *cb, void *cb_argp);
+
+static inline int blkdev_async_iov(struct blkdev *bd, sector_t start, const struct iovec *iov,
+                                   unsigned int iovcnt, int write, blkdev_aiocb_t *cb, void *cb_argp)
+{
+	if (unlikely(write && !(bd->mode & (O_WRONLY | O_RDWR)))) {
+		/* write access on non-writable device or read access on non-readable device */
+		return -EACCES;
+	}
+
+	if (unlikely(iovcnt == 0 || iovcnt > BLKDEV_MAX_IOV)) {
+		/* request cannot be handled with a single request */
+		return -ENXIO;
+	}
+
+	return blkdev_async_iov_nocheck(bd, start, iov, iovcnt, write, cb, cb_argp);
+}
+#define blkdev_async_writev(bd, start, iov, iovcnt, cb, cb_argp)	  \
+	blkdev_async_iov((bd), (start), (iov), (iovcnt), 1, (cb), (cb_argp))
+#define blkdev_async_readv(bd, start, iov, iovcnt, cb, cb_argp)	  \
+	blkdev_async_iov((bd), (start), (iov), (iovcnt), 0, (cb), (cb_argp))
+
+void blkdev_poll_req(struct blkdev *bd);
+
+#ifdef CONFIG_SELECT_POLL
+#define CAN_POLL_BLKDEV
+#define blkdev_get_fd(bd) ((bd)->ring_fd) /* readable when completions are available */
+#endif /* CONFIG_SELECT_POLL */
+
+/**
+ * Sync I/O
+ */
+void _blkdev_sync_io_cb(int ret, void *argp);
+
+struct _blkdev_sync_io_sync {
+	int done;
+	int ret;
+};
+
+static inline int blkdev_sync_io_nocheck(struct blkdev *bd, sector_t start, sector_t len,
+                                             int write, void *target)
+{
+	struct _blkdev_sync_io_sync iosync;
+	int ret;
+
+	iosync.done = 0;
+	ret = blkdev_async_io_nocheck(bd, start, len, write, target,
+	                              _blkdev_sync_io_cb, &iosync);
+	while (ret == -EAGAIN) {
+		/* try again, queue was full */
+		blkdev_poll_req(bd);
+		schedule();
+		ret = blkdev_async_io_nocheck(bd, start, len, write, target,
+		                              _blkdev_sync_io_cb, &iosync);
+	}
+	if (ret < 0)
+		return ret;
+
+	/* wait for I/O completion */
+	blkdev_async_io_submit(bd);
+	blkdev_poll_req(bd);
+	while (!iosync.done) {
+		schedule(); /* yield CPU */
+		blkdev_poll_req(bd);
+	}
+
+	return iosync.ret;
+}
+#define blkdev_sync_write_nocheck(bd, start, len, buffer)	  \
+	blkdev_sync_io_nocheck((bd), (start), (len), 1, (buffer))
+#define blkdev_sync_read_nocheck(bd, start, len, buffer)	  \
+	blkdev_sync_io_nocheck((bd), (start), (len), 0, (buffer))
+
+static inline int blkdev_sync_io(struct blkdev *bd, sector_t start, sector_t len,
+                                 int write, void *target)
+{
+	if (unlikely(write && !(bd->mode & (O_WRONLY | O_RDWR)))) {
+		/* write access on non-writable device or read access on non-readable device */
+		return -EACCES;
+	}
+
+	if (unlikely(((uintptr_t) target) & ((uintptr_t) blkdev_ssize(bd) - 1))) {
+		/* buffer is not aligned to device sector size */
+		return -EINVAL;
+	}
+
+	return blkdev_sync_io_nocheck(bd, start, len, write, target);
+}
+#define blkdev_sync_write(bd, start, len, buffer)	  \
+	blkdev_sync_io((bd), (start), (len), 1, (buffer))
+#define blkdev_sync_read(bd, start, len, buffer)	  \
+	blkdev_sync_io((bd), (start), (len), 0, (buffer))
+
+#endif /* _IOURING_BLK_H_ */
@@ -45,6 +45,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <inttypes.h>
+#include <sys/uio.h>
 #include <linux/fs.h>
 
 #ifndef _POSIX_ASYNCHRONOUS_IO
@@ -54,6 +55,10 @@
 #define MAX_REQUESTS 1024
 #define DEFAULT_SSIZE 512 /* lower bound for opened files */
 
+#define BLKDEV_CAN_IOV
+#define BLKDEV_MAX_IOV 8 /* max. number of segments of a vectored request */
+#define MAX_IOV_REQUESTS 128 /* max. number of vectored requests in flight */
+
 typedef char blkdev_id_t[PATH_MAX]; /* device id is a path */
 typedef uint64_t sector_t;
 #define PRIsctr PRIu64
@@ -68,6 +73,7 @@ struct blkdev {
   sector_t size;
   uint32_t ssize;
   struct mempool *reqpool;
+  struct mempool *iovpool; /* segment lists of vectored requests */
   struct _blkdev_req *reqq_head;
   struct _blkdev_req *reqq_tail;
 
@@ -80,8 +86,11 @@ struct blkdev {
 
 struct _blkdev_req {
   struct mempool_obj *p_obj; /* reference to dependent memory pool object */
+  struct mempool_obj *iov_obj; /* segment list of a vectored request (otherwise NULL) */
   struct blkdev *bd;
   struct aiocb aiocb;
+  struct aiocb *aiocbv; /* points to aiocb or to the segment list (one per segment) */
+  unsigned int nb_aiocb;
   sector_t sector;
   sector_t nb_sectors;
   int write;
@@ -146,6 +155,9 @@ static inline int blkdev_async_io_nocheck(struct blkdev *bd, sector_t start, sec
   req->aiocb.aio_reqprio = 0;
   req->aiocb.aio_sigevent.sigev_notify = SIGEV_NONE;
   req->aiocb.aio_lio_opcode = 0; //write ? LIO_WRITE : LIO_READ;
+  req->iov_obj = NULL;
+  req->aiocbv = &req->aiocb;
+  req->nb_aiocb = 1;
   req->bd = bd;
   req->sector = start;
   req->nb_sectors = len;
@@ -189,6 +201,38 @@ static inline int blkdev_async_io(struct blkdev *bd, sector_t start, sector_t le
 #define blkdev_async_read(bd, start, len, buffer, cb, cb_argp)	  \
 	blkdev_async_io((bd), (start), (len), 0, (buffer), (cb), (cb_argp))
 
+/**
+ * Vectored async I/O
+ *
+ * Scatters/gathers a contiguous device area (starting at sector start)
+ * from/to iovcnt buffers. All segments are submitted with a single
+ * lio_listio() call and complete as a single request (one callback).
+ * Segment lengths have to be multiples of the device sector size.
+ * -EAGAIN is returned when not all segments could be enqueued.
+ */
+int blkdev_async_iov_nocheck(struct blkdev *bd, sector_t start, const struct iovec *iov,
+                             unsigned int iovcnt, int write, blkdev_aiocb_t *cb, void *cb_argp);
+
+static inline int blkdev_async_iov(struct blkdev *bd, sector_t start, const struct iovec *iov,
+                                   unsigned int iovcnt, int write, blkdev_aiocb_t *cb, void *cb_argp)
+{
+	if (unlikely(write && !(bd->mode & (O_WRONLY | O_RDWR)))) {
+		/* write access on non-writable device or read access on non-readable device */
+		return -EACCES;
+	}
+
+	if (unlikely(iovcnt == 0 || iovcnt > BLKDEV_MAX_IOV)) {
+		/* request cannot be handled with a single request */
+		return -ENXIO;
+	}
+
+	return blkdev_async_iov_nocheck(bd, start, iov, iovcnt, write, cb, cb_argp);
+}
+#define blkdev_async_writev(bd, start, iov, iovcnt, cb, cb_argp)	  \
+	blkdev_async_iov((bd), (start), (iov), (iovcnt), 1, (cb), (cb_argp))
+#define blkdev_async_readv(bd, start, iov, iovcnt, cb, cb_argp)	  \
+	blkdev_async_iov((bd), (start), (iov), (iovcnt), 0, (cb), (cb_argp))
+
 void blkdev_poll_req(struct blkdev *bd);
 
 /**
@@ -39,6 +39,8 @@
 
 #if defined CONFIG_OSVBLK
 #include <blkdev/osv-blk.h>
+#elif defined CONFIG_IOURINGBLK
+#include <blkdev/iouring-blk.h>
 #else
 #include <blkdev/paio-blk.h>
 #endif
@@ -56,6 +56,46 @@
 #define target_free(ptr) \
   free(ptr)
 
+/* huge page backed allocations (hugetlbfs): 1 GiB pages are tried for
+ * allocations of at least that size, 2 MiB pages otherwise.
+ * *len returns the mapped length (size rounded up to the page size).
+ * NULL is returned when no huge pages are available (see:
+ * /proc/sys/vm/nr_hugepages), the caller has to fall back to target_malloc() */
+#include <sys/mman.h>
+#ifdef MAP_HUGETLB
+#define TARGET_HUGEPAGES
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#define TARGET_HUGEPAGE_SHIFT_2M 21
+#define TARGET_HUGEPAGE_SHIFT_1G 30
+
+static inline void *_target_mmap_huge(size_t size, unsigned int shift, size_t *len)
+{
+  void *ptr;
+
+  *len = (size + (1UL << shift) - 1) & ~((1UL << shift) - 1);
+  ptr = mmap(NULL, *len, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT),
+	     -1, 0);
+  return (ptr == MAP_FAILED) ? NULL : ptr;
+}
+
+static inline void *target_malloc_huge(size_t size, size_t *len)
+{
+  void *ptr = NULL;
+
+  if (size >= (1UL << TARGET_HUGEPAGE_SHIFT_1G))
+    ptr = _target_mmap_huge(size, TARGET_HUGEPAGE_SHIFT_1G, len);
+  if (!ptr)
+    ptr = _target_mmap_huge(size, TARGET_HUGEPAGE_SHIFT_2M, len);
+  return ptr;
+}
+
+#define target_free_huge(ptr, len) \
+  munmap((ptr), (len))
+#endif /* MAP_HUGETLB */
+
 #define local_irq_save(flags) \
   (flags = 0)
 #define local_irq_restore(flags) \